@@ -0,0 +1,157 @@
+/// Program that lists the procedures of a MIPS COFF file with their
+/// addresses, for the profiler of user programs (see
+/// `userprog/profiler.hh`).
+///
+/// Both external procedures and static ones, found among the local symbols
+/// of each source file, are printed one per line as `<hex address> <name>`,
+/// sorted by address.  Save the output next to the NOFF file converted from
+/// the same COFF file, with the name of the former plus `.sym`.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "coff_reader.h"
+#include "extern/syms.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct procedure {
+    unsigned address;
+    const char *name;
+} procedure;
+
+static const char *path;
+
+static void
+Die(const char *message)
+{
+    fprintf(stderr, "%s: %s\n", path, message);
+    exit(1);
+}
+
+/// Read `count` items of `size` bytes at `offset`, into a fresh buffer.
+static void *
+ReadTable(FILE *f, long offset, size_t size, size_t count)
+{
+    void *table = malloc(count == 0 ? 1 : size * count);
+    if (table == NULL) {
+        Die("Could not allocate memory");
+    }
+    if (count > 0
+          && (fseek(f, offset, SEEK_SET) != 0
+              || fread(table, size, count, f) != count)) {
+        Die("Symbol table is truncated");
+    }
+    return table;
+}
+
+static bool
+IsProcedure(const SYMR *sym)
+{
+    return (sym->st == stProc || sym->st == stStaticProc)
+           && sym->sc == scText;
+}
+
+static int
+CompareProcedures(const void *a, const void *b)
+{
+    const procedure *x = a, *y = b;
+    if (x->address != y->address) {
+        return x->address < y->address ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <path to COFF file>\n", argv[0]);
+        return 1;
+    }
+
+    path = argv[1];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    coffReaderData d;
+    char *error;
+    if (!CoffReaderLoad(&d, f, &error)) {
+        Die(error);
+    }
+    if (d.fileH.symbolPtr == 0) {
+        Die("No symbols; was it linked with `-s`?");
+    }
+
+    HDRR h;
+    if (fseek(f, d.fileH.symbolPtr, SEEK_SET) != 0
+          || fread(&h, sizeof h, 1, f) != 1) {
+        Die("Symbol table is truncated");
+    }
+    if (h.magic != magicSym) {
+        Die("Bad symbol table magic number");
+    }
+
+    FDR  *files    = ReadTable(f, h.cbFdOffset, sizeof *files, h.ifdMax);
+    SYMR *locals   = ReadTable(f, h.cbSymOffset, sizeof *locals, h.isymMax);
+    char *strings  = ReadTable(f, h.cbSsOffset, 1, h.issMax);
+    EXTR *externs  = ReadTable(f, h.cbExtOffset, sizeof *externs, h.iextMax);
+    char *xstrings = ReadTable(f, h.cbSsExtOffset, 1, h.issExtMax);
+
+    procedure *procs = malloc((h.isymMax + h.iextMax + 1) * sizeof *procs);
+    if (procs == NULL) {
+        Die("Could not allocate memory");
+    }
+    unsigned n = 0;
+
+    for (int i = 0; i < h.ifdMax; i++) {
+        const FDR *fd = &files[i];
+        for (int j = fd->isymBase; j < fd->isymBase + fd->csym; j++) {
+            if (j < 0 || j >= h.isymMax) {
+                Die("Bad local symbol index");
+            }
+            const SYMR *sym = &locals[j];
+            int iss = fd->issBase + sym->iss;
+            if (IsProcedure(sym) && iss >= 0 && iss < h.issMax) {
+                procs[n].address = sym->value;
+                procs[n].name = &strings[iss];
+                n++;
+            }
+        }
+    }
+    for (int i = 0; i < h.iextMax; i++) {
+        const SYMR *sym = &externs[i].asym;
+        if (IsProcedure(sym) && sym->iss >= 0 && sym->iss < h.issExtMax) {
+            procs[n].address = sym->value;
+            procs[n].name = &xstrings[sym->iss];
+            n++;
+        }
+    }
+
+    // Global procedures show up both as local and external symbols.
+    qsort(procs, n, sizeof *procs, CompareProcedures);
+    for (unsigned i = 0; i < n; i++) {
+        if (i > 0 && CompareProcedures(&procs[i - 1], &procs[i]) == 0) {
+            continue;
+        }
+        printf("%08x %s\n", procs[i].address, procs[i].name);
+    }
+
+    free(procs);
+    free(xstrings);
+    free(externs);
+    free(strings);
+    free(locals);
+    free(files);
+    CoffReaderUnload(&d);
+    fclose(f);
+    return 0;
+}
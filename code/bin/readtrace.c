@@ -0,0 +1,329 @@
+/// Program that prints, filters and summarizes the binary execution traces
+/// written by Nachos with `-trace` (see `trace.h`).
+///
+/// Records are printed oldest first, one per line: the tick at which the
+/// instruction started, its disassembly, the address it loaded from or
+/// stored to, and the exception it raised, if any.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "trace.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "d.c"
+
+
+/// Names of the exceptions, in the order of `ExceptionType`.
+static const char *EXCEPTION_NAMES[] = {
+    "none", "syscall", "page fault", "read only", "bus error",
+    "address error", "overflow", "illegal instruction"
+};
+#define NUM_EXCEPTIONS  (sizeof EXCEPTION_NAMES / sizeof *EXCEPTION_NAMES)
+
+/// Lines in each table of the summary.
+#define SUMMARY_LINES  15
+
+/// Instruction kinds counted in the summary: the 64 main opcodes, the 64
+/// `special` function codes, and `nop`.
+#define NUM_KINDS  129
+#define KIND_NOP   128
+
+typedef struct range {
+    uint64_t from, to;  // Both included.
+    bool set;
+} range;
+
+typedef struct counter {
+    uint64_t count;
+    unsigned key;
+} counter;
+
+static void
+Usage(const char *self)
+{
+    fprintf(stderr,
+            "Usage: %s [-s] [-x] [-n <records>] [-pc <from>[-<to>]]\n"
+            "       [-mem <from>[-<to>]] [-t <from>[-<to>]] <trace file>\n"
+            "\n"
+            "  -s    print a summary instead of the records.\n"
+            "  -x    only records of instructions that raised exceptions.\n"
+            "  -n    only the last so many records in the trace.\n"
+            "  -pc   only instructions within a range of addresses (hex).\n"
+            "  -mem  only loads and stores within a range of addresses "
+            "(hex).\n"
+            "  -t    only instructions started within a range of ticks.\n",
+            self);
+    exit(1);
+}
+
+static range
+ParseRange(const char *s, int base)
+{
+    range r;
+    char *end;
+    r.from = strtoull(s, &end, base);
+    r.to = r.from;
+    if (*end == '-') {
+        r.to = strtoull(end + 1, &end, base);
+    }
+    if (*end != '\0' || r.to < r.from) {
+        fprintf(stderr, "Bad range `%s`.\n", s);
+        exit(1);
+    }
+    r.set = true;
+    return r;
+}
+
+static bool
+InRange(const range *r, uint64_t value)
+{
+    return !r->set || (r->from <= value && value <= r->to);
+}
+
+static unsigned
+Kind(uint32_t instruction)
+{
+    if (instruction == I_NOP) {
+        return KIND_NOP;
+    }
+    unsigned opcode = instruction >> 26;
+    return opcode == I_SPECIAL ? 64 + (instruction & 0x3F) : opcode;
+}
+
+static const char *
+KindName(unsigned kind)
+{
+    return kind == KIND_NOP ? "nop"
+         : kind >= 64       ? SPECIAL_OPS[kind - 64]
+                            : NORMAL_OPS[kind];
+}
+
+static void
+PrintRecord(const traceRecord *r)
+{
+    printf("%12" PRIu64 "  ", r->tick);
+    if (r->flags & TRACE_NO_FETCH) {
+        printf("%08X: (not fetched)", r->pc);
+    } else {
+        DumpAscii(r->instruction, r->pc);
+    }
+    if (r->flags & TRACE_MEMORY) {
+        printf("\t[%08X]", r->memAddr);
+    }
+    if (r->exception != 0) {
+        printf("\t<- %s",
+               r->exception < NUM_EXCEPTIONS ? EXCEPTION_NAMES[r->exception]
+                                             : "unknown exception");
+        if (r->exception != 1) {
+            printf(" at %08X", r->memAddr);
+        }
+    }
+    printf("\n");
+}
+
+static int
+CompareCounters(const void *a, const void *b)
+{
+    const counter *x = a, *y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    return x->key < y->key ? -1 : x->key > y->key;
+}
+
+static int
+CompareWords(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void
+PrintSummary(const traceHeader *h, const traceRecord **selected, size_t n)
+{
+    printf("Records: %" PRIu64 " written, %u kept, %zu selected.\n",
+           h->count, h->capacity, n);
+    if (n == 0) {
+        return;
+    }
+    printf("Ticks: %" PRIu64 " to %" PRIu64 ".\n",
+           selected[0]->tick, selected[n - 1]->tick);
+
+    counter kinds[NUM_KINDS], exceptions[NUM_EXCEPTIONS];
+    for (unsigned i = 0; i < NUM_KINDS; i++) {
+        kinds[i] = (counter) { 0, i };
+    }
+    for (unsigned i = 0; i < NUM_EXCEPTIONS; i++) {
+        exceptions[i] = (counter) { 0, i };
+    }
+    uint64_t loads = 0, stores = 0, unfetched = 0;
+    uint32_t *pcs = malloc(n * sizeof *pcs);
+    if (pcs == NULL) {
+        fprintf(stderr, "Could not allocate memory.\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const traceRecord *r = selected[i];
+        pcs[i] = r->pc;
+        if (r->exception < NUM_EXCEPTIONS) {
+            exceptions[r->exception].count++;
+        }
+        if (r->flags & TRACE_NO_FETCH) {
+            unfetched++;
+            continue;
+        }
+        kinds[Kind(r->instruction)].count++;
+        if (r->flags & TRACE_MEMORY) {
+            // Stores are the opcodes with bit 3 set, from `sb` on.
+            if ((r->instruction >> 26) & 010) {
+                stores++;
+            } else {
+                loads++;
+            }
+        }
+    }
+    printf("Memory: %" PRIu64 " loads, %" PRIu64 " stores.\n",
+           loads, stores);
+    if (unfetched > 0) {
+        printf("Fetches failed: %" PRIu64 ".\n", unfetched);
+    }
+
+    printf("\nInstruction mix:\n");
+    qsort(kinds, NUM_KINDS, sizeof *kinds, CompareCounters);
+    for (unsigned i = 0; i < SUMMARY_LINES && kinds[i].count > 0; i++) {
+        printf("%12" PRIu64 " %6.2f%%  %s\n", kinds[i].count,
+               100.0 * kinds[i].count / n, KindName(kinds[i].key));
+    }
+
+    printf("\nExceptions:\n");
+    for (unsigned i = 1; i < NUM_EXCEPTIONS; i++) {
+        if (exceptions[i].count > 0) {
+            printf("%12" PRIu64 "  %s\n", exceptions[i].count,
+                   EXCEPTION_NAMES[i]);
+        }
+    }
+
+    // Count the runs of equal addresses once sorted.
+    qsort(pcs, n, sizeof *pcs, CompareWords);
+    size_t distinct = 0;
+    counter *hot = malloc(n * sizeof *hot);
+    if (hot == NULL) {
+        fprintf(stderr, "Could not allocate memory.\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (i == 0 || pcs[i] != pcs[i - 1]) {
+            hot[distinct++] = (counter) { 0, pcs[i] };
+        }
+        hot[distinct - 1].count++;
+    }
+    qsort(hot, distinct, sizeof *hot, CompareCounters);
+    printf("\nHottest instructions (%zu distinct):\n", distinct);
+    for (size_t i = 0; i < SUMMARY_LINES && i < distinct; i++) {
+        printf("%12" PRIu64 " %6.2f%%  %08X\n", hot[i].count,
+               100.0 * hot[i].count / n, hot[i].key);
+    }
+
+    free(hot);
+    free(pcs);
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool summary = false, exceptionsOnly = false;
+    uint64_t last = 0;
+    range pcs = { 0, 0, false }, mem = { 0, 0, false },
+          ticks = { 0, 0, false };
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            summary = true;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            exceptionsOnly = true;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            last = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-pc") == 0 && i + 1 < argc) {
+            pcs = ParseRange(argv[++i], 16);
+        } else if (strcmp(argv[i], "-mem") == 0 && i + 1 < argc) {
+            mem = ParseRange(argv[++i], 16);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            ticks = ParseRange(argv[++i], 10);
+        } else {
+            Usage(argv[0]);
+        }
+    }
+    if (i != argc - 1) {
+        Usage(argv[0]);
+    }
+
+    const char *path = argv[i];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+    traceHeader h;
+    if (fread(&h, sizeof h, 1, f) != 1 || h.magic != TRACE_MAGIC) {
+        fprintf(stderr, "%s: not a Nachos trace.\n", path);
+        return 1;
+    }
+    if (h.version != TRACE_VERSION || h.recordSize != sizeof (traceRecord)) {
+        fprintf(stderr, "%s: unsupported trace version.\n", path);
+        return 1;
+    }
+
+    // The oldest record kept is at the next position to be written once
+    // the ring has wrapped around.
+    size_t kept = h.count < h.capacity ? h.count : h.capacity;
+    size_t first = h.count < h.capacity ? 0 : h.count % h.capacity;
+    traceRecord *records = malloc((kept == 0 ? 1 : kept) * sizeof *records);
+    const traceRecord **selected = malloc((kept == 0 ? 1 : kept)
+                                          * sizeof *selected);
+    if (records == NULL || selected == NULL) {
+        fprintf(stderr, "Could not allocate memory.\n");
+        return 1;
+    }
+    if (fread(records, sizeof *records, kept, f) != kept) {
+        fprintf(stderr, "%s: trace is truncated.\n", path);
+        return 1;
+    }
+    fclose(f);
+
+    size_t n = 0;
+    size_t skip = last > 0 && last < kept ? kept - last : 0;
+    for (size_t j = skip; j < kept; j++) {
+        const traceRecord *r = &records[(first + j) % h.capacity];
+        if (!InRange(&pcs, r->pc) || !InRange(&ticks, r->tick)
+              || (exceptionsOnly && r->exception == 0)) {
+            continue;
+        }
+        if (mem.set && (!(r->flags & TRACE_MEMORY)
+                        || !InRange(&mem, r->memAddr))) {
+            continue;
+        }
+        selected[n++] = r;
+    }
+
+    if (summary) {
+        PrintSummary(&h, selected, n);
+    } else {
+        for (size_t j = 0; j < n; j++) {
+            PrintRecord(selected[j]);
+        }
+    }
+
+    free(selected);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/// Format of the binary execution traces written by the simulator when run
+/// with `-trace`, and read by `readtrace`.
+///
+/// A trace file is a header followed by a ring of `capacity` records, one
+/// per user instruction.  The simulator maps the file into memory and puts
+/// record number `n` at index `n % capacity`, so the file always holds the
+/// last `capacity` instructions run, even if Nachos dies halfway.
+///
+/// Everything is in host byte order: traces are meant to be read on the
+/// machine that wrote them.
+///
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_TRACE__H
+#define NACHOS_BIN_TRACE__H
+
+
+#include <stdint.h>
+
+
+#define TRACE_MAGIC    0x4E545243  // "NTRC".
+#define TRACE_VERSION  1
+
+typedef struct traceHeader {
+    uint32_t magic;       // Should be `TRACE_MAGIC`.
+    uint32_t version;     // Should be `TRACE_VERSION`.
+    uint32_t recordSize;  // Size of a `traceRecord`.
+    uint32_t capacity;    // Number of records in the ring.
+    uint64_t count;       // Number of records written so far.
+} traceHeader;
+
+// Bits of `traceRecord.flags`.
+#define TRACE_MEMORY    0x1  // `memAddr` holds the address of a load or
+                             // store.
+#define TRACE_NO_FETCH  0x2  // The instruction could not be fetched.
+
+typedef struct traceRecord {
+    uint64_t tick;         // Total ticks when the instruction started.
+    uint32_t pc;           // Virtual address of the instruction.
+    uint32_t instruction;  // Instruction word, if it could be fetched.
+    uint32_t memAddr;      // Address accessed, or that caused the exception.
+    uint8_t  exception;    // `ExceptionType` raised, if any (0 is none).
+    uint8_t  flags;
+    uint16_t unused;
+} traceRecord;
+
+
+#endif
@@ -344,9 +344,9 @@ FileSystem::Delete(const char *name) {
 
     int sector = dir->Find(name);
     if (sector == -1) {
-       delete dir;
        DEBUG('f', "File %s\n not found, deletedn't", name);
        dir->Flush();
+       delete dir;
        return false;  // file not found
     }
     DEBUG('f', "Deleting file %s. Fetching file header\n", name);
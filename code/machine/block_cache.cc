@@ -0,0 +1,46 @@
+#include "block_cache.hh"
+
+
+#ifdef BLOCK_INTERPRETER
+
+BlockCache::BlockCache()
+{
+    blocks = new BasicBlock [NUM_BLOCKS];
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        blocks[i].physAddr = (unsigned) -1;
+        blocks[i].length = 0;
+#ifdef JIT
+        blocks[i].runs = 0;
+        blocks[i].code = nullptr;
+#endif
+    }
+}
+
+BlockCache::~BlockCache()
+{
+    delete [] blocks;
+}
+
+void
+BlockCache::Drop(BasicBlock *block)
+{
+    block->physAddr = (unsigned) -1;
+    block->length = 0;
+#ifdef JIT
+    block->runs = 0;
+    block->code = nullptr;
+#endif
+}
+
+#ifdef JIT
+void
+BlockCache::DropCode()
+{
+    for (unsigned i = 0; i < NUM_BLOCKS; i++) {
+        blocks[i].runs = 0;
+        blocks[i].code = nullptr;
+    }
+}
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+/// Basic blocks of user code, translated for the block interpreter.
+///
+/// A block is a run of consecutive instructions in one page, ending after
+/// the delay slot of the first branch or jump, or at a system call.  Each
+/// instruction is decoded once, and bound to the `Machine` method that
+/// executes it: a short one for the most common operations, and the
+/// general `ExecInstruction` for the rest.  `Machine::RunBlock` then runs
+/// the block by calling those methods one after the other.
+///
+/// Blocks are kept in a direct-mapped table indexed by the physical address
+/// of their first instruction.  As with the decode cache, each instruction
+/// remembers the word it was decoded from, and the block is dropped as soon
+/// as memory holds a different one.
+
+#ifndef NACHOS_MACHINE_BLOCKCACHE__HH
+#define NACHOS_MACHINE_BLOCKCACHE__HH
+
+
+#include "instruction.hh"
+
+
+class Machine;
+
+/// Method of `Machine` that executes one decoded instruction.
+typedef void (Machine::*InstructionHandler)(const Instruction *instr);
+
+/// Maximum number of instructions in a block.
+const unsigned MAX_BLOCK_LENGTH = 32;
+
+/// Number of blocks kept; a power of two.
+const unsigned NUM_BLOCKS = 512;
+
+#ifdef JIT
+/// Code compiled for a block (see `jit.hh`): run it on `registers`, and
+/// return the number of instructions completed.
+typedef unsigned (*BlockCode)(int *registers, Machine *machine);
+#endif
+
+struct BasicBlock {
+    /// Physical address of the first instruction, or -1 if the slot is
+    /// free.
+    unsigned physAddr;
+
+    unsigned length;
+    Instruction instrs[MAX_BLOCK_LENGTH];
+    InstructionHandler handlers[MAX_BLOCK_LENGTH];
+
+#ifdef JIT
+    unsigned runs;   ///< Number of times run since it was translated.
+    BlockCode code;  ///< Compiled code, or null.
+#endif
+};
+
+class BlockCache {
+public:
+
+    BlockCache();
+
+    ~BlockCache();
+
+    /// Return the block starting at `physAddr`, or null if there is none.
+    BasicBlock *Find(unsigned physAddr);
+
+    /// Return the slot where the block starting at `physAddr` has to be
+    /// built, dropping the block that was there.
+    BasicBlock *Slot(unsigned physAddr);
+
+    /// Drop `block`, whose code has changed.
+    void Drop(BasicBlock *block);
+
+#ifdef JIT
+    /// Forget the compiled code of every block.
+    void DropCode();
+#endif
+
+private:
+    BasicBlock *blocks;
+};
+
+inline BasicBlock *
+BlockCache::Slot(unsigned physAddr)
+{
+    return &blocks[physAddr / 4 & (NUM_BLOCKS - 1)];
+}
+
+inline BasicBlock *
+BlockCache::Find(unsigned physAddr)
+{
+    BasicBlock *block = Slot(physAddr);
+    return block->physAddr == physAddr ? block : nullptr;
+}
+
+
+#endif
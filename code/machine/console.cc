@@ -72,16 +72,24 @@ Console::Console(const char *readFile, const char *writeFile,
     readHandler  = readAvail;
     handlerArg   = callArg;
     putBusy      = false;
+    putCount     = 0;
     incoming     = EOF;
 
     // Start polling for incoming packets.
-    interrupt->Schedule(ConsoleReadPoll, this,
-                        CONSOLE_TIME, CONSOLE_READ_INT);
+    pollInterrupt = interrupt->Schedule(ConsoleReadPoll, this,
+                                        CONSOLE_TIME, CONSOLE_READ_INT);
+    writeInterrupt = 0;
 }
 
 /// Clean up console emulation.
 Console::~Console()
 {
+    // Nothing may call back into this console any more.
+    interrupt->Cancel(pollInterrupt);
+    if (putBusy) {
+        interrupt->Cancel(writeInterrupt);
+    }
+
     if (readFileNo != 0) {
         SystemDep::Close(readFileNo);
     }
@@ -103,8 +111,8 @@ Console::CheckCharAvail()
     char c;
 
     // Schedule the next time to poll for a packet.
-    interrupt->Schedule(ConsoleReadPoll, this,
-            CONSOLE_TIME, CONSOLE_READ_INT);
+    pollInterrupt = interrupt->Schedule(ConsoleReadPoll, this,
+                                        CONSOLE_TIME, CONSOLE_READ_INT);
 
     // Do nothing if character is already buffered, or none to be read.
     if (incoming != EOF || !SystemDep::PollFile(readFileNo)) {
@@ -124,7 +132,8 @@ void
 Console::WriteDone()
 {
     putBusy = false;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
+    stats->numConsoleWrites++;
     (*writeHandler)(handlerArg);
 }
 
@@ -147,6 +156,24 @@ Console::PutChar(char ch)
     ASSERT(!putBusy);
     SystemDep::WriteFile(writeFileNo, &ch, sizeof (char));
     putBusy = true;
-    interrupt->Schedule(ConsoleWriteDone, this,
-                        CONSOLE_TIME, CONSOLE_WRITE_INT);
+    putCount = 1;
+    writeInterrupt = interrupt->Schedule(ConsoleWriteDone, this,
+                                         CONSOLE_TIME, CONSOLE_WRITE_INT);
+}
+
+/// Write a whole buffer to the simulated display with a single host write,
+/// and schedule a single interrupt for it, as a device with its own output
+/// buffer would.
+void
+Console::PutBuffer(const char *buffer, unsigned size)
+{
+    ASSERT(!putBusy);
+    ASSERT(buffer != nullptr);
+    ASSERT(size > 0);
+
+    SystemDep::WriteFile(writeFileNo, buffer, size);
+    putBusy = true;
+    putCount = size;
+    writeInterrupt = interrupt->Schedule(ConsoleWriteDone, this,
+                                         CONSOLE_TIME, CONSOLE_WRITE_INT);
 }
@@ -24,6 +24,7 @@
 #define NACHOS_MACHINE_CONSOLE__HH
 
 
+#include "interrupt.hh"
 #include "lib/utility.hh"
 
 
@@ -53,6 +54,11 @@ public:
     /// `writeHandler` is called when the I/O completes.
     void PutChar(char ch);
 
+    /// Write the `size` characters of `buffer` to the console display at
+    /// once, and return immediately.  `writeHandler` is called a single
+    /// time, when the whole buffer has been put.
+    void PutBuffer(const char *buffer, unsigned size);
+
     /// Poll the console input.  If a char is available, return it.
     /// Otherwise, return EOF.  `readHandler` is called whenever there is a
     /// char to be gotten.
@@ -74,8 +80,11 @@ public:
     void *handlerArg;  ///< argument to be passed to the interrupt handlers.
     bool putBusy;  ///< Is a `PutChar` operation in progress?  If so, you
                    ///< cannot do another one!
+    unsigned putCount;  ///< Characters being put by that operation.
     char incoming;  ///< Contains the character to be read, if there is one
                     ///< available.  Otherwise contains EOF.
+    InterruptId pollInterrupt;   ///< Next keyboard poll.
+    InterruptId writeInterrupt;  ///< End of the `PutChar` in progress.
 };
 
 
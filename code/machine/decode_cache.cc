@@ -0,0 +1,33 @@
+#include "decode_cache.hh"
+#include "threads/system.hh"
+
+
+#ifdef DECODE_CACHE
+
+DecodeCache::DecodeCache(unsigned memorySize)
+{
+    numEntries = memorySize / 4;
+    entries = new Instruction [numEntries];
+
+    // Memory starts out zeroed, and a zero word decodes as any other, so
+    // every entry is valid from the start.
+    for (unsigned i = 0; i < numEntries; i++) {
+        entries[i].value = 0;
+        entries[i].Decode();
+    }
+}
+
+DecodeCache::~DecodeCache()
+{
+    delete [] entries;
+}
+
+void
+DecodeCache::Refill(Instruction *instr, unsigned raw)
+{
+    instr->value = raw;
+    instr->Decode();
+    stats->numDecodeCacheMisses++;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/// A cache of decoded instructions, indexed by physical address.
+///
+/// Fetching an instruction otherwise means reading its word from memory and
+/// decoding it every time it is executed, even in a tight loop.  With the
+/// cache, `Machine::FetchInstruction` only translates the PC and then
+/// dispatches on the `Instruction` already decoded for that word.
+///
+/// Main memory is written not only by user stores but by the kernel too,
+/// which loads pages, brings them back from swap, copies system call
+/// buffers and reuses frames, all directly through `mainMemory`.  Rather
+/// than hook each of those paths, every entry keeps the raw word it was
+/// decoded from, and is decoded again whenever memory no longer holds that
+/// word.  A write to a code frame, or reusing a frame for another page,
+/// invalidates exactly the entries whose words changed.
+
+#ifndef NACHOS_MACHINE_DECODECACHE__HH
+#define NACHOS_MACHINE_DECODECACHE__HH
+
+
+#include "instruction.hh"
+
+
+class DecodeCache {
+public:
+
+    /// Create a cache for `memorySize` bytes of physical memory.
+    DecodeCache(unsigned memorySize);
+
+    ~DecodeCache();
+
+    /// Return the decoded instruction at `physAddr`, whose word in memory
+    /// is `raw`, decoding it first if needed.
+    const Instruction *Lookup(unsigned physAddr, unsigned raw);
+
+private:
+
+    /// One entry per word of memory.  `value` of each entry is the word it
+    /// was decoded from.
+    Instruction *entries;
+    unsigned numEntries;
+
+    /// Decode `raw` into `instr`.
+    static void Refill(Instruction *instr, unsigned raw);
+};
+
+inline const Instruction *
+DecodeCache::Lookup(unsigned physAddr, unsigned raw)
+{
+    Instruction *instr = &entries[physAddr / 4];
+    if (instr->value != raw) {
+        Refill(instr, raw);
+    }
+    return instr;
+}
+
+
+#endif
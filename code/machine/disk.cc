@@ -193,7 +193,7 @@ Disk::TimeToSeek(unsigned newSector, unsigned *rotation)
     unsigned oldTrack = lastSector / SECTORS_PER_TRACK;
     unsigned seek = Diff(newTrack, oldTrack) * SEEK_TIME;
       // How long will seek take?
-    unsigned over = (stats->totalTicks + seek) % ROTATION_TIME;
+    unsigned over = (interrupt->DeviceClock() + seek) % ROTATION_TIME;
       // Will we be in the middle of a sector when we finish the seek?
 
     *rotation = 0;
@@ -235,7 +235,7 @@ Disk::ComputeLatency(unsigned newSector, bool writing)
 {
     unsigned rotation;
     unsigned seek      = TimeToSeek(newSector, &rotation);
-    unsigned timeAfter = stats->totalTicks + seek + rotation;
+    unsigned timeAfter = interrupt->DeviceClock() + seek + rotation;
 
 #ifndef NOTRACKBUF  // Turn this on if you do not want the track buffer
                     // stuff.
@@ -265,7 +265,7 @@ Disk::UpdateLast(unsigned newSector)
     unsigned seek = TimeToSeek(newSector, &rotate);
 
     if (seek != 0) {
-        bufferInit = stats->totalTicks + seek + rotate;
+        bufferInit = interrupt->DeviceClock() + seek + rotate;
     }
     lastSector = newSector;
     DEBUG('d', "Updating last sector = %u, %u\n", lastSector, bufferInit);
@@ -21,6 +21,7 @@
 
 
 #include "interrupt.hh"
+#include "interrupt_queue.hh"
 #include "threads/system.hh"
 
 #include <limits.h>
@@ -47,6 +48,14 @@ IsIntType(IntType t)
     return 0 <= t && t < NUM_INT_TYPES;
 }
 
+PendingInterrupt::PendingInterrupt()
+{
+    handler = nullptr;
+    arg     = nullptr;
+    when    = 0;
+    type    = TIMER_INT;
+}
+
 /// Initialize a hardware device interrupt that is to be scheduled to occur
 /// in the near future.
 ///
@@ -72,7 +81,8 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    pending       = new InterruptQueue;
+    nextDue       = ULONG_MAX;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
@@ -81,9 +91,6 @@ Interrupt::Interrupt()
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
-    }
     delete pending;
 }
 
@@ -149,20 +156,25 @@ Interrupt::OneTick()
     MachineStatus old = status;
 
     // Advance simulated time.
-    if (status == SYSTEM_MODE) {
-        stats->totalTicks += SYSTEM_TICK;
-        stats->systemTicks += SYSTEM_TICK;
-    } else {  // USER_PROGRAM
-        stats->totalTicks += USER_TICK;
-        stats->userTicks += USER_TICK;
-    }
+    AdvanceClock(1);
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
-    // Check any pending interrupts are now ready to fire.
-    ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
-                                   // handlers run with interrupts disabled).
-    while (CheckIfDue(false)) {}   // Check for pending interrupts.
-    ChangeLevel(INT_OFF, INT_ON);  // Re-enable interrupts.
+    // Check any pending interrupts are now ready to fire.  Most ticks,
+    // none is.
+#ifdef USER_PROGRAM
+    // Handlers are kernel code, and so is the yield they may ask for.
+    bool locked = false;
+#endif
+    if (DeviceClock() >= nextDue) {
+#ifdef USER_PROGRAM
+        locked = multiprocessor != nullptr && multiprocessor->EnterKernel();
+#endif
+        ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts
+                                       // (interrupt handlers run with
+                                       // interrupts disabled).
+        while (CheckIfDue(false)) {}   // Check for pending interrupts.
+        ChangeLevel(INT_OFF, INT_ON);  // Re-enable interrupts.
+    }
     if (yieldOnReturn) {           // If the timer device handler asked for a
                                    // context switch, ok to do it now.
         yieldOnReturn = false;
@@ -170,6 +182,62 @@ Interrupt::OneTick()
         currentThread->Yield();
         status = old;
     }
+#ifdef USER_PROGRAM
+    if (locked) {
+        multiprocessor->LeaveKernel();
+    }
+#endif
+}
+
+void
+Interrupt::AdvanceClock(unsigned long count)
+{
+    if (status == SYSTEM_MODE) {
+        stats->totalTicks += count * SYSTEM_TICK;
+        stats->systemTicks += count * SYSTEM_TICK;
+    } else {  // USER_PROGRAM
+        stats->totalTicks += count * USER_TICK;
+        stats->userTicks += count * USER_TICK;
+    }
+}
+
+void
+Interrupt::SetTicks(unsigned long ticks)
+{
+    if (ticks >= stats->totalTicks) {
+        pending->Postpone(ticks - stats->totalTicks);
+    } else {
+        pending->Rebase(stats->totalTicks - ticks);
+    }
+    UpdateNextDue();
+    stats->totalTicks = ticks;
+}
+
+unsigned long
+Interrupt::TicksUntilDue()
+{
+    if (nextDue == ULONG_MAX) {
+        return ULONG_MAX;
+    }
+    unsigned long now = DeviceClock();
+    return nextDue > now ? nextDue - now : 1;
+}
+
+void
+Interrupt::UpdateNextDue()
+{
+    nextDue = pending->IsEmpty() ? ULONG_MAX : pending->Head()->when;
+}
+
+unsigned long
+Interrupt::DeviceClock() const
+{
+#ifdef USER_PROGRAM
+    if (multiprocessor != nullptr) {
+        return multiprocessor->Now();
+    }
+#endif
+    return stats->totalTicks;
 }
 
 /// Called from within an interrupt handler, to cause a context switch (for
@@ -228,28 +296,18 @@ Interrupt::Halt()
 }
 
 #ifdef DFS_TICKS_FIX
-/// Restart the total ticks statistic and the pending interrupts list.
+/// Restart the total ticks statistic and the pending interrupt deadlines.
 ///
 /// This function makes sure Nachos keeps working even after overflowing the
-/// tick counter.  After some time (when `totalTicks` reach the maximum
-/// positive number) Nachos would schedule a pending interrupt at a negative
-/// time, and after that, it would hang.
+/// tick counter.  Deadlines are as wide as `unsigned long`, so on hosts
+/// where that is 64 bits wide this never happens in practice.
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
-        DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
-    }
-
-    delete oldPending;
+    DEBUG('x', "Interrupts re-scheduled %lu ticks earlier.\n",
+          stats->totalTicks);
+    pending->Rebase(stats->totalTicks);
+    UpdateNextDue();
     stats->totalTicks = 0;
     stats->tickResets += 1;
 }
@@ -258,7 +316,7 @@ Interrupt::RestartTicks()
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
-/// Implementation: just put it on a sorted list.
+/// Implementation: just put it on the queue of pending interrupts.
 ///
 /// NOTE: the Nachos kernel should not call this routine directly.  Instead,
 /// it is only called by the hardware device simulators.
@@ -268,7 +326,9 @@ Interrupt::RestartTicks()
 /// * `fromNow` is how far in the future (in simulated time) the interrupt is
 ///   to occur.
 /// * `type` is the hardware device that generated the interrupt.
-void
+///
+/// Returns the identifier of the interrupt, for `Cancel`.
+InterruptId
 Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
                     unsigned long fromNow, IntType type)
 {
@@ -277,24 +337,41 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     ASSERT(IsIntType(type));
 
 #ifdef DFS_TICKS_FIX
-    if (UINT_MAX - stats->totalTicks < fromNow) {
+    if (ULONG_MAX - DeviceClock() <= fromNow) {
         DEBUG('x', "WARNING: total tick count is too large"
                    " and will be reset.\n");
         RestartTicks();
     }
 #else
     // Terminate Nachos if the ticks overflowed.
-    ASSERT(ULONG_MAX - stats->totalTicks > fromNow);
+    ASSERT(ULONG_MAX - DeviceClock() > fromNow);
 #endif
 
-    unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+    unsigned long when = DeviceClock() + fromNow;
 
-    DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
+    DEBUG('i', "Scheduling interrupt handler the %s at time = %lu\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    InterruptId id = pending->Insert(handler, arg, when, type);
+    if (when < nextDue) {
+        nextDue = when;
+    }
+    return id;
+}
+
+/// Cancel an interrupt scheduled with `Schedule`, typically by a device
+/// that is going away.
+///
+/// * `id` is what `Schedule` returned for it.
+bool
+Interrupt::Cancel(InterruptId id)
+{
+    if (!pending->Remove(id)) {
+        return false;
+    }
+    DEBUG('i', "Cancelled interrupt %u\n", id);
+    UpdateNextDue();
+    return true;
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,36 +386,42 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
+    unsigned long now = DeviceClock();
+    if (!advanceClock && nextDue > now) {
+        return false;  // Nothing pending, or not time yet.
+    }
+    const PendingInterrupt *next = pending->Head();
 
-    if (toOccur == nullptr) {  // No pending interrupts.
+    if (next == nullptr) {  // No pending interrupts.
         return false;
     }
 
-    if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
-        stats->idleTicks += (when - stats->totalTicks);
-        stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
-        return false;
+    unsigned long when = next->when;
+    if (advanceClock && when > now) {  // Advance the clock.
+        stats->idleTicks += when - now;
+        stats->totalTicks += when - now;
     }
 
     // Check if there is nothing more to do, and if so, quit.
-    if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+    if (status == IDLE_MODE && next->type == TIMER_INT
+          && pending->Size() == 1) {
         return false;
     }
 
-    DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
-            INT_TYPE_NAMES[toOccur->type], toOccur->when);
+    // The handler may schedule more interrupts, so take this one out of
+    // the queue first.
+    PendingInterrupt toOccur = *next;
+    pending->Pop();
+    UpdateNextDue();
+
+    DEBUG('i', "Invoking interrupt handler for the %s at time %lu\n",
+            INT_TYPE_NAMES[toOccur.type], toOccur.when);
 #ifdef USER_PROGRAM
     if (machine != nullptr) {
         machine->DelayedLoad(0, 0);
@@ -347,10 +430,9 @@ Interrupt::CheckIfDue(bool advanceClock)
     inHandler = true;
     status = SYSTEM_MODE;  // Whatever we were doing, we are now going to be
                            // running in the kernel.
-    (*toOccur->handler)(toOccur->arg);  // Call the interrupt handler.
+    (*toOccur.handler)(toOccur.arg);  // Call the interrupt handler.
     status = old;  // Restore the machine status.
     inHandler = false;
-    delete toOccur;
     return true;
 }
 
@@ -375,7 +457,7 @@ Interrupt::SetStatus(MachineStatus st)
 /// Print information about an interrupt that is scheduled to occur.  When,
 /// where, why, etc.
 static void
-PrintPending(PendingInterrupt *pend)
+PrintPending(const PendingInterrupt *pend)
 {
     ASSERT(pend != nullptr);
 
@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/utility.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -77,6 +77,8 @@ enum IntType {
 class PendingInterrupt {
 public:
 
+    PendingInterrupt();
+
     /// initialize an interrupt that will occur in the future.
     PendingInterrupt(VoidFunctionPtr func, void *param,
                      unsigned long time, IntType kind);
@@ -89,6 +91,12 @@ public:
     IntType type;  ///< For debugging.
 };
 
+/// Identifies a scheduled interrupt, so that it can be cancelled.  No
+/// interrupt is ever identified by 0.
+typedef unsigned InterruptId;
+
+class InterruptQueue;
+
 /// The following class defines the data structures for the simulation
 /// of hardware interrupts.
 ///
@@ -139,16 +147,44 @@ public:
     /// Schedule an interrupt to occur at time ``when''.
     ///
     /// This is called by the hardware device simulators.
-    void Schedule(VoidFunctionPtr handler, void *arg,
-                  unsigned long when, IntType type);
+    InterruptId Schedule(VoidFunctionPtr handler, void *arg,
+                         unsigned long when, IntType type);
+
+    /// Cancel interrupt `id`, if it has not fired yet.  Return whether it
+    /// was still pending.
+    bool Cancel(InterruptId id);
 
     /// Advance simulated time.
     void OneTick();
 
+    /// Ticks that can pass before the earliest pending interrupt is due; at
+    /// least 1.
+    unsigned long TicksUntilDue();
+
+    /// Account for `count` ticks of the current mode without checking for
+    /// interrupts.  Only valid if none becomes due meanwhile (see
+    /// `TicksUntilDue`); used to run several user instructions per check.
+    void AdvanceClock(unsigned long count);
+
+    /// Set the total ticks to `ticks`, moving the pending interrupts along
+    /// so that each is still due as far in the future.  Used when restoring
+    /// a checkpoint.
+    void SetTicks(unsigned long ticks);
+
+    /// Time as devices see it, against which interrupts are scheduled and
+    /// fired: the total ticks, or on a multiprocessor the virtual time of
+    /// the CPU being simulated, so that devices take as long as they would
+    /// there.
+    unsigned long DeviceClock() const;
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    InterruptQueue *pending;  ///< The interrupts scheduled to occur in the
+                              ///< future.
+
+    /// When the earliest pending interrupt is due, or `ULONG_MAX` if there
+    /// is none; kept so that most ticks need not look at `pending`.
+    unsigned long nextDue;
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
@@ -159,12 +195,15 @@ private:
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
+    /// Recompute `nextDue` after the head of `pending` has changed.
+    void UpdateNextDue();
+
     /// SetLevel, without advancing the simulated time.
     void ChangeLevel(IntStatus old,
                      IntStatus now);
 
 #ifdef DFS_TICKS_FIX
-    /// Restart total ticks and the pending interrupt list.
+    /// Restart total ticks and the pending interrupt deadlines.
     void RestartTicks();
 #endif
 
@@ -0,0 +1,238 @@
+#include "interrupt_queue.hh"
+#include "lib/assert.hh"
+
+#include <limits.h>
+
+
+/// Entries in the pool at first; enough for every device at once.
+static const unsigned INITIAL_CAPACITY = 16;
+
+/// An identifier holds the index of its entry in its low 16 bits, and the
+/// generation of the entry in the high ones.
+static const unsigned INDEX_BITS = 16;
+static const unsigned INDEX_MASK = (1 << INDEX_BITS) - 1;
+
+InterruptQueue::InterruptQueue()
+{
+    pool = nullptr;
+    heap = nullptr;
+    capacity = 0;
+    size = 0;
+    freeList = FREE;
+    nextOrder = 0;
+    Grow();
+}
+
+InterruptQueue::~InterruptQueue()
+{
+    delete [] pool;
+    delete [] heap;
+}
+
+bool
+InterruptQueue::IsEmpty() const
+{
+    return size == 0;
+}
+
+unsigned
+InterruptQueue::Size() const
+{
+    return size;
+}
+
+InterruptId
+InterruptQueue::Insert(VoidFunctionPtr handler, void *arg,
+                       unsigned long when, IntType type)
+{
+    if (freeList == FREE) {
+        Grow();
+    }
+    unsigned entry = freeList;
+    Entry *e = &pool[entry];
+    freeList = e->nextFree;
+
+    e->interrupt = PendingInterrupt(handler, arg, when, type);
+    e->order = nextOrder++;
+    e->generation = (e->generation + 1) & INDEX_MASK;
+    if (e->generation == 0) {
+        e->generation = 1;  // Identifiers are never 0.
+    }
+    Place(size, entry);
+    size++;
+    SiftUp(e->position);
+
+    return e->generation << INDEX_BITS | entry;
+}
+
+const PendingInterrupt *
+InterruptQueue::Head() const
+{
+    return size == 0 ? nullptr : &pool[heap[0]].interrupt;
+}
+
+void
+InterruptQueue::Pop()
+{
+    ASSERT(size > 0);
+    RemoveAt(0);
+}
+
+bool
+InterruptQueue::Remove(InterruptId id)
+{
+    unsigned entry = id & INDEX_MASK;
+    if (entry >= capacity) {
+        return false;
+    }
+    const Entry *e = &pool[entry];
+    if (e->position == FREE || e->generation != id >> INDEX_BITS) {
+        return false;  // Already fired or cancelled.
+    }
+    RemoveAt(e->position);
+    return true;
+}
+
+void
+InterruptQueue::Rebase(unsigned long ticks)
+{
+    // Every deadline moves by the same amount, so the order holds.
+    for (unsigned i = 0; i < size; i++) {
+        PendingInterrupt *p = &pool[heap[i]].interrupt;
+        ASSERT(p->when >= ticks);
+        p->when -= ticks;
+    }
+}
+
+void
+InterruptQueue::Postpone(unsigned long ticks)
+{
+    for (unsigned i = 0; i < size; i++) {
+        PendingInterrupt *p = &pool[heap[i]].interrupt;
+        ASSERT(ULONG_MAX - p->when >= ticks);
+        p->when += ticks;
+    }
+}
+
+void
+InterruptQueue::Apply(void (*func)(const PendingInterrupt *)) const
+{
+    ASSERT(func != nullptr);
+
+    // Sort a copy of the heap; there are only ever a few entries.
+    unsigned *sorted = new unsigned [size];
+    for (unsigned i = 0; i < size; i++) {
+        unsigned j = i;
+        for (; j > 0 && Before(heap[i], sorted[j - 1]); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = heap[i];
+    }
+    for (unsigned i = 0; i < size; i++) {
+        func(&pool[sorted[i]].interrupt);
+    }
+    delete [] sorted;
+}
+
+bool
+InterruptQueue::Before(unsigned a, unsigned b) const
+{
+    const Entry *x = &pool[a];
+    const Entry *y = &pool[b];
+    return x->interrupt.when < y->interrupt.when
+           || (x->interrupt.when == y->interrupt.when && x->order < y->order);
+}
+
+void
+InterruptQueue::Place(unsigned i, unsigned entry)
+{
+    heap[i] = entry;
+    pool[entry].position = i;
+}
+
+void
+InterruptQueue::SiftUp(unsigned i)
+{
+    unsigned entry = heap[i];
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!Before(entry, heap[parent])) {
+            break;
+        }
+        Place(i, heap[parent]);
+        i = parent;
+    }
+    Place(i, entry);
+}
+
+void
+InterruptQueue::SiftDown(unsigned i)
+{
+    unsigned entry = heap[i];
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && Before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!Before(heap[child], entry)) {
+            break;
+        }
+        Place(i, heap[child]);
+        i = child;
+    }
+    Place(i, entry);
+}
+
+void
+InterruptQueue::RemoveAt(unsigned i)
+{
+    ASSERT(i < size);
+
+    unsigned entry = heap[i];
+    pool[entry].position = FREE;
+    pool[entry].nextFree = freeList;
+    freeList = entry;
+
+    size--;
+    if (i == size) {
+        return;
+    }
+    Place(i, heap[size]);
+    if (i > 0 && Before(heap[i], heap[(i - 1) / 2])) {
+        SiftUp(i);
+    } else {
+        SiftDown(i);
+    }
+}
+
+void
+InterruptQueue::Grow()
+{
+    unsigned newCapacity = capacity == 0 ? INITIAL_CAPACITY : 2 * capacity;
+    ASSERT(newCapacity <= 1U << INDEX_BITS);
+
+    Entry *newPool = new Entry [newCapacity];
+    unsigned *newHeap = new unsigned [newCapacity];
+    for (unsigned i = 0; i < capacity; i++) {
+        newPool[i] = pool[i];
+    }
+    for (unsigned i = 0; i < size; i++) {
+        newHeap[i] = heap[i];
+    }
+    // New entries go on the free list, first ones first.
+    for (unsigned i = newCapacity; i > capacity; i--) {
+        newPool[i - 1].position = FREE;
+        newPool[i - 1].generation = 0;
+        newPool[i - 1].nextFree = freeList;
+        freeList = i - 1;
+    }
+
+    delete [] pool;
+    delete [] heap;
+    pool = newPool;
+    heap = newHeap;
+    capacity = newCapacity;
+}
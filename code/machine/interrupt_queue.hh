@@ -0,0 +1,92 @@
+/// The queue of interrupts scheduled to occur in the future.
+///
+/// A binary min-heap ordered by deadline and, among interrupts due at the
+/// same tick, by the order in which they were scheduled, so that those fire
+/// first come, first served.  Entries live in a pool that grows as needed
+/// and is never shrunk, so once it is large enough scheduling an interrupt
+/// allocates nothing; the heap itself only holds pool indices.  Every entry
+/// knows its place in the heap, so that it can be cancelled through the
+/// identifier returned when it was inserted.
+///
+/// Insertion, removal of the head and cancellation take O(log n) time.
+
+#ifndef NACHOS_MACHINE_INTERRUPTQUEUE__HH
+#define NACHOS_MACHINE_INTERRUPTQUEUE__HH
+
+
+#include "interrupt.hh"
+
+
+class InterruptQueue {
+public:
+
+    /// Initialize an empty queue.
+    InterruptQueue();
+
+    ~InterruptQueue();
+
+    bool IsEmpty() const;
+
+    unsigned Size() const;
+
+    /// Add an interrupt due at `when`, and return its identifier.
+    InterruptId Insert(VoidFunctionPtr handler, void *arg,
+                       unsigned long when, IntType type);
+
+    /// Return the interrupt due first, or null if there is none.
+    const PendingInterrupt *Head() const;
+
+    /// Remove the interrupt due first.
+    void Pop();
+
+    /// Remove interrupt `id`.  Return whether it was still pending.
+    bool Remove(InterruptId id);
+
+    /// Bring every deadline `ticks` earlier.
+    void Rebase(unsigned long ticks);
+
+    /// Take every deadline `ticks` later.
+    void Postpone(unsigned long ticks);
+
+    /// Apply `func` to every pending interrupt, in the order they are due.
+    void Apply(void (*func)(const PendingInterrupt *)) const;
+
+private:
+
+    struct Entry {
+        PendingInterrupt interrupt;
+        unsigned long order;  ///< Sequence number of insertion.
+        unsigned position;    ///< Index in `heap`, or `FREE`.
+        unsigned generation;  ///< Tells apart successive uses of the entry.
+        unsigned nextFree;    ///< Next free entry, if this one is free.
+    };
+
+    static const unsigned FREE = (unsigned) -1;
+
+    Entry *pool;
+    unsigned capacity;
+    unsigned freeList;  ///< First free entry, or `FREE`.
+
+    unsigned *heap;     ///< Indices in `pool`; the first is due first.
+    unsigned size;
+
+    unsigned long nextOrder;
+
+    /// Whether entry `a` has to fire before entry `b`.
+    bool Before(unsigned a, unsigned b) const;
+
+    /// Put entry `entry` at index `i` of the heap.
+    void Place(unsigned i, unsigned entry);
+
+    void SiftUp(unsigned i);
+    void SiftDown(unsigned i);
+
+    /// Remove the entry at index `i` of the heap, and free it.
+    void RemoveAt(unsigned i);
+
+    /// Double the size of the pool.
+    void Grow();
+};
+
+
+#endif
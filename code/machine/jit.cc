@@ -0,0 +1,590 @@
+#include "jit.hh"
+#include "machine.hh"
+#include "encoding.hh"
+#include "threads/system.hh"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+#ifdef JIT
+
+/// Host registers.  `RBX` holds the address of the MIPS registers, `R12`
+/// the machine, and `R13` is the scratch register for branch targets and
+/// loaded values; these are all preserved across calls.  `RAX`, `RCX` and
+/// `RDX` are free within an instruction.
+enum {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7,
+    R12 = 12, R13 = 13
+};
+
+/// Arithmetic operations, as encoded in their opcode.
+enum {
+    ADD = 0, OR = 1, AND = 4, SUB = 5, XOR = 6, CMP = 7
+};
+
+/// Shift operations.
+enum {
+    SHL = 4, SAR = 7
+};
+
+/// Condition codes.
+enum {
+    BELOW = 0x2, EQUAL = 0x4, NOT_EQUAL = 0x5, LESS = 0xC,
+    GREATER_EQUAL = 0xD, LESS_EQUAL = 0xE, GREATER = 0xF
+};
+
+/// More than enough for the code of any block.
+const unsigned MAX_CODE_PER_BLOCK = 64 + 256 * MAX_BLOCK_LENGTH;
+
+Jit *
+Jit::Create(BlockCache *cache, unsigned threshold, bool checking)
+{
+    void *p = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+    // Find out now whether the host lets the memory be executed.
+    if (mprotect(p, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        munmap(p, JIT_CODE_SIZE);
+        return nullptr;
+    }
+    return new Jit(cache, threshold, checking, (unsigned char *) p);
+}
+
+Jit::Jit(BlockCache *cache_, unsigned threshold_, bool checking_,
+         unsigned char *area_)
+{
+    ASSERT(cache_ != nullptr);
+    ASSERT(threshold_ > 0);
+    ASSERT(area_ != nullptr);
+
+    cache = cache_;
+    threshold = threshold_;
+    checking = checking_;
+
+    area = area_;
+    used = 0;
+    pos = area;
+    disabled = false;
+
+    trace = checking ? new int [MAX_BLOCK_LENGTH * NUM_TOTAL_REGS] : nullptr;
+    numStores = 0;
+}
+
+Jit::~Jit()
+{
+    munmap(area, JIT_CODE_SIZE);
+    delete [] trace;
+}
+
+BlockCode
+Jit::Lookup(BasicBlock *block)
+{
+    if (block->code == nullptr && ++block->runs == threshold
+          && !disabled) {
+        block->code = Compile(block);
+    }
+    return block->code;
+}
+
+bool
+Jit::Protect(bool writable)
+{
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+    if (mprotect(area, JIT_CODE_SIZE, prot) == 0) {
+        return true;
+    }
+
+    // The code already compiled may not be executable any more.
+    cache->DropCode();
+    disabled = true;
+    DEBUG('m', "Code memory cannot be protected; interpreting from now on\n");
+    return false;
+}
+
+void
+Jit::StartRecord()
+{
+    numStores = 0;
+}
+
+void
+Jit::RecordRegisters(unsigned index, const int *registers)
+{
+    ASSERT(index < MAX_BLOCK_LENGTH);
+    memcpy(&trace[index * NUM_TOTAL_REGS], registers,
+           NUM_TOTAL_REGS * sizeof *registers);
+}
+
+const int *
+Jit::RecordedRegisters(unsigned index) const
+{
+    ASSERT(index < MAX_BLOCK_LENGTH);
+    return &trace[index * NUM_TOTAL_REGS];
+}
+
+void
+Jit::RecordStore(unsigned physAddr, unsigned oldWord, unsigned newWord)
+{
+    ASSERT(numStores < MAX_BLOCK_LENGTH);
+    stores[numStores].physAddr = physAddr;
+    stores[numStores].oldWord = oldWord;
+    stores[numStores].newWord = newWord;
+    numStores++;
+}
+
+void
+Jit::UndoStores(char *memory) const
+{
+    for (unsigned i = numStores; i > 0; i--) {
+        *(unsigned *) &memory[stores[i - 1].physAddr] = stores[i - 1].oldWord;
+    }
+}
+
+bool
+Jit::StoresMatch(const char *memory) const
+{
+    // Only the last store to each word counts.
+    for (unsigned i = 0; i < numStores; i++) {
+        bool last = true;
+        for (unsigned j = i + 1; j < numStores; j++) {
+            last = last && stores[j].physAddr != stores[i].physAddr;
+        }
+        if (last && *(const unsigned *) &memory[stores[i].physAddr]
+                      != stores[i].newWord) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Jit::CanCompile(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_ADDIU: case OP_ADDU: case OP_SUBU:
+        case OP_AND: case OP_ANDI: case OP_OR: case OP_ORI:
+        case OP_XOR: case OP_XORI: case OP_NOR: case OP_LUI:
+        case OP_SLL: case OP_SLLV: case OP_SRA: case OP_SRAV:
+        case OP_SLT: case OP_SLTI: case OP_SLTU: case OP_SLTIU:
+        case OP_MFHI: case OP_MFLO: case OP_MTHI: case OP_MTLO:
+        case OP_BEQ: case OP_BNE: case OP_BLEZ: case OP_BGTZ:
+        case OP_BLTZ: case OP_BGEZ:
+        case OP_J: case OP_JAL: case OP_JR: case OP_JALR:
+        case OP_LW: case OP_SW:
+            return true;
+        default:
+            return false;
+    }
+}
+
+BlockCode
+Jit::Compile(const BasicBlock *block)
+{
+    for (unsigned i = 0; i < block->length; i++) {
+        if (!CanCompile(block->instrs[i].opCode)) {
+            return nullptr;
+        }
+    }
+
+    if (!Protect(true)) {
+        return nullptr;
+    }
+    if (used + MAX_CODE_PER_BLOCK > JIT_CODE_SIZE) {
+        cache->DropCode();
+        used = 0;
+    }
+    unsigned char *start = area + used;
+    pos = start;
+
+    // Save the registers we use, and keep the stack aligned with room for
+    // the value of a load.
+    Byte(0x53);                               // push rbx
+    Byte(0x41); Byte(0x54);                   // push r12
+    Byte(0x41); Byte(0x55);                   // push r13
+    Byte(0x48); Byte(0x83); Byte(0xEC); Byte(0x10);  // sub rsp, 16
+    Byte(0x48); Byte(0x89); Byte(0xFB);       // mov rbx, rdi
+    Byte(0x49); Byte(0x89); Byte(0xF4);       // mov r12, rsi
+
+    for (unsigned i = 0; i < block->length; i++) {
+        CompileInstruction(&block->instrs[i], i);
+    }
+    EmitExit(block->length);
+
+    ASSERT((unsigned) (pos - start) <= MAX_CODE_PER_BLOCK);
+    used = (pos - area + 15) & ~15U;
+    if (!Protect(false)) {
+        return nullptr;
+    }
+    stats->numBlocksCompiled++;
+    return (BlockCode) start;
+}
+
+void
+Jit::CompileInstruction(const Instruction *instr, unsigned index)
+{
+    bool branch = false;
+    bool loaded = false;
+    bool stored = false;
+    unsigned char *skip;
+
+    switch (instr->opCode) {
+        case OP_ADDIU:
+            LoadRegister(RAX, instr->rs);
+            ArithConstant(ADD, RAX, instr->extra);
+            StoreRegister(instr->rt, RAX);
+            break;
+
+        case OP_ADDU:
+        case OP_SUBU:
+        case OP_AND:
+        case OP_OR:
+        case OP_XOR:
+        case OP_NOR:
+            LoadRegister(RAX, instr->rs);
+            LoadRegister(RCX, instr->rt);
+            switch (instr->opCode) {
+                case OP_ADDU: Arith(ADD, RAX, RCX); break;
+                case OP_SUBU: Arith(SUB, RAX, RCX); break;
+                case OP_AND:  Arith(AND, RAX, RCX); break;
+                case OP_XOR:  Arith(XOR, RAX, RCX); break;
+                default:      Arith(OR, RAX, RCX); break;
+            }
+            if (instr->opCode == OP_NOR) {
+                Byte(0xF7); Byte(0xD0);       // not eax
+            }
+            StoreRegister(instr->rd, RAX);
+            break;
+
+        case OP_ANDI:
+        case OP_ORI:
+        case OP_XORI:
+            LoadRegister(RAX, instr->rs);
+            ArithConstant(instr->opCode == OP_ANDI ? AND
+                            : instr->opCode == OP_ORI ? OR : XOR,
+                          RAX, instr->extra & 0xFFFF);
+            StoreRegister(instr->rt, RAX);
+            break;
+
+        case OP_LUI:
+            StoreConstant(instr->rt, instr->extra << 16);
+            break;
+
+        case OP_SLL:
+        case OP_SRA:
+            LoadRegister(RAX, instr->rt);
+            Shift(instr->opCode == OP_SLL ? SHL : SAR, instr->extra);
+            StoreRegister(instr->rd, RAX);
+            break;
+
+        case OP_SLLV:
+        case OP_SRAV:
+            // The host masks the count to 5 bits, as the simulator does.
+            LoadRegister(RAX, instr->rt);
+            LoadRegister(RCX, instr->rs);
+            ShiftByCl(instr->opCode == OP_SLLV ? SHL : SAR);
+            StoreRegister(instr->rd, RAX);
+            break;
+
+        case OP_SLT:
+        case OP_SLTU:
+            LoadRegister(RAX, instr->rs);
+            LoadRegister(RCX, instr->rt);
+            Arith(CMP, RAX, RCX);
+            SetFlag(instr->opCode == OP_SLT ? LESS : BELOW);
+            StoreRegister(instr->rd, RAX);
+            break;
+
+        case OP_SLTI:
+        case OP_SLTIU:
+            LoadRegister(RAX, instr->rs);
+            ArithConstant(CMP, RAX, instr->extra);
+            SetFlag(instr->opCode == OP_SLTI ? LESS : BELOW);
+            StoreRegister(instr->rt, RAX);
+            break;
+
+        case OP_MFHI:
+        case OP_MFLO:
+            LoadRegister(RAX, instr->opCode == OP_MFHI ? HI_REG : LO_REG);
+            StoreRegister(instr->rd, RAX);
+            break;
+
+        case OP_MTHI:
+        case OP_MTLO:
+            LoadRegister(RAX, instr->rs);
+            StoreRegister(instr->opCode == OP_MTHI ? HI_REG : LO_REG, RAX);
+            break;
+
+        case OP_BEQ:
+        case OP_BNE:
+        case OP_BLEZ:
+        case OP_BGTZ:
+        case OP_BLTZ:
+        case OP_BGEZ:
+            // Not taken: the instruction after the delay slot.
+            LoadRegister(RDX, NEXT_PC_REG);
+            Byte(0x41); Byte(0x89); Byte(0xD5);  // mov r13d, edx
+            ArithConstant(ADD, R13, 4);
+
+            LoadRegister(RAX, instr->rs);
+            if (instr->opCode == OP_BEQ || instr->opCode == OP_BNE) {
+                LoadRegister(RCX, instr->rt);
+                Arith(CMP, RAX, RCX);
+            } else {
+                Byte(0x85); Byte(0xC0);          // test eax, eax
+            }
+            switch (instr->opCode) {
+                case OP_BEQ:  skip = Jump(NOT_EQUAL); break;
+                case OP_BNE:  skip = Jump(EQUAL); break;
+                case OP_BLEZ: skip = Jump(GREATER); break;
+                case OP_BGTZ: skip = Jump(LESS_EQUAL); break;
+                case OP_BLTZ: skip = Jump(GREATER_EQUAL); break;
+                default:      skip = Jump(LESS); break;
+            }
+            Byte(0x41); Byte(0x89); Byte(0xD5);  // mov r13d, edx
+            ArithConstant(ADD, R13, IndexToAddr(instr->extra));
+            Patch(skip);
+            branch = true;
+            break;
+
+        case OP_J:
+        case OP_JAL:
+            LoadRegister(RDX, NEXT_PC_REG);
+            Byte(0x41); Byte(0x89); Byte(0xD5);  // mov r13d, edx
+            ArithConstant(ADD, R13, 4);
+            if (instr->opCode == OP_JAL) {
+                StoreRegister(RET_ADDR_REG, R13);
+            }
+            ArithConstant(AND, R13, 0xF0000000);
+            ArithConstant(OR, R13, IndexToAddr(instr->extra));
+            branch = true;
+            break;
+
+        case OP_JALR:
+            LoadRegister(RAX, NEXT_PC_REG);
+            ArithConstant(ADD, RAX, 4);
+            StoreRegister(instr->rd, RAX);
+            // Fall through.
+        case OP_JR:
+            LoadRegister(R13, instr->rs);
+            branch = true;
+            break;
+
+        case OP_LW:
+            LoadRegister(RDX, instr->rs);
+            ArithConstant(ADD, RDX, instr->extra);
+            Byte(0x48); Byte(0x89); Byte(0xE1);  // mov rcx, rsp
+            EmitCall((const void *) &Machine::JitLoadWord, index);
+            Byte(0x84); Byte(0xC0);              // test al, al
+            skip = Jump(NOT_EQUAL);
+            EmitExit(index);
+            Patch(skip);
+            Byte(0x44); Byte(0x8B); Byte(0x2C); Byte(0x24);  // mov r13d, [rsp]
+            loaded = true;
+            break;
+
+        case OP_SW:
+            LoadRegister(RDX, instr->rs);
+            ArithConstant(ADD, RDX, instr->extra);
+            LoadRegister(RCX, instr->rt);
+            EmitCall((const void *) &Machine::JitStoreWord, index);
+            Byte(0x83); Byte(0xF8); Byte(JIT_STORE_FAILED);  // cmp eax, ...
+            skip = Jump(NOT_EQUAL);
+            EmitExit(index);
+            Patch(skip);
+            Byte(0x41); Byte(0x89); Byte(0xC5);  // mov r13d, eax
+            stored = true;
+            break;
+
+        default:
+            ASSERT(false);
+    }
+
+    EmitRetire(branch, loaded, instr->rt);
+
+    if (checking) {
+        EmitCall((const void *) &Machine::JitTrace, index);
+    }
+    if (stored) {
+        // Stop if the block has just overwritten itself.
+        ArithConstant(CMP, R13, JIT_STORE_DONE);
+        skip = Jump(EQUAL);
+        EmitExit(index + 1);
+        Patch(skip);
+    }
+}
+
+void
+Jit::EmitRetire(bool branch, bool loaded, unsigned loadReg)
+{
+    // Do any delayed load operation, and record the new one.
+    LoadRegister(RAX, LOAD_REG);
+    LoadRegister(RCX, LOAD_VALUE_REG);
+    Byte(0x89); Byte(0x0C); Byte(0x83);      // mov [rbx + rax * 4], ecx
+    if (loaded) {
+        StoreConstant(LOAD_REG, loadReg);
+        StoreRegister(LOAD_VALUE_REG, R13);
+    } else {
+        StoreConstant(LOAD_REG, 0);
+        StoreConstant(LOAD_VALUE_REG, 0);
+    }
+    StoreConstant(0, 0);
+
+    // Advance program counters.
+    LoadRegister(RAX, PC_REG);
+    StoreRegister(PREV_PC_REG, RAX);
+    LoadRegister(RAX, NEXT_PC_REG);
+    StoreRegister(PC_REG, RAX);
+    if (branch) {
+        StoreRegister(NEXT_PC_REG, R13);
+    } else {
+        ArithConstant(ADD, RAX, 4);
+        StoreRegister(NEXT_PC_REG, RAX);
+    }
+}
+
+void
+Jit::EmitExit(unsigned count)
+{
+    MoveConstant(RAX, count);
+    Byte(0x48); Byte(0x83); Byte(0xC4); Byte(0x10);  // add rsp, 16
+    Byte(0x41); Byte(0x5D);                   // pop r13
+    Byte(0x41); Byte(0x5C);                   // pop r12
+    Byte(0x5B);                               // pop rbx
+    Byte(0xC3);                               // ret
+}
+
+void
+Jit::EmitCall(const void *function, unsigned index)
+{
+    Byte(0x4C); Byte(0x89); Byte(0xE7);       // mov rdi, r12
+    MoveConstant(RSI, index);
+    Byte(0x48); Byte(0xB8);                   // mov rax, function
+    uint64_t address = (uintptr_t) function;
+    Word((unsigned) address);
+    Word((unsigned) (address >> 32));
+    Byte(0xFF); Byte(0xD0);                   // call rax
+}
+
+void
+Jit::Byte(unsigned char b)
+{
+    *pos++ = b;
+}
+
+void
+Jit::Word(unsigned w)
+{
+    memcpy(pos, &w, 4);  // The host is little-endian.
+    pos += 4;
+}
+
+/// Emit `op` between host register `reg` and MIPS register `mipsReg`,
+/// addressed through `RBX`.
+void
+Jit::RegisterOperand(unsigned char op, unsigned reg, unsigned mipsReg)
+{
+    if (reg >= 8) {
+        Byte(0x44);                           // REX.R
+    }
+    Byte(op);
+    Byte(0x80 | (reg & 7) << 3 | RBX);
+    Word(4 * mipsReg);
+}
+
+void
+Jit::LoadRegister(unsigned reg, unsigned mipsReg)
+{
+    RegisterOperand(0x8B, reg, mipsReg);      // mov reg, [rbx + disp]
+}
+
+void
+Jit::StoreRegister(unsigned mipsReg, unsigned reg)
+{
+    RegisterOperand(0x89, reg, mipsReg);      // mov [rbx + disp], reg
+}
+
+void
+Jit::StoreConstant(unsigned mipsReg, unsigned value)
+{
+    RegisterOperand(0xC7, 0, mipsReg);        // mov dword [rbx + disp], imm
+    Word(value);
+}
+
+void
+Jit::MoveConstant(unsigned reg, unsigned value)
+{
+    if (reg >= 8) {
+        Byte(0x41);                           // REX.B
+    }
+    Byte(0xB8 + (reg & 7));                   // mov reg, imm
+    Word(value);
+}
+
+/// `dst op= src`, for registers below `R8`.
+void
+Jit::Arith(unsigned op, unsigned dst, unsigned src)
+{
+    ASSERT(dst < 8 && src < 8);
+    Byte(op << 3 | 1);
+    Byte(0xC0 | src << 3 | dst);
+}
+
+void
+Jit::ArithConstant(unsigned op, unsigned reg, unsigned value)
+{
+    if (reg >= 8) {
+        Byte(0x41);                           // REX.B
+    }
+    Byte(0x81);
+    Byte(0xC0 | op << 3 | (reg & 7));
+    Word(value);
+}
+
+/// Shift `EAX` by `count`.
+void
+Jit::Shift(unsigned op, unsigned count)
+{
+    Byte(0xC1);
+    Byte(0xC0 | op << 3);
+    Byte(count);
+}
+
+/// Shift `EAX` by `CL`.
+void
+Jit::ShiftByCl(unsigned op)
+{
+    Byte(0xD3);
+    Byte(0xC0 | op << 3);
+}
+
+/// Set `EAX` to 1 if `condition` holds, and to 0 otherwise.
+void
+Jit::SetFlag(unsigned condition)
+{
+    Byte(0x0F); Byte(0x90 | condition); Byte(0xC0);  // setcc al
+    Byte(0x0F); Byte(0xB6); Byte(0xC0);              // movzx eax, al
+}
+
+/// Emit a jump taken if `condition` holds, to be aimed later with `Patch`.
+unsigned char *
+Jit::Jump(unsigned condition)
+{
+    Byte(0x0F); Byte(0x80 | condition);
+    unsigned char *jump = pos;
+    Word(0);
+    return jump;
+}
+
+/// Aim `jump` at the next instruction emitted.
+void
+Jit::Patch(unsigned char *jump)
+{
+    unsigned offset = pos - (jump + 4);
+    memcpy(jump, &offset, 4);
+}
+
+#endif
@@ -0,0 +1,160 @@
+/// A just-in-time compiler from basic blocks of user code to x86-64 code.
+///
+/// The block interpreter still makes an indirect call per instruction, and
+/// goes through `Retire` for every delayed load and program counter update.
+/// Blocks run often enough are compiled instead, into host code that does
+/// the same work inline.
+///
+/// The compiled code keeps every MIPS register in `Machine::registers` and
+/// updates the delayed load and program counter registers after each
+/// instruction exactly as `Retire` does, so it may stop after any of them.
+/// Loads and stores call back into the machine (`Machine::JitLoadWord` and
+/// `Machine::JitStoreWord`), which translate through the MMU and may raise
+/// an exception; the code then returns at once, with the number of
+/// instructions completed.  A store into the block itself stops it after
+/// that instruction.  Blocks holding any instruction not compiled here
+/// (see `CanCompile`) are left to the interpreter.
+///
+/// In checking mode, the compiled code also records the registers after
+/// every instruction, so that `Machine::CheckCompiled` can run the block
+/// again through the interpreter and compare them one by one.
+///
+/// The memory for compiled code is never writable and executable at once:
+/// it is made writable only while a block is being compiled.  If the host
+/// refuses to map it or to make it executable, blocks are interpreted.
+///
+/// The compiler is off unless `-jit` is given.  Only x86-64 hosts are
+/// supported; `Makefile.env` turns `JIT` off on any other.
+
+#ifndef NACHOS_MACHINE_JIT__HH
+#define NACHOS_MACHINE_JIT__HH
+
+
+#include "block_cache.hh"
+
+
+/// Number of runs after which a block is compiled; 0 for never.
+const unsigned DEFAULT_JIT_THRESHOLD = 0;
+
+/// Bytes of executable memory for compiled code.  When they run out, the
+/// code of every block is thrown away.
+const unsigned JIT_CODE_SIZE = 1 << 20;
+
+/// Results of `Machine::JitStoreWord`.
+enum {
+    JIT_STORE_FAILED,    ///< An exception was raised.
+    JIT_STORE_DONE,
+    JIT_STORE_HIT_CODE   ///< The word stored is in the running block.
+};
+
+class Jit {
+public:
+
+    /// Compile blocks of `cache` once they have been run `threshold` times.
+    /// With `checking`, compiled code records the registers after each
+    /// instruction.  Return null if the memory for the code cannot be set
+    /// up.
+    static Jit *Create(BlockCache *cache, unsigned threshold, bool checking);
+
+    ~Jit();
+
+    /// Count a run of `block` and return its compiled code, compiling it
+    /// if it has just become hot, or null if it has none.
+    BlockCode Lookup(BasicBlock *block);
+
+    bool IsChecking() const;
+
+    /// Record of a run of compiled code, for checking mode.
+
+    /// Forget the stores of the previous run.
+    void StartRecord();
+
+    void RecordRegisters(unsigned index, const int *registers);
+
+    /// Registers after instruction `index` of the last run.
+    const int *RecordedRegisters(unsigned index) const;
+
+    /// Record a store over `oldWord` at `physAddr`; words are kept as they
+    /// are in memory.
+    void RecordStore(unsigned physAddr, unsigned oldWord, unsigned newWord);
+
+    /// Put back in `memory` the words overwritten by the recorded stores.
+    void UndoStores(char *memory) const;
+
+    /// Whether `memory` holds the words written by the recorded stores.
+    bool StoresMatch(const char *memory) const;
+
+private:
+
+    /// `area` is the memory for compiled code, already mapped.
+    Jit(BlockCache *cache, unsigned threshold, bool checking,
+        unsigned char *area);
+
+    /// Compile `block`; return null if it holds some instruction that is
+    /// not supported, or if the code memory cannot be written.
+    BlockCode Compile(const BasicBlock *block);
+
+    /// Make the code memory writable, or executable if not `writable`.
+    /// Return false if the host does not allow it.
+    bool Protect(bool writable);
+
+    static bool CanCompile(unsigned char opCode);
+
+    /// Emit the code of instruction `index` of a block.
+    void CompileInstruction(const Instruction *instr, unsigned index);
+
+    /// Emit the equivalent of `Retire`.  The new program counter is taken
+    /// from the scratch register if `branch`; so is the value of a new
+    /// delayed load into `loadReg` if `loaded`.
+    void EmitRetire(bool branch, bool loaded, unsigned loadReg);
+
+    /// Emit a return with `count` instructions completed.
+    void EmitExit(unsigned count);
+
+    /// Emit a call to `function`, with the machine and `index` as its
+    /// first two arguments; the rest must be in place already.
+    void EmitCall(const void *function, unsigned index);
+
+    /// x86-64 encoding helpers.
+    void Byte(unsigned char b);
+    void Word(unsigned w);
+    void RegisterOperand(unsigned char op, unsigned reg, unsigned mipsReg);
+    void LoadRegister(unsigned reg, unsigned mipsReg);
+    void StoreRegister(unsigned mipsReg, unsigned reg);
+    void StoreConstant(unsigned mipsReg, unsigned value);
+    void MoveConstant(unsigned reg, unsigned value);
+    void Arith(unsigned op, unsigned dst, unsigned src);
+    void ArithConstant(unsigned op, unsigned reg, unsigned value);
+    void Shift(unsigned op, unsigned count);
+    void ShiftByCl(unsigned op);
+    void SetFlag(unsigned condition);
+    unsigned char *Jump(unsigned condition);
+    void Patch(unsigned char *jump);
+
+    BlockCache *cache;
+    unsigned threshold;
+    bool checking;
+
+    unsigned char *area;  ///< Memory for compiled code.
+    unsigned used;        ///< Bytes of it taken.
+    unsigned char *pos;   ///< Where the next byte is emitted.
+    bool disabled;        ///< The host refused to protect `area`.
+
+    /// Checking mode record: registers after each instruction, and stores.
+    int *trace;
+    struct Store {
+        unsigned physAddr;
+        unsigned oldWord;
+        unsigned newWord;
+    } stores[MAX_BLOCK_LENGTH];
+    unsigned numStores;
+};
+
+inline bool
+Jit::IsChecking() const
+{
+    return checking;
+}
+
+
+#endif
@@ -11,6 +11,8 @@
 #include "machine.hh"
 #include "threads/system.hh"
 
+#include <stdio.h>
+
 
 static inline bool
 IsExceptionType(ExceptionType t)
@@ -56,7 +58,104 @@ Machine::Machine(SingleStepper *st)
     }
 
     singleStepper = st;
+    trace = nullptr;
+    tlbs = nullptr;
+    numCpus = 1;
     CheckEndian();
+
+#ifdef DECODE_CACHE
+    decodeCache = new DecodeCache(MEMORY_SIZE);
+#endif
+#ifdef BLOCK_INTERPRETER
+    blockCache = new BlockCache;
+    blockTicks = 0;
+    numExceptions = 0;
+#endif
+#ifdef JIT
+    jit = nullptr;
+    compiledBlock = nullptr;
+    compiledFetches = 0;
+#endif
+}
+
+Machine::~Machine()
+{
+    delete trace;
+    if (tlbs != nullptr) {
+        // The MMU deletes the TLB of the first CPU.
+        mmu.tlb = tlbs[0];
+        for (unsigned i = 1; i < numCpus; i++) {
+            delete [] tlbs[i];
+        }
+        delete [] tlbs;
+    }
+#ifdef DECODE_CACHE
+    delete decodeCache;
+#endif
+#ifdef JIT
+    delete jit;
+#endif
+#ifdef BLOCK_INTERPRETER
+    delete blockCache;
+#endif
+}
+
+#ifdef JIT
+void
+Machine::EnableJit(unsigned threshold, bool checking)
+{
+    ASSERT(jit == nullptr);
+    jit = Jit::Create(blockCache, threshold, checking);
+    if (jit == nullptr) {
+        fprintf(stderr, "Unable to map memory for compiled code; user"
+                " programs will be interpreted.\n");
+    }
+}
+#endif
+
+void
+Machine::EnableTrace(const char *fileName, unsigned capacity)
+{
+    ASSERT(trace == nullptr);
+    trace = new TraceBuffer(fileName, capacity);
+}
+
+void
+Machine::SetNumCpus(unsigned n)
+{
+    ASSERT(tlbs == nullptr);
+    ASSERT(n > 0);
+
+    numCpus = n;
+    if (mmu.tlb == nullptr) {
+        return;
+    }
+    tlbs = new TranslationEntry * [n];
+    tlbs[0] = mmu.tlb;
+    for (unsigned i = 1; i < n; i++) {
+        tlbs[i] = new TranslationEntry [TLB_SIZE];
+        for (unsigned j = 0; j < TLB_SIZE; j++) {
+            tlbs[i][j].valid = false;
+        }
+    }
+}
+
+void
+Machine::SelectCpu(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    if (tlbs != nullptr) {
+        mmu.tlb = tlbs[cpu];
+    }
+}
+
+TranslationEntry *
+Machine::GetTlb(unsigned cpu)
+{
+    ASSERT(cpu < numCpus);
+
+    return tlbs != nullptr ? tlbs[cpu] : mmu.tlb;
 }
 
 const int *
@@ -115,6 +214,18 @@ Machine::WriteMem(unsigned addr, unsigned size, int value)
     return true;
 }
 
+bool
+Machine::Translate(unsigned addr, unsigned *physAddr, bool writing)
+{
+    ExceptionType e = mmu.Translate(addr, physAddr, 1, writing);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, addr);
+        return false;
+    }
+    stats->numPageHits++;
+    return true;
+}
+
 /// Transfer control to the Nachos kernel from user mode, because the user
 /// program either invoked a system call, or some exception occured (such as
 /// the address translation failed).
@@ -128,14 +239,28 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     ASSERT(handlers[et] != nullptr);  // There must be a handler associated.
 
     DEBUG('m', "Exception: %s\n", ExceptionTypeToString(et));
+    if (trace != nullptr) {
+        trace->Raised(et, badVAddr);
+    }
 
     //ASSERT(interrupt->GetStatus() == USER_MODE);
+#ifdef BLOCK_INTERPRETER
+    numExceptions++;
+    if (blockTicks > 0) {
+        interrupt->AdvanceClock(blockTicks);
+        blockTicks = 0;
+    }
+#endif
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
     // Call the associated handler with interrupts enabled in system mode.
     interrupt->SetStatus(SYSTEM_MODE);
+    bool locked = multiprocessor != nullptr && multiprocessor->EnterKernel();
     (*handlers[et])(et);
+    if (locked) {
+        multiprocessor->LeaveKernel();
+    }
     interrupt->SetStatus(USER_MODE);
 }
 
@@ -24,6 +24,16 @@
 #include "exception_type.hh"
 #include "mmu.hh"
 #include "single_stepper.hh"
+#include "trace_buffer.hh"
+#ifdef DECODE_CACHE
+#include "decode_cache.hh"
+#endif
+#ifdef BLOCK_INTERPRETER
+#include "block_cache.hh"
+#endif
+#ifdef JIT
+#include "jit.hh"
+#endif
 #include "lib/utility.hh"
 
 
@@ -62,14 +72,16 @@ typedef void (*ExceptionHandler)(ExceptionType);
 /// If we were to implement more of the UNIX system calls, we ought to be
 /// able to run Nachos on top of Nachos!
 ///
-/// The procedures in this class are defined in `machine.cc` and
-/// `mips_sim.cc`.
+/// The procedures in this class are defined in `machine.cc`, `mips_sim.cc`
+/// and, for the block interpreter, `mips_blocks.cc`.
 class Machine {
 public:
 
     /// Initialize the simulation of the hardware for running user programs.
     Machine(SingleStepper *st);
 
+    ~Machine();
+
     /// Routines callable by the Nachos kernel.
 
     /// Run a user program.
@@ -92,15 +104,44 @@ public:
 
     bool WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Translate `addr` for the kernel, which is going to access the byte
+    /// there, and possibly the rest of its page, directly in main memory.
+    /// The use and dirty bits are set as if the byte had been accessed.
+    bool Translate(unsigned addr, unsigned *physAddr, bool writing);
+
     /// Print the user CPU and memory state.
     void DumpState();
 
+#ifdef JIT
+    /// Compile blocks to host code once they have run `threshold` times;
+    /// with `checking`, compare every run of compiled code against the
+    /// interpreter.  If the host does not allow it, say so and go on
+    /// interpreting.
+    void EnableJit(unsigned threshold, bool checking);
+#endif
+
+    /// Record the last `capacity` instructions run in the UNIX file
+    /// `fileName`.  Instructions are then run one at a time.
+    void EnableTrace(const char *fileName, unsigned capacity);
+
+    /// Give the machine `n` CPUs sharing main memory.  The kernel keeps the
+    /// registers of each of them in its thread while another one runs, but
+    /// each has a TLB of its own, if there is a TLB at all.
+    void SetNumCpus(unsigned n);
+
+    /// Translate through the TLB of CPU `cpu` from now on.
+    void SelectCpu(unsigned cpu);
+
+    /// The TLB of CPU `cpu`, or null if there is no TLB.
+    TranslationEntry *GetTlb(unsigned cpu);
+
     /// Routines internal to the machine simulation -- DO NOT call these.
 
     /// Fetch one instruction of a user program.
     ///
-    /// Return false if an exception occurs, true otherwise.
-    bool FetchInstruction(Instruction *instr);
+    /// Return the decoded instruction, which is either `instr` or an entry
+    /// of the decode cache, or null if an exception occurs.
+    const Instruction *FetchInstruction(Instruction *instr);
 
     /// Run a certain instruction of a user program.
     void ExecInstruction(const Instruction *instr);
@@ -108,6 +149,11 @@ public:
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
 
+    /// Finish an instruction that did not raise an exception: do the
+    /// pending delayed load, start the new one and advance the program
+    /// counters.
+    void Retire(int pcAfter, unsigned nextLoadReg, int nextLoadValue);
+
     /// Trap to the Nachos kernel, because of a system call or other
     /// exception.
     void RaiseException(ExceptionType et, unsigned badVAddr);
@@ -120,6 +166,18 @@ public:
     /// can be assigned to multiple exception types.
     void SetHandler(ExceptionType et, ExceptionHandler handler);
 
+#ifdef JIT
+    /// Called by compiled code for instruction `index` of the running
+    /// block.  Like `ReadMem` and `WriteMem`, they return whether the
+    /// access succeeded, and raise an exception otherwise; `JitStoreWord`
+    /// returns one of the `JIT_STORE_*` results.
+    static bool JitLoadWord(Machine *m, unsigned index, int addr, int *value);
+    static int JitStoreWord(Machine *m, unsigned index, int addr, int value);
+
+    /// Called by compiled code after instruction `index`, in checking mode.
+    static void JitTrace(Machine *m, unsigned index);
+#endif
+
 private:
     SingleStepper *singleStepper;  ///< Drop back into the method of a
                                    ///< provided object (may be a debugger)
@@ -131,6 +189,87 @@ private:
 
     MMU mmu; ///< Memory management unit.
 
+    TraceBuffer *trace;  ///< Null unless tracing.
+
+    /// TLB of each CPU, when there are several; the MMU uses one of them.
+    TranslationEntry **tlbs;
+    unsigned numCpus;
+
+#ifdef DECODE_CACHE
+    DecodeCache *decodeCache;  ///< Instructions already decoded.
+#endif
+
+#ifdef BLOCK_INTERPRETER
+    BlockCache *blockCache;  ///< Basic blocks already translated.
+
+    /// Ticks owed by the instructions of the running block, settled before
+    /// any exception so that the kernel sees the right time.
+    unsigned long blockTicks;
+
+    /// Number of exceptions raised so far; a block stops after one.
+    unsigned long numExceptions;
+
+    /// Run the basic block at the PC, or at least one instruction, and
+    /// advance simulated time accordingly.
+    void RunBlock();
+
+    /// Translate the block starting at `physAddr`.
+    BasicBlock *TranslateBlock(unsigned physAddr);
+
+    static InstructionHandler SelectHandler(unsigned char opCode);
+
+    /// Short handlers for the most common instructions; any other goes
+    /// through `ExecInstruction`.
+
+    void ExecAddiu(const Instruction *instr);
+    void ExecAddu(const Instruction *instr);
+    void ExecSubu(const Instruction *instr);
+    void ExecAnd(const Instruction *instr);
+    void ExecAndi(const Instruction *instr);
+    void ExecOr(const Instruction *instr);
+    void ExecOri(const Instruction *instr);
+    void ExecXor(const Instruction *instr);
+    void ExecXori(const Instruction *instr);
+    void ExecLui(const Instruction *instr);
+    void ExecSll(const Instruction *instr);
+    void ExecSlt(const Instruction *instr);
+    void ExecSlti(const Instruction *instr);
+    void ExecSltu(const Instruction *instr);
+    void ExecSltiu(const Instruction *instr);
+    void ExecMfhi(const Instruction *instr);
+    void ExecMflo(const Instruction *instr);
+    void ExecBeq(const Instruction *instr);
+    void ExecBne(const Instruction *instr);
+    void ExecJ(const Instruction *instr);
+    void ExecJal(const Instruction *instr);
+    void ExecJr(const Instruction *instr);
+    void ExecLw(const Instruction *instr);
+    void ExecSw(const Instruction *instr);
+#endif
+
+#ifdef JIT
+    Jit *jit;  ///< Null unless enabled.
+
+    /// Block whose compiled code is running, and number of its instructions
+    /// fetched so far, as counted in the statistics.
+    const BasicBlock *compiledBlock;
+    unsigned compiledFetches;
+
+    /// Run the compiled `code` of `block`, unless its code has changed.
+    /// Return whether it ran.
+    bool RunCompiled(BasicBlock *block, BlockCode code);
+
+    /// Account for the instructions before `index` of the running block,
+    /// which are done, and for the fetch of that one.
+    void SettleCompiled(unsigned index);
+
+    /// Run the first `count` instructions of `block` again through the
+    /// interpreter, from the registers `before` a run of its compiled code,
+    /// and check that they leave the same state after each instruction.
+    void CheckCompiled(const BasicBlock *block, const int *before,
+                       unsigned count);
+#endif
+
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
 };
 
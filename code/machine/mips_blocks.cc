@@ -0,0 +1,540 @@
+/// Run user programs a basic block at a time.
+///
+/// Instead of fetching, translating the PC and decoding every instruction,
+/// and checking for interrupts after each one, `RunBlock` translates the PC
+/// once, finds the block starting there (see `block_cache.hh`) and calls the
+/// handler bound to each of its instructions in turn.
+///
+/// Every instruction still does its own delayed load and program counter
+/// bookkeeping, so a block may be left at any point: when a branch goes
+/// elsewhere, when its code has changed, or when an exception is raised.
+/// In the latter case, the ticks of the instructions already run are
+/// accounted for before the kernel is entered, and the block ends there, so
+/// exceptions stay precise.  Interrupts are checked once, at the end of the
+/// block, which never runs past the tick at which the next one is due; they
+/// thus fire after the same instruction as when running one at a time.
+///
+/// With `JIT`, blocks that have run often enough are compiled to host code
+/// (see `jit.hh`), which runs under the same rules whenever the whole block
+/// fits before the next interrupt.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "machine.hh"
+#include "encoding.hh"
+#include "endianness.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+#ifdef BLOCK_INTERPRETER
+
+void
+Machine::RunBlock()
+{
+    unsigned pc = registers[PC_REG];
+    unsigned physAddr;
+    ExceptionType e = mmu.Translate(pc, &physAddr, 4, false);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, pc);
+        if (profiler != nullptr) {
+            profiler->Count(pc, 1);
+        }
+        interrupt->OneTick();
+        return;
+    }
+
+    BasicBlock *block = blockCache->Find(physAddr);
+    if (block == nullptr) {
+        block = TranslateBlock(physAddr);
+    }
+
+    // Run no further than the instruction after which the next interrupt
+    // is due.
+    unsigned long due = interrupt->TicksUntilDue();
+    due = due / USER_TICK + (due % USER_TICK != 0);
+    unsigned length = block->length < due ? block->length : due;
+
+#ifdef JIT
+    // Compiled code runs whole blocks, and only from their first
+    // instruction, not from a delay slot.
+    if (jit != nullptr && length == block->length
+          && (unsigned) registers[NEXT_PC_REG] == pc + 4) {
+        BlockCode compiled = jit->Lookup(block);
+        if (compiled != nullptr && RunCompiled(block, compiled)) {
+            return;
+        }
+    }
+#endif
+
+    const unsigned *code = (const unsigned *) &mmu.mainMemory[physAddr];
+    unsigned long exceptions = numExceptions;
+    ASSERT(blockTicks == 0);
+
+    for (unsigned i = 0; i < length; i++) {
+        if ((unsigned) registers[PC_REG] != pc + 4 * i) {
+            break;  // A branch has left the block.
+        }
+        const Instruction *instr = &block->instrs[i];
+        if (WordToHost(code[i]) != instr->value) {
+            blockCache->Drop(block);  // The code has been overwritten.
+            break;
+        }
+
+        stats->numPageHits++;
+        (this->*block->handlers[i])(instr);
+        if (numExceptions != exceptions) {
+            // The ticks of the previous instructions have been settled,
+            // and the block may be gone by now; just end this instruction.
+            if (profiler != nullptr) {
+                profiler->Count(pc, i + 1);
+            }
+            interrupt->OneTick();
+            return;
+        }
+        blockTicks++;
+    }
+
+    unsigned long ticks = blockTicks;
+    blockTicks = 0;
+    if (ticks > 0) {
+        if (profiler != nullptr) {
+            profiler->Count(pc, ticks);
+        }
+        interrupt->AdvanceClock(ticks - 1);
+        interrupt->OneTick();
+    }
+}
+
+#ifdef JIT
+
+bool
+Machine::RunCompiled(BasicBlock *block, BlockCode code)
+{
+    const unsigned *words = (const unsigned *) &mmu.mainMemory[block->physAddr];
+    for (unsigned i = 0; i < block->length; i++) {
+        if (WordToHost(words[i]) != block->instrs[i].value) {
+            return false;  // Let the interpreter drop it.
+        }
+    }
+
+    int before[NUM_TOTAL_REGS];
+    if (jit->IsChecking()) {
+        memcpy(before, registers, sizeof registers);
+        jit->StartRecord();
+    }
+
+    unsigned pc = registers[PC_REG];
+    unsigned long exceptions = numExceptions;
+    compiledBlock = block;
+    compiledFetches = 0;
+    unsigned count = code(registers, this);
+    compiledBlock = nullptr;
+    stats->numCompiledInstructions += count;
+
+    if (numExceptions != exceptions) {
+        // As in `RunBlock`, time and fetches up to the failing instruction
+        // have been settled already.
+        if (profiler != nullptr) {
+            profiler->Count(pc, count + 1);
+        }
+        interrupt->OneTick();
+        return true;
+    }
+
+    ASSERT(count > 0);
+    stats->numPageHits += count - compiledFetches;
+    blockTicks = 0;
+    if (count < block->length) {
+        blockCache->Drop(block);  // It has overwritten its own code.
+    } else if (jit->IsChecking()) {
+        CheckCompiled(block, before, count);
+    }
+    if (profiler != nullptr) {
+        profiler->Count(pc, count);
+    }
+    interrupt->AdvanceClock(count - 1);
+    interrupt->OneTick();
+    return true;
+}
+
+void
+Machine::SettleCompiled(unsigned index)
+{
+    blockTicks = index;
+    stats->numPageHits += index + 1 - compiledFetches;
+    compiledFetches = index + 1;
+}
+
+void
+Machine::CheckCompiled(const BasicBlock *block, const int *before,
+                       unsigned count)
+{
+    jit->UndoStores(mmu.mainMemory);
+    memcpy(registers, before, sizeof registers);
+
+    // Replaying is not supposed to show in the statistics.
+    unsigned long hits = stats->numPageHits;
+    unsigned long exceptions = numExceptions;
+    for (unsigned i = 0; i < count; i++) {
+        (this->*block->handlers[i])(&block->instrs[i]);
+        ASSERT(numExceptions == exceptions);
+
+        const int *compiled = jit->RecordedRegisters(i);
+        if (memcmp(registers, compiled, sizeof registers) != 0) {
+            fprintf(stderr, "JIT: compiled code differs from the interpreter"
+                    " after instruction 0x%08X at 0x%X:\n",
+                    block->instrs[i].value, registers[PREV_PC_REG]);
+            for (unsigned r = 0; r < NUM_TOTAL_REGS; r++) {
+                if (registers[r] != compiled[r]) {
+                    fprintf(stderr, "\tregister %u: 0x%X, compiled 0x%X\n",
+                            r, registers[r], compiled[r]);
+                }
+            }
+            ASSERT(false);
+        }
+    }
+    stats->numPageHits = hits;
+    ASSERT(jit->StoresMatch(mmu.mainMemory));
+    stats->numCheckedInstructions += count;
+}
+
+bool
+Machine::JitLoadWord(Machine *m, unsigned index, int addr, int *value)
+{
+    m->SettleCompiled(index);
+    if (addr & 0x3) {
+        m->RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return false;
+    }
+    return m->ReadMem(addr, 4, value);
+}
+
+int
+Machine::JitStoreWord(Machine *m, unsigned index, int addr, int value)
+{
+    m->SettleCompiled(index);
+
+    // What `WriteMem` does, but keeping the physical address.
+    DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, 4, value);
+    unsigned physAddr;
+    ExceptionType e = m->mmu.Translate(addr, &physAddr, 4, true);
+    if (e != NO_EXCEPTION) {
+        m->RaiseException(e, addr);
+        return JIT_STORE_FAILED;
+    }
+    unsigned *word = (unsigned *) &m->mmu.mainMemory[physAddr];
+    unsigned newWord = WordToMachine((unsigned) value);
+    if (m->jit->IsChecking()) {
+        m->jit->RecordStore(physAddr, *word, newWord);
+    }
+    *word = newWord;
+    stats->numPageHits++;
+
+    const BasicBlock *block = m->compiledBlock;
+    return physAddr - block->physAddr < 4 * block->length
+           ? JIT_STORE_HIT_CODE : JIT_STORE_DONE;
+}
+
+void
+Machine::JitTrace(Machine *m, unsigned index)
+{
+    m->jit->RecordRegisters(index, m->registers);
+}
+
+#endif
+
+/// Whether `opCode` has a delay slot.
+static bool
+IsBranch(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_BEQ:
+        case OP_BGEZ:
+        case OP_BGEZAL:
+        case OP_BGTZ:
+        case OP_BLEZ:
+        case OP_BLTZ:
+        case OP_BLTZAL:
+        case OP_BNE:
+        case OP_J:
+        case OP_JAL:
+        case OP_JALR:
+        case OP_JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Whether `opCode` always enters the kernel.
+static bool
+IsTrap(unsigned char opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_RES || opCode == OP_UNIMP;
+}
+
+BasicBlock *
+Machine::TranslateBlock(unsigned physAddr)
+{
+    BasicBlock *block = blockCache->Slot(physAddr);
+    const unsigned *code = (const unsigned *) &mmu.mainMemory[physAddr];
+    unsigned maxLength = (PAGE_SIZE - physAddr % PAGE_SIZE) / 4;
+    if (maxLength > MAX_BLOCK_LENGTH) {
+        maxLength = MAX_BLOCK_LENGTH;
+    }
+
+    unsigned length = 0;
+    bool inDelaySlot = false;
+    while (length < maxLength) {
+        Instruction *instr = &block->instrs[length];
+        instr->value = WordToHost(code[length]);
+        instr->Decode();
+        block->handlers[length] = SelectHandler(instr->opCode);
+        length++;
+
+        if (inDelaySlot || IsTrap(instr->opCode)) {
+            break;
+        }
+        inDelaySlot = IsBranch(instr->opCode);
+    }
+
+    block->physAddr = physAddr;
+    block->length = length;
+#ifdef JIT
+    block->runs = 0;
+    block->code = nullptr;
+#endif
+    stats->numBlocksTranslated++;
+    return block;
+}
+
+InstructionHandler
+Machine::SelectHandler(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_ADDIU: return &Machine::ExecAddiu;
+        case OP_ADDU:  return &Machine::ExecAddu;
+        case OP_SUBU:  return &Machine::ExecSubu;
+        case OP_AND:   return &Machine::ExecAnd;
+        case OP_ANDI:  return &Machine::ExecAndi;
+        case OP_OR:    return &Machine::ExecOr;
+        case OP_ORI:   return &Machine::ExecOri;
+        case OP_XOR:   return &Machine::ExecXor;
+        case OP_XORI:  return &Machine::ExecXori;
+        case OP_LUI:   return &Machine::ExecLui;
+        case OP_SLL:   return &Machine::ExecSll;
+        case OP_SLT:   return &Machine::ExecSlt;
+        case OP_SLTI:  return &Machine::ExecSlti;
+        case OP_SLTU:  return &Machine::ExecSltu;
+        case OP_SLTIU: return &Machine::ExecSltiu;
+        case OP_MFHI:  return &Machine::ExecMfhi;
+        case OP_MFLO:  return &Machine::ExecMflo;
+        case OP_BEQ:   return &Machine::ExecBeq;
+        case OP_BNE:   return &Machine::ExecBne;
+        case OP_J:     return &Machine::ExecJ;
+        case OP_JAL:   return &Machine::ExecJal;
+        case OP_JR:    return &Machine::ExecJr;
+        case OP_LW:    return &Machine::ExecLw;
+        case OP_SW:    return &Machine::ExecSw;
+        default:       return &Machine::ExecInstruction;
+    }
+}
+
+/// The handlers below do exactly what `ExecInstruction` does for their
+/// instruction, without going through its `switch`.
+
+void
+Machine::ExecAddiu(const Instruction *instr)
+{
+    registers[instr->rt] = registers[instr->rs] + instr->extra;
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecAddu(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSubu(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecAnd(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecAndi(const Instruction *instr)
+{
+    registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xFFFF);
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecOr(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecOri(const Instruction *instr)
+{
+    registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xFFFF);
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecXor(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecXori(const Instruction *instr)
+{
+    registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xFFFF);
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecLui(const Instruction *instr)
+{
+    registers[instr->rt] = instr->extra << 16;
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSll(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rt] << instr->extra;
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSlt(const Instruction *instr)
+{
+    registers[instr->rd] = registers[instr->rs] < registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSlti(const Instruction *instr)
+{
+    registers[instr->rt] = registers[instr->rs] < instr->extra;
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSltu(const Instruction *instr)
+{
+    registers[instr->rd] = (unsigned) registers[instr->rs]
+                           < (unsigned) registers[instr->rt];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecSltiu(const Instruction *instr)
+{
+    registers[instr->rt] = (unsigned) registers[instr->rs]
+                           < (unsigned) instr->extra;
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecMfhi(const Instruction *instr)
+{
+    registers[instr->rd] = registers[HI_REG];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecMflo(const Instruction *instr)
+{
+    registers[instr->rd] = registers[LO_REG];
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+void
+Machine::ExecBeq(const Instruction *instr)
+{
+    int pcAfter = registers[NEXT_PC_REG] + 4;
+    if (registers[instr->rs] == registers[instr->rt]) {
+        pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    Retire(pcAfter, 0, 0);
+}
+
+void
+Machine::ExecBne(const Instruction *instr)
+{
+    int pcAfter = registers[NEXT_PC_REG] + 4;
+    if (registers[instr->rs] != registers[instr->rt]) {
+        pcAfter = registers[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    Retire(pcAfter, 0, 0);
+}
+
+void
+Machine::ExecJ(const Instruction *instr)
+{
+    int pcAfter = registers[NEXT_PC_REG] + 4;
+    Retire((pcAfter & 0xF0000000) | IndexToAddr(instr->extra), 0, 0);
+}
+
+void
+Machine::ExecJal(const Instruction *instr)
+{
+    int pcAfter = registers[NEXT_PC_REG] + 4;
+    registers[RET_ADDR_REG] = registers[NEXT_PC_REG] + 4;
+    Retire((pcAfter & 0xF0000000) | IndexToAddr(instr->extra), 0, 0);
+}
+
+void
+Machine::ExecJr(const Instruction *instr)
+{
+    Retire(registers[instr->rs], 0, 0);
+}
+
+void
+Machine::ExecLw(const Instruction *instr)
+{
+    int addr = registers[instr->rs] + instr->extra;
+    if (addr & 0x3) {
+        RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return;
+    }
+    int value;
+    if (!ReadMem(addr, 4, &value)) {
+        return;
+    }
+    Retire(registers[NEXT_PC_REG] + 4, instr->rt, value);
+}
+
+void
+Machine::ExecSw(const Instruction *instr)
+{
+    if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+                  4, registers[instr->rt])) {
+        return;
+    }
+    Retire(registers[NEXT_PC_REG] + 4, 0, 0);
+}
+
+#endif
@@ -12,12 +12,27 @@
 
 
 #include "instruction.hh"
+#include "endianness.hh"
 #include "machine.hh"
 #include "threads/system.hh"
 
 #include <stdio.h>
 
 
+/// Whether instructions of type `opCode` load or store.
+static bool
+AccessesMemory(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_LB:  case OP_LBU: case OP_LH:  case OP_LHU:
+        case OP_LW:  case OP_LWL: case OP_LWR:
+        case OP_SB:  case OP_SH:  case OP_SW:  case OP_SWL: case OP_SWR:
+            return true;
+        default:
+            return false;
+    }
+}
+
 /// Simulate the execution of a user-level program on Nachos.
 ///
 /// Called by the kernel when the program starts up; never returns.
@@ -34,10 +49,38 @@ Machine::Run()
         printf("Starting to run at time %lu\n", stats->totalTicks);
     }
     interrupt->SetStatus(USER_MODE);
+    if (multiprocessor != nullptr) {
+        multiprocessor->LeaveKernel();  // Threads start in the kernel.
+    }
 
     for (;;) {
-        if (FetchInstruction(instr)) {
-            ExecInstruction(instr);
+        if (multiprocessor != nullptr && multiprocessor->SwitchDue()) {
+            multiprocessor->Switch();
+        }
+#ifdef BLOCK_INTERPRETER
+        // Single stepping and tracing need to see every instruction.
+        if (singleStepper == nullptr && !debug.IsEnabled('m')
+              && trace == nullptr) {
+            RunBlock();
+            continue;
+        }
+#endif
+        unsigned pc = registers[PC_REG];
+        if (trace != nullptr) {
+            trace->Begin(stats->totalTicks, pc);
+        }
+        const Instruction *decoded = FetchInstruction(instr);
+        if (decoded != nullptr) {
+            if (trace != nullptr) {
+                bool memory = AccessesMemory(decoded->opCode);
+                trace->Fetched(decoded->value, memory,
+                               memory ? registers[decoded->rs] + decoded->extra
+                                      : 0);
+            }
+            ExecInstruction(decoded);
+        }
+        if (profiler != nullptr) {
+            profiler->Count(pc, 1);
         }
         interrupt->OneTick();
         if (singleStepper != nullptr && !singleStepper->Step()) {
@@ -59,29 +102,45 @@ Machine::DelayedLoad(unsigned nextReg, int nextValue)
     registers[0] = 0;  // And always make sure R0 stays zero.
 }
 
-bool
+const Instruction *
 Machine::FetchInstruction(Instruction *instr)
 {
     ASSERT(instr != nullptr);
 
+#ifdef DECODE_CACHE
+    // Translate the PC as `ReadMem` would, but dispatch on the instruction
+    // already decoded for the word there.
+    unsigned pc = registers[PC_REG];
+    unsigned physAddr;
+    ExceptionType e = mmu.Translate(pc, &physAddr, 4, false);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, pc);
+        return nullptr;
+    }
+    stats->numPageHits++;
+    unsigned raw = WordToHost(*(unsigned *) &mmu.mainMemory[physAddr]);
+    const Instruction *decoded = decodeCache->Lookup(physAddr, raw);
+#else
     int raw;
     if (!ReadMem(registers[PC_REG], 4, &raw)) {
-        return false;  // Exception occurred.
+        return nullptr;  // Exception occurred.
     }
     instr->value = raw;
     instr->Decode();
+    const Instruction *decoded = instr;
+#endif
 
     if (debug.IsEnabled('m')) {
-        const struct OpString *str = &OP_STRINGS[instr->opCode];
+        const struct OpString *str = &OP_STRINGS[decoded->opCode];
 
-        ASSERT(instr->opCode <= MAX_OPCODE);
+        ASSERT(decoded->opCode <= MAX_OPCODE);
         DEBUG('m', "At PC = 0x%X: ", registers[PC_REG]);
-        DEBUG_CONT('m', str->string, instr->RegFromType(str->args[0]),
-                        instr->RegFromType(str->args[1]),
-                        instr->RegFromType(str->args[2]));
+        DEBUG_CONT('m', str->string, decoded->RegFromType(str->args[0]),
+                        decoded->RegFromType(str->args[1]),
+                        decoded->RegFromType(str->args[2]));
         DEBUG_CONT('m', "\n");
     }
-    return true;
+    return decoded;
 }
 
 /// Simulate R2000 multiplication.
@@ -643,7 +702,12 @@ Machine::ExecInstruction(const Instruction *instr)
     }
 
     // Now we have successfully executed the instruction.
+    Retire(pcAfter, nextLoadReg, nextLoadValue);
+}
 
+void
+Machine::Retire(int pcAfter, unsigned nextLoadReg, int nextLoadValue)
+{
     // Do any delayed load operation.
     DelayedLoad(nextLoadReg, nextLoadValue);
 
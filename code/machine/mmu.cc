@@ -34,6 +34,23 @@
 #include <stdio.h>
 
 
+unsigned PAGE_SIZE = DEFAULT_PAGE_SIZE;
+unsigned NUM_PHYS_PAGES = DEFAULT_NUM_PHYS_PAGES;
+unsigned MEMORY_SIZE = DEFAULT_NUM_PHYS_PAGES * DEFAULT_PAGE_SIZE;
+
+void
+SetMemoryGeometry(unsigned pageSize, unsigned numPhysPages)
+{
+    ASSERT(pageSize > 0 && pageSize % SECTOR_SIZE == 0);
+    ASSERT(pageSize <= MAX_PAGE_SIZE);
+    ASSERT(numPhysPages >= MIN_NUM_PHYS_PAGES);
+    ASSERT(numPhysPages <= MAX_MEMORY_SIZE / pageSize);
+
+    PAGE_SIZE = pageSize;
+    NUM_PHYS_PAGES = numPhysPages;
+    MEMORY_SIZE = numPhysPages * pageSize;
+}
+
 MMU::MMU()
 {
     mainMemory = new char [MEMORY_SIZE];
@@ -177,19 +194,21 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
     if (tlb == nullptr) {
         // Use a page table; `vpn` is an index in the table.
 
-        if (vpn >= pageTableSize) {
+        if (vpn >= pageTable->Size()) {
             DEBUG_CONT('a', "virtual page # %u too large for"
                             " page table size %u!\n",
-                       vpn, pageTableSize);
+                       vpn, pageTable->Size());
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+        }
+
+        // Pages without a second-level table have no translation yet.
+        TranslationEntry *e = pageTable->Lookup(vpn);
+        if (e == nullptr || !e->valid) {
+            DEBUG_CONT('a', "virtual page # %u not valid!\n", vpn);
             return PAGE_FAULT_EXCEPTION;
         }
 
-        *entry = &pageTable[vpn];
+        *entry = e;
         return NO_EXCEPTION;
 
     } else {
@@ -11,16 +11,45 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "page_table.hh"
 #include "translation_entry.hh"
 
 
 /// Definitions related to the size, and format of user memory.
 
-const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
-                                         ///< disk sector size, for
-                                         ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 16;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
+const unsigned DEFAULT_PAGE_SIZE = SECTOR_SIZE;  ///< By default, set the
+                                                 ///< page size equal to the
+                                                 ///< disk sector size, for
+                                                 ///< simplicity.
+const unsigned DEFAULT_NUM_PHYS_PAGES = 16;
+
+/// Limits of what can be chosen at startup.  An instruction may need two
+/// pages in memory at once, its own and the one it loads from or stores to;
+/// with demand loading, one more frame is kept for the shared page of
+/// zeroes.
+#ifdef DEMAND_LOADING
+const unsigned MIN_NUM_PHYS_PAGES = 3;
+#else
+const unsigned MIN_NUM_PHYS_PAGES = 2;
+#endif
+const unsigned MAX_PAGE_SIZE = 64 * 1024;
+const unsigned MAX_MEMORY_SIZE = 256 * 1024 * 1024;
+
+/// Page size, number of physical page frames and resulting memory size.
+///
+/// They are fixed for the whole run, but chosen at startup (see
+/// `SetMemoryGeometry`), so they must not be used before the machine is
+/// built.
+extern unsigned PAGE_SIZE;
+extern unsigned NUM_PHYS_PAGES;
+extern unsigned MEMORY_SIZE;
+
+/// Set the page size and the number of physical page frames.  Must be
+/// called before the MMU is created.
+///
+/// The page size must be a multiple of the sector size, so that a page is
+/// always moved to and from the disk as a whole number of sectors.
+void SetMemoryGeometry(unsigned pageSize, unsigned numPhysPages);
 
 /// Number of entries in the TLB, if one is present.
 ///
@@ -47,6 +76,14 @@ public:
 
     void PrintTLB() const;
 
+    /// Translate an address, and check for alignment.
+    ///
+    /// Set the use and dirty bits in the translation entry appropriately,
+    /// and return an exception code if the translation could not be
+    /// completed.
+    ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
+                            unsigned size, bool writing);
+
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
     ///
@@ -64,7 +101,7 @@ public:
     /// * a software-loaded translation lookaside buffer (tlb) -- a cache of
     ///   mappings of virtual page #'s to physical page #'s.
     ///
-    /// If `tlb` is null, the linear page table is used.
+    /// If `tlb` is null, the page table is used (see `page_table.hh`).
     /// If `tlb` is non-null, the Nachos kernel is responsible for managing
     /// the contents of the TLB.  But the kernel can use any data structure
     /// it wants (eg, segmented paging) for handling TLB cache misses.
@@ -79,22 +116,13 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    PageTable *pageTable;
 
 private:
 
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
                                     TranslationEntry **entry) const;
-
-    /// Translate an address, and check for alignment.
-    ///
-    /// Set the use and dirty bits in the translation entry appropriately,
-    /// and return an exception code if the translation could not be
-    /// completed.
-    ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
-                            unsigned size, bool writing);
 };
 
 
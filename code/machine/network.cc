@@ -63,12 +63,17 @@ Network::Network(NetworkAddress addr, double reliability,
       // Bind socket to a filename in the current directory.
 
     // Start polling for incoming packets.
-    interrupt->Schedule(NetworkReadPoll, this,
-                        NETWORK_TIME, NETWORK_RECV_INT);
+    pollInterrupt = interrupt->Schedule(NetworkReadPoll, this,
+                                        NETWORK_TIME, NETWORK_RECV_INT);
+    sendInterrupt = 0;
 }
 
 Network::~Network()
 {
+    interrupt->Cancel(pollInterrupt);
+    if (sendBusy) {
+        interrupt->Cancel(sendInterrupt);
+    }
     SystemDep::CloseSocket(sock);
     SystemDep::DeAssignNameToSocket(sockName);
 }
@@ -80,8 +85,8 @@ void
 Network::CheckPktAvail()
 {
     // Schedule the next time to poll for a packet.
-    interrupt->Schedule(NetworkReadPoll, this,
-                        NETWORK_TIME, NETWORK_RECV_INT);
+    pollInterrupt = interrupt->Schedule(NetworkReadPoll, this,
+                                        NETWORK_TIME, NETWORK_RECV_INT);
 
     if (inHdr.length != 0) {  // Do nothing if packet is already buffered.
         return;
@@ -135,8 +140,9 @@ Network::Send(PacketHeader hdr, const char *data)
            && hdr.length <= MAX_PACKET_SIZE && hdr.from == ident);
     DEBUG('n', "Sending to addr %u, %u bytes... ", hdr.to, hdr.length);
 
-    interrupt->Schedule(NetworkSendDone, this,
-                        NETWORK_TIME, NETWORK_SEND_INT);
+    sendBusy = true;
+    sendInterrupt = interrupt->Schedule(NetworkSendDone, this,
+                                        NETWORK_TIME, NETWORK_SEND_INT);
 
     // Emulate a lost packet.
     if (SystemDep::Random() % 100 >= chanceToWork * 100) {
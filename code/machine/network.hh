@@ -17,6 +17,7 @@
 #define NACHOS_MACHINE_NETWORK__HH
 
 
+#include "interrupt.hh"
 #include "lib/utility.hh"
 
 
@@ -126,6 +127,10 @@ private:
 
     /// Data for arrived packet.
     char inbox[MAX_PACKET_SIZE];
+
+    /// Next poll for incoming packets, and end of the send in progress.
+    InterruptId pollInterrupt;
+    InterruptId sendInterrupt;
 };
 
 
@@ -0,0 +1,146 @@
+#include "page_table.hh"
+#include "lib/utility.hh"
+
+
+static void
+InitEntry(TranslationEntry *entry, unsigned vpn)
+{
+    entry->virtualPage  = vpn;
+    entry->physicalPage = 0;
+    entry->valid        = false;
+    entry->readOnly     = false;
+    entry->use          = false;
+    entry->dirty        = false;
+}
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+
+PageTable::PageTable(unsigned numPages)
+{
+    size = numPages;
+    directorySize = DivRoundUp(numPages, PAGE_TABLE_LEAF_SIZE);
+    directory = new TranslationEntry * [directorySize];
+    for (unsigned i = 0; i < directorySize; i++) {
+        directory[i] = nullptr;
+    }
+    numLeaves = 0;
+}
+
+PageTable::~PageTable()
+{
+    for (unsigned i = 0; i < directorySize; i++) {
+        delete [] directory[i];
+    }
+    delete [] directory;
+}
+
+TranslationEntry *
+PageTable::NewLeaf(unsigned first)
+{
+    TranslationEntry *leaf = new TranslationEntry [PAGE_TABLE_LEAF_SIZE];
+    for (unsigned i = 0; i < PAGE_TABLE_LEAF_SIZE; i++) {
+        InitEntry(&leaf[i], first + i);
+    }
+    return leaf;
+}
+
+void
+PageTable::Resize(unsigned numPages)
+{
+    unsigned newDirectorySize = DivRoundUp(numPages, PAGE_TABLE_LEAF_SIZE);
+
+    if (newDirectorySize != directorySize) {
+        TranslationEntry **newDirectory
+          = new TranslationEntry * [newDirectorySize];
+        for (unsigned i = 0; i < newDirectorySize; i++) {
+            newDirectory[i] = i < directorySize ? directory[i] : nullptr;
+        }
+        for (unsigned i = newDirectorySize; i < directorySize; i++) {
+            if (directory[i] != nullptr) {
+                delete [] directory[i];
+                numLeaves--;
+            }
+        }
+        delete [] directory;
+        directory = newDirectory;
+        directorySize = newDirectorySize;
+    }
+
+    // Entries past the end in the last leaf may have been used before.
+    if (numPages < size) {
+        for (unsigned vpn = numPages; vpn < size; vpn++) {
+            TranslationEntry *entry = Lookup(vpn);
+            if (entry != nullptr) {
+                InitEntry(entry, vpn);
+            }
+        }
+    }
+    size = numPages;
+}
+
+TranslationEntry *
+PageTable::Get(unsigned vpn)
+{
+    ASSERT(vpn < size);
+
+    TranslationEntry **leaf = &directory[vpn / PAGE_TABLE_LEAF_SIZE];
+    if (*leaf == nullptr) {
+        *leaf = NewLeaf(vpn - vpn % PAGE_TABLE_LEAF_SIZE);
+        numLeaves++;
+    }
+    return &(*leaf)[vpn % PAGE_TABLE_LEAF_SIZE];
+}
+
+size_t
+PageTable::MemoryUsed() const
+{
+    return directorySize * sizeof (TranslationEntry *)
+           + numLeaves * PAGE_TABLE_LEAF_SIZE * sizeof (TranslationEntry);
+}
+
+#else
+
+PageTable::PageTable(unsigned numPages)
+{
+    size = numPages;
+    entries = new TranslationEntry [numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        InitEntry(&entries[i], i);
+    }
+}
+
+PageTable::~PageTable()
+{
+    delete [] entries;
+}
+
+void
+PageTable::Resize(unsigned numPages)
+{
+    TranslationEntry *newEntries = new TranslationEntry [numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        if (i < size) {
+            newEntries[i] = entries[i];
+        } else {
+            InitEntry(&newEntries[i], i);
+        }
+    }
+    delete [] entries;
+    entries = newEntries;
+    size = numPages;
+}
+
+TranslationEntry *
+PageTable::Get(unsigned vpn)
+{
+    ASSERT(vpn < size);
+    return &entries[vpn];
+}
+
+size_t
+PageTable::MemoryUsed() const
+{
+    return size * sizeof (TranslationEntry);
+}
+
+#endif
@@ -0,0 +1,92 @@
+/// Page tables walked by the MMU when there is no TLB, and by the kernel to
+/// refill the TLB when there is one.
+///
+/// By default a page table is a linear array with one entry per virtual
+/// page.  With `TWO_LEVEL_PAGE_TABLE`, it is a directory of pointers to
+/// second-level tables of `PAGE_TABLE_LEAF_SIZE` entries each, which are
+/// only allocated when one of their pages is first given a translation.
+/// Kernel memory then grows with the pages an address space actually
+/// uses, not with the span of its layout.
+///
+/// Either way, `Lookup` never allocates: it returns null for pages whose
+/// second-level table does not exist yet, which the MMU takes as a page
+/// fault.
+
+#ifndef NACHOS_MACHINE_PAGETABLE__HH
+#define NACHOS_MACHINE_PAGETABLE__HH
+
+
+#include "translation_entry.hh"
+
+#include <stddef.h>
+
+
+/// Number of entries in each second-level table.
+const unsigned PAGE_TABLE_LEAF_SIZE = 32;
+
+
+class PageTable {
+public:
+
+    /// Create a page table covering virtual pages `0` to `numPages - 1`,
+    /// all of them invalid.
+    PageTable(unsigned numPages);
+
+    ~PageTable();
+
+    /// Number of virtual pages covered.
+    unsigned Size() const;
+
+    /// Cover `numPages` virtual pages instead.  New pages start invalid;
+    /// when shrinking, the entries of the pages dropped must be invalid.
+    void Resize(unsigned numPages);
+
+    /// Return the entry of `vpn`, or null if it is out of range or has
+    /// never been given one.
+    TranslationEntry *Lookup(unsigned vpn) const;
+
+    /// Return the entry of `vpn`, creating it if needed.  `vpn` must be in
+    /// range.
+    TranslationEntry *Get(unsigned vpn);
+
+    /// Bytes of kernel memory taken by the table.
+    size_t MemoryUsed() const;
+
+private:
+
+    unsigned size;
+
+#ifdef TWO_LEVEL_PAGE_TABLE
+    /// Make a second-level table for the pages starting at `first`.
+    static TranslationEntry *NewLeaf(unsigned first);
+
+    TranslationEntry **directory;
+    unsigned directorySize;
+    unsigned numLeaves;
+#else
+    TranslationEntry *entries;
+#endif
+};
+
+inline unsigned
+PageTable::Size() const
+{
+    return size;
+}
+
+inline TranslationEntry *
+PageTable::Lookup(unsigned vpn) const
+{
+    if (vpn >= size) {
+        return nullptr;
+    }
+#ifdef TWO_LEVEL_PAGE_TABLE
+    TranslationEntry *leaf = directory[vpn / PAGE_TABLE_LEAF_SIZE];
+    return leaf == nullptr ? nullptr : &leaf[vpn % PAGE_TABLE_LEAF_SIZE];
+#else
+    return &entries[vpn];
+#endif
+}
+
+
+#endif
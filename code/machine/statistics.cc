@@ -19,9 +19,16 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
-    numConsoleCharsRead = numConsoleCharsWritten = 0;
+    numConsoleCharsRead = numConsoleCharsWritten = numConsoleWrites = 0;
+    numDecodeCacheMisses = numBlocksTranslated = 0;
+    numBlocksCompiled = numCompiledInstructions = numCheckedInstructions = 0;
     numPageFaults = numPageHits = numPacketsSent = numPacketsRecvd = 0;
-    numPagesDemandLoaded = numSentSwap = numBroughtSwap = 0;
+    numPagesDemandLoaded = numPagesFaultedAround = 0;
+    numSentSwap = numBroughtSwap = 0;
+    numCleanEvictions = numDirtyEvictions = numPagesCleaned = 0;
+    numSwapCacheStores = numSwapCacheBytesIn = numSwapCacheBytesOut = 0;
+    numSwapCacheHits = numSwapCacheSpills = 0;
+    numMappedPagesRead = numMappedPagesWritten = 0;
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
@@ -44,9 +51,39 @@ Statistics::Print()
     printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
+    if (numConsoleWrites != 0) {
+        printf("Console output: device requests %lu\n", numConsoleWrites);
+    }
+    if (numDecodeCacheMisses != 0) {
+        printf("Decode cache: instructions decoded %lu\n",
+               numDecodeCacheMisses);
+    }
+    if (numBlocksTranslated != 0) {
+        printf("Block interpreter: blocks translated %lu\n",
+               numBlocksTranslated);
+    }
+    if (numBlocksCompiled != 0) {
+        printf("JIT: blocks compiled %lu, instructions run %lu, checked %lu\n",
+               numBlocksCompiled, numCompiledInstructions,
+               numCheckedInstructions);
+    }
     printf("Paging: hits %lu, faults %lu\n", numPageHits, numPageFaults);
-    printf("Demand loading: pages loaded %lu\n", numPagesDemandLoaded);
+    printf("Demand loading: pages loaded %lu, loaded around faults %lu\n",
+           numPagesDemandLoaded, numPagesFaultedAround);
     printf("Swap: pages sent %lu, pages brought %lu\n", numSentSwap, numBroughtSwap);
+    printf("Evictions: clean %lu, dirty %lu, pages cleaned %lu\n",
+           numCleanEvictions, numDirtyEvictions, numPagesCleaned);
+    if (numSwapCacheStores != 0) {
+        // Pages spilled from the cache were written after all; pages read
+        // from it were not read from disk.
+        printf("Swap cache: pages stored %lu, compression ratio %.2f,"
+               " disk writes avoided %lu, disk reads avoided %lu\n",
+               numSwapCacheStores,
+               (double) numSwapCacheBytesIn / numSwapCacheBytesOut,
+               numSwapCacheStores - numSwapCacheSpills, numSwapCacheHits);
+    }
+    printf("Mapped files: pages read %lu, written back %lu\n",
+           numMappedPagesRead, numMappedPagesWritten);
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
 }
@@ -44,6 +44,22 @@ public:
     /// Number of characters written to the display.
     unsigned long numConsoleCharsWritten;
 
+    /// Number of write requests completed by the display, each of one
+    /// character or of a whole batch.
+    unsigned long numConsoleWrites;
+
+    /// Number of instructions decoded into the decode cache.
+    unsigned long numDecodeCacheMisses;
+
+    /// Number of basic blocks translated by the block interpreter.
+    unsigned long numBlocksTranslated;
+
+    /// Number of blocks compiled by the JIT, of instructions run from
+    /// compiled code, and of those checked against the interpreter.
+    unsigned long numBlocksCompiled;
+    unsigned long numCompiledInstructions;
+    unsigned long numCheckedInstructions;
+
     /// Number of virtual memory page faults.
     unsigned long numPageFaults;
 
@@ -52,12 +68,40 @@ public:
     /// Number of pages demand loaded.
     unsigned long numPagesDemandLoaded;
 
+    /// Number of those pages loaded ahead, around another page's fault.
+    unsigned long numPagesFaultedAround;
+
     /// Number of pages sent to swap.
     unsigned long numSentSwap;
 
     /// Number of pages brought from swap.
     unsigned long numBroughtSwap;
 
+    /// Number of evicted pages that were clean, and so needed no write.
+    unsigned long numCleanEvictions;
+
+    /// Number of evicted pages that had to be written to swap first.
+    unsigned long numDirtyEvictions;
+
+    /// Number of pages written to swap ahead of demand by the page cleaner.
+    unsigned long numPagesCleaned;
+
+    /// Number of swapped pages kept compressed in memory, and their total
+    /// size in bytes before and after compression.
+    unsigned long numSwapCacheStores;
+    unsigned long numSwapCacheBytesIn;
+    unsigned long numSwapCacheBytesOut;
+
+    /// Number of swap reads served from the compressed pool, and of pages
+    /// the pool had to write to disk to make room.
+    unsigned long numSwapCacheHits;
+    unsigned long numSwapCacheSpills;
+
+    /// Number of pages of mapped files read from and written back to
+    /// their files.
+    unsigned long numMappedPagesRead;
+    unsigned long numMappedPagesWritten;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
@@ -49,19 +49,52 @@ Timer::Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom)
     arg       = callArg;
 
     // Schedule the first interrupt from the timer device.
-    interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+    nextInterrupt = interrupt->Schedule(TimerHandler, this,
+                                        TimeOfNextInterrupt(), TIMER_INT);
+    running = true;
+}
+
+/// Stop the timer.
+Timer::~Timer()
+{
+    Stop();
+}
+
+void
+Timer::Stop()
+{
+    if (running) {
+        interrupt->Cancel(nextInterrupt);
+        running = false;
+    }
+}
+
+void
+Timer::Start()
+{
+    if (!running) {
+        nextInterrupt = interrupt->Schedule(TimerHandler, this,
+                                            TimeOfNextInterrupt(), TIMER_INT);
+        running = true;
+    }
+}
+
+bool
+Timer::IsRunning() const
+{
+    return running;
 }
 
 /// Routine to simulate the interrupt generated by the hardware timer device.
 ///
-/// Schedule the next interrupt, and invoke the interrupt handler.
+/// Schedule the next interrupt, and invoke the interrupt handler.  The
+/// handler may still stop the timer.
 void
 Timer::TimerExpired()
 {
     // Schedule the next timer device interrupt.
-    interrupt->Schedule(TimerHandler, this, TimeOfNextInterrupt(),
-                        TIMER_INT);
+    nextInterrupt = interrupt->Schedule(TimerHandler, this,
+                                        TimeOfNextInterrupt(), TIMER_INT);
 
     // Invoke the Nachos interrupt handler for this device.
     (*handler)(arg);
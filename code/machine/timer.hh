@@ -10,6 +10,9 @@
 /// In order to introduce some randomness into time-slicing, if `doRandom` is
 /// set, then the interrupt comes after a random number of ticks.
 ///
+/// The timer can be stopped and started again, for a kernel that only
+/// wants timer interrupts while it has some use for them.
+///
 /// DO NOT CHANGE -- part of the machine emulation
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
@@ -21,6 +24,7 @@
 #define NACHOS_MACHINE_TIMER__HH
 
 
+#include "interrupt.hh"
 #include "lib/utility.hh"
 
 
@@ -32,7 +36,16 @@ public:
     /// every time slice.
     Timer(VoidFunctionPtr timerHandler, void *callArg, bool doRandom);
 
-    ~Timer() {}
+    ~Timer();
+
+    /// Stop generating interrupts.
+    void Stop();
+
+    /// Generate interrupts again, if stopped; the next one comes a whole
+    /// time slice from now.
+    void Start();
+
+    bool IsRunning() const;
 
     /// Internal routines to the timer emulation -- DO NOT call these.
 
@@ -46,6 +59,8 @@ private:
     bool randomize;  ///< Set if we need to use a random timeout delay.
     VoidFunctionPtr handler;  ///< Timer interrupt handler.
     void *arg;  ///< Argument to pass to interrupt handler.
+    InterruptId nextInterrupt;  ///< The next interrupt of the timer.
+    bool running;  ///< Whether `nextInterrupt` is pending.
 
 };
 
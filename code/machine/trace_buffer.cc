@@ -0,0 +1,38 @@
+#include "trace_buffer.hh"
+#include "lib/assert.hh"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+TraceBuffer::TraceBuffer(const char *fileName, unsigned capacity)
+{
+    ASSERT(fileName != nullptr);
+    ASSERT(capacity > 0);
+
+    size = sizeof *header + (size_t) capacity * sizeof *records;
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, size) == -1) {
+        perror(fileName);
+        ASSERT(false);
+    }
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(p != MAP_FAILED);
+    close(fd);  // The mapping keeps the file.
+
+    header = (traceHeader *) p;
+    header->magic = TRACE_MAGIC;
+    header->version = TRACE_VERSION;
+    header->recordSize = sizeof *records;
+    header->capacity = capacity;
+    header->count = 0;
+    records = (traceRecord *) (header + 1);
+    current = nullptr;
+}
+
+TraceBuffer::~TraceBuffer()
+{
+    munmap(header, size);
+}
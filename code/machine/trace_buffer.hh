@@ -0,0 +1,85 @@
+/// A binary trace of the user instructions run, kept in a ring buffer.
+///
+/// Printing every instruction with `-d m` slows the simulation down by
+/// orders of magnitude.  Instead, with `-trace`, the machine stores one
+/// fixed-size record per instruction (see `bin/trace.h`) in a UNIX file
+/// mapped into memory, which holds the last so many of them; `readtrace`
+/// prints, filters and summarizes it afterwards.
+///
+/// A record is started before fetching each instruction, and completed
+/// once it has been decoded, and if it raises an exception.  Since the file
+/// is shared with the kernel page cache, records written up to a crash are
+/// not lost.
+
+#ifndef NACHOS_MACHINE_TRACEBUFFER__HH
+#define NACHOS_MACHINE_TRACEBUFFER__HH
+
+
+#include "exception_type.hh"
+#include "bin/trace.h"
+
+#include <stddef.h>
+
+
+/// Records kept in the ring, by default.
+const unsigned DEFAULT_TRACE_RECORDS = 1 << 20;
+
+class TraceBuffer {
+public:
+
+    /// Map a ring of `capacity` records in the UNIX file `fileName`, which
+    /// is created or truncated.
+    TraceBuffer(const char *fileName, unsigned capacity);
+
+    ~TraceBuffer();
+
+    /// Start a record for the instruction at `pc`, at time `tick`.
+    void Begin(unsigned long tick, unsigned pc);
+
+    /// The instruction of the current record is `word`; if `memory`, it
+    /// accesses `memAddr`.
+    void Fetched(unsigned word, bool memory, unsigned memAddr);
+
+    /// The current instruction raised `et` at `badVAddr`.  Exceptions
+    /// raised by the kernel while handling the first one are ignored.
+    void Raised(ExceptionType et, unsigned badVAddr);
+
+private:
+    traceHeader *header;
+    traceRecord *records;
+    traceRecord *current;  ///< Record of the running instruction.
+    size_t size;           ///< Bytes mapped.
+};
+
+inline void
+TraceBuffer::Begin(unsigned long tick, unsigned pc)
+{
+    current = &records[header->count++ % header->capacity];
+    current->tick = tick;
+    current->pc = pc;
+    current->instruction = 0;
+    current->memAddr = 0;
+    current->exception = NO_EXCEPTION;
+    current->flags = TRACE_NO_FETCH;
+    current->unused = 0;
+}
+
+inline void
+TraceBuffer::Fetched(unsigned word, bool memory, unsigned memAddr)
+{
+    current->instruction = word;
+    current->flags = memory ? TRACE_MEMORY : 0;
+    current->memAddr = memAddr;
+}
+
+inline void
+TraceBuffer::Raised(ExceptionType et, unsigned badVAddr)
+{
+    if (current != nullptr && current->exception == NO_EXCEPTION) {
+        current->exception = et;
+        current->memAddr = badVAddr;
+    }
+}
+
+
+#endif
@@ -28,13 +28,12 @@ Condition::Condition(const char *debugName, Lock *conditionLock)
 {
     name = debugName;
     lock = conditionLock;
-    waitingThreads = 0;
-    waitingSem = new Semaphore(name, 0);
+    waiters = new List<Semaphore *>;
 }
 
 Condition::~Condition()
 {
-    delete waitingSem;
+    delete waiters;
 }
 
 const char *
@@ -46,10 +45,13 @@ Condition::GetName() const
 void
 Condition::Wait()
 {
+    Semaphore *waiter = new Semaphore(name, 0);
+    waiters->Append(waiter);
+
     // Release already checks if the current thread has the lock
-    waitingThreads++;
     lock->Release();
-    waitingSem->P();
+    waiter->P();
+    delete waiter;
     lock->Acquire();
 }
 
@@ -58,9 +60,8 @@ Condition::Signal()
 {
     ASSERT(lock->IsHeldByCurrentThread());
 
-    if (waitingThreads > 0) {
-        waitingSem->V();
-        waitingThreads--;
+    if (!waiters->IsEmpty()) {
+        waiters->Pop()->V();
     }
 }
 
@@ -69,8 +70,7 @@ Condition::Broadcast()
 {
     ASSERT(lock->IsHeldByCurrentThread());
 
-    while (waitingThreads > 0) {
-        waitingSem->V();
-        waitingThreads--;
+    while (!waiters->IsEmpty()) {
+        waiters->Pop()->V();
     }
 }
@@ -19,6 +19,7 @@
 
 
 #include "lock.hh"
+#include "lib/list.hh"
 
 
 /// This class defines a “condition variable”.
@@ -80,11 +81,10 @@ private:
     // Lock used.
     Lock* lock;
 
-    // Number of threads waiting for signal or broadcast.
-    int waitingThreads;
-
-    // Semaphore used to put waiting threads to sleep and later wake them up.
-    Semaphore *waitingSem;
+    // One semaphore per waiting thread, in the order they started waiting.
+    // Each waiter sleeps on its own, so that a wake-up meant for it cannot
+    // be taken by a thread that starts waiting later.
+    List<Semaphore *> *waiters;
 };
 
 
@@ -11,8 +11,16 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
+///            [-rs <random seed #>] [-tl] [-z] [-tt]
 ///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-m <physical pages>] [-ps <page size>] [-io-chunk <bytes>]
+///            [-console-batch <bytes>] [-prof [<instructions>]]
+///            [-trace <unix file> [<records>]]
+///            [-ckpt <unix file> [<ticks>]] [-restore <unix file>]
+///            [-smp-model <cpus>]
+///            [-jit <runs>] [-jit-check]
+///            [-vm-policy <policy>] [-swap <pages>] [-swap-cache <frames>]
+///            [-vm-stats]
 ///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
@@ -27,6 +35,8 @@
 ///            debugging messages.
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-tl` -- stops the timer while only one thread is runnable, instead of
+///            preempting it for nothing on every time slice.
 /// * `-z`  -- prints version and copyright information, and exits.
 ///
 /// *THREADS* options
@@ -41,6 +51,62 @@
 /// * `-s`  -- causes user programs to be executed in single-step mode.
 /// * `-x`  -- runs a user program.
 /// * `-tc` -- tests the console.
+/// * `-m`  -- sets the number of physical page frames (16 by default, at
+///            least 2, or 3 with demand loading).  Frames taken by
+///            `-swap-cache` come out of these.
+/// * `-ps` -- sets the page size in bytes, a multiple of the sector size
+///            (which is also the default) up to 64 KiB.  Memory may take up
+///            to 256 MiB.
+/// * `-io-chunk` -- sets the size in bytes of the kernel buffer through
+///                  which `Read` and `Write` move data (256 by default,
+///                  and up to 64 KiB).
+/// * `-console-batch` -- sets the size in bytes of the batches in which
+///                       output is put on the console (256 by default, and
+///                       up to 64 KiB); 0 puts it one character at a time.
+/// * `-prof` -- profiles user programs, taking the program counter every
+///              so many user instructions (100 by default); a flat profile
+///              and the disassembly of the hottest code are printed at
+///              exit.  See `userprog/profiler.hh`.
+/// * `-trace` -- writes a binary trace of the last user instructions run
+///               (1048576 by default) to a UNIX file, to be read with
+///               `bin/readtrace`.  Instructions are run one at a time.
+/// * `-ckpt` -- saves the state of the user program to a UNIX file at its
+///              first system call after so many ticks (0 by default), or as
+///              soon as it runs alone with no files open.  See
+///              `userprog/checkpoint.hh`.
+/// * `-restore` -- resumes a user program from a checkpoint, instead of
+///                 starting one with `-x`.
+/// * `-smp-model` -- estimates how long the run would take on a
+///                   multiprocessor with so many CPUs (up to 16), and how
+///                   much of it each would spend waiting for the kernel.
+///                   The CPUs are simulated one at a time on a single host
+///                   thread, so this is a cost model, not a measurement of
+///                   a parallel kernel.  See `userprog/multiprocessor.hh`.
+/// * `-jit` -- turns on the compiler of user code to host code, when built
+///             with `JIT`, and sets the number of runs after which a block
+///             is compiled (50 is a good start); 0, the default, leaves it
+///             off.
+/// * `-jit-check` -- runs every block of compiled code again through the
+///                   interpreter, and checks that both leave the same
+///                   registers after each instruction; it takes `-jit` as
+///                   well.
+///
+/// *VMEM* options
+/// --------------
+///
+/// * `-vm-policy` -- selects the page replacement policy, one of `fifo`,
+///                   `random`, `clock`, `wsclock`, `aging` and `lru2`.
+/// * `-swap` -- sets the number of pages the swap area holds (16 per frame
+///              by default, and no more than a quarter of the disk with
+///              *FILESYS*).  A process that needs a frame when memory is
+///              full of dirty pages and swap has no room left is killed.
+/// * `-swap-cache` -- sets the number of frames given to the compressed
+///                    swap cache, when built with `SWAP_CACHE`; 0, the
+///                    default, leaves it off.  It never takes more than a
+///                    quarter of memory.
+/// * `-vm-stats` -- prints the paging statistics of each process when it
+///                  exits: faults by cause and how long they took,
+///                  evictions, and resident set size.
 ///
 /// *FILESYS* options
 /// -----------------
@@ -92,6 +158,7 @@ void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
 void StartProcess(const char *file);
+void RestoreProcess(const char *fileName);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
 
@@ -143,6 +210,10 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-restore")) {  // Resume a user program.
+            ASSERT(argc > 1);
+            RestoreProcess(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-tc")) {  // Test the console.
             if (argc == 1) {
                 ConsoleTest(nullptr, nullptr);
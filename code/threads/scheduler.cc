@@ -58,6 +58,30 @@ Scheduler::ReadyToRun(Thread *thread)
 
     thread->SetStatus(READY);
     readyList[thread->GetPriority()]->Append(thread);
+
+    // A tickless kernel stops the timer while nobody waits for the CPU;
+    // now somebody does, so time slicing has to resume.
+    if (ticklessTimer && timer != nullptr) {
+        timer->Start();
+    }
+
+#ifdef USER_PROGRAM
+    if (multiprocessor != nullptr) {
+        multiprocessor->Kick();
+    }
+#endif
+}
+
+/// Return whether no thread is waiting for the CPU.
+bool
+Scheduler::IsEmpty() const
+{
+    for (unsigned i = 0; i < NUMBER_QUEUES; i++) {
+        if (!readyList[i]->IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /// Return the next thread to be scheduled onto the CPU.
@@ -110,6 +134,10 @@ Scheduler::Run(Thread *nextThread)
         currentThread->SaveUserState();
         currentThread->space->SaveState();
     }
+    if (multiprocessor != nullptr) {
+        // Possibly on another CPU, now that the TLB has been saved.
+        multiprocessor->Dispatch(nextThread);
+    }
 #endif
 
     oldThread->CheckOverflow();  // Check if the old thread had an undetected
@@ -35,6 +35,9 @@ public:
     /// Dequeue first thread on the ready list, if any, and return thread.
     Thread *FindNextToRun();
 
+    /// Whether there are no ready threads.
+    bool IsEmpty() const;
+
     /// Cause `nextThread` to start running.
     void Run(Thread *nextThread);
 
@@ -43,6 +43,14 @@ void SysInfo()
 #endif
       ;
 
+#ifdef USER_PROGRAM
+    unsigned pageSize = PAGE_SIZE, numPhysPages = NUM_PHYS_PAGES;
+#else
+    // There is no machine to configure; show the defaults.
+    unsigned pageSize = DEFAULT_PAGE_SIZE;
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+#endif
+
     printf("System information.\n");
     printf("\n\
 General:\n\
@@ -54,7 +62,8 @@ Memory:\n\
   Page size: %u bytes.\n\
   Number of pages: %u.\n\
   Number of TLB entries: %u.\n\
-  Memory size: %u bytes.\n", PAGE_SIZE, NUM_PHYS_PAGES, TLB_SIZE, MEMORY_SIZE);
+  Memory size: %u bytes.\n", pageSize, numPhysPages, TLB_SIZE,
+      pageSize * numPhysPages);
     printf("\n\
 Disk:\n\
   Sector size: %u bytes.\n\
@@ -13,8 +13,12 @@
 #include "userprog/debugger.hh"
 #include "userprog/exception.hh"
 #include "userprog/synch_console.hh"
+#include "userprog/transfer.hh"
 #endif
 
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -31,6 +35,8 @@ Interrupt *interrupt;         ///< Interrupt status.
 Statistics *stats;            ///< Performance metrics.
 Timer *timer;                 ///< The hardware timer device, for invoking
                               ///< context switches.
+bool ticklessTimer = false;   ///< Whether the timer is stopped while it has
+                              ///< nothing to do.
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = nullptr;
@@ -47,12 +53,28 @@ SynchDisk *synchDisk;
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
 Machine *machine;  ///< User program memory and registers.
 SynchConsole *synchConsole;
+Profiler *profiler = nullptr;  ///< Samples user program counters.
+Multiprocessor *multiprocessor = nullptr;  ///< Null on a uniprocessor.
 #ifndef USE_SWAP
 Bitmap *usedPages;
 #else
 Coremap *usedPages;
+SwapArea *swapArea;  ///< Backing store for evicted pages.
+ReplacementPolicy *replacementPolicy = nullptr;
+#endif
+#ifdef PAGE_CLEANER
+PageCleaner *pageCleaner = nullptr;  ///< Writes dirty pages back ahead of demand.
+#endif
+#ifdef DEMAND_LOADING
+unsigned zeroFrame;  ///< Shared read-only frame of zeroes.
 #endif
 Table<Thread *> *runningThreads;
+unsigned ioChunkSize = DEFAULT_IO_CHUNK_SIZE;  ///< Kernel buffer of `Read`/`Write`.
+const char *checkpointFile = nullptr;  ///< Where to save the next checkpoint.
+unsigned long checkpointTicks = 0;     ///< Not before this time.
+#ifdef VMEM
+bool printVmStats = false;  ///< Print `VmStats` of each process at exit.
+#endif
 #endif
 
 #ifdef NETWORK
@@ -62,6 +84,24 @@ PostOffice *postOffice;
 // External definition, to allow us to take a pointer to this function.
 extern void Cleanup();
 
+/// Return whether some part of the kernel other than the scheduler needs
+/// timer interrupts right now.
+static bool
+TimerWanted()
+{
+#ifdef USE_SWAP
+    if (replacementPolicy != nullptr && replacementPolicy->WantsTicks()) {
+        return true;
+    }
+#endif
+#ifdef PAGE_CLEANER
+    if (pageCleaner != nullptr && pageCleaner->WantsTicks()) {
+        return true;
+    }
+#endif
+    return false;
+}
+
 /// Interrupt handler for the timer device.
 ///
 /// The timer device is set up to interrupt the CPU periodically (once every
@@ -74,14 +114,35 @@ extern void Cleanup();
 /// done, it will appear as if the interrupted thread called Yield at the
 /// point it is was interrupted.
 ///
+/// With `-tl`, the timer is stopped as soon as no other thread waits for
+/// the CPU and nothing else needs its ticks, and started again by the
+/// scheduler once a thread becomes ready.  An idle machine then jumps
+/// straight to the next device interrupt.
+///
 /// * `dummy` is because every interrupt handler takes one argument, whether
 ///   it needs it or not.
 static void
 TimerInterruptHandler(void *dummy)
 {
-    if (interrupt->GetStatus() != IDLE_MODE) {
+    // Preempting the only runnable thread just to run it again is pure
+    // overhead, so a tickless kernel only yields if somebody is waiting.
+    bool contended = !ticklessTimer || !scheduler->IsEmpty();
+    if (interrupt->GetStatus() != IDLE_MODE && contended) {
         interrupt->YieldOnReturn();
     }
+    if (!contended && !TimerWanted()) {
+        timer->Stop();  // Until `Scheduler::ReadyToRun` starts it again.
+    }
+#ifdef USE_SWAP
+    if (replacementPolicy != nullptr) {
+        replacementPolicy->Tick();
+    }
+#endif
+#ifdef PAGE_CLEANER
+    if (pageCleaner != nullptr) {
+        pageCleaner->TimerTick();
+    }
+#endif
 }
 
 static bool
@@ -117,6 +178,28 @@ ParseDebugOpts(char *s, DebugOpts *out)
     return true;
 }
 
+#ifdef USER_PROGRAM
+/// Return the value of `option`, `s`, which must be a whole number from
+/// `min` to `max`.  Stop with a message otherwise.
+static unsigned
+ParseNumber(const char *option, const char *s, unsigned min, unsigned max)
+{
+    ASSERT(option != nullptr);
+    ASSERT(s != nullptr);
+
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(s, &end, 10);
+    if (!isdigit(*s) || *end != '\0' || errno == ERANGE
+          || n < min || n > max) {
+        fprintf(stderr, "Option %s takes a number from %u to %u, not `%s`.\n",
+                option, min, max, s);
+        ASSERT(false);
+    }
+    return n;
+}
+#endif
+
 /// Initialize Nachos global data structures.
 ///
 /// Interpret command line arguments in order to determine flags for the
@@ -145,6 +228,33 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    unsigned pageSize = DEFAULT_PAGE_SIZE;
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+    unsigned consoleBatchSize = DEFAULT_CONSOLE_BATCH_SIZE;
+    unsigned profileInterval = 0;  // Do not profile.
+    const char *traceFile = nullptr;
+    unsigned traceRecords = DEFAULT_TRACE_RECORDS;
+    unsigned numCpus = 1;
+#endif
+#ifdef USE_SWAP
+    // Page replacement policy; the `PRPOLICY_*` macros set the default.
+#ifdef PRPOLICY_FIFO
+    const char *vmPolicy = "fifo";
+#elif defined(PRPOLICY_CLOCK)
+    const char *vmPolicy = "clock";
+#else
+    const char *vmPolicy = "random";
+#endif
+#endif
+#ifdef USE_SWAP
+    unsigned swapPages = 0;  // Depends on the page size.
+#endif
+#ifdef SWAP_CACHE
+    unsigned swapCacheFrames = DEFAULT_SWAP_CACHE_FRAMES;
+#endif
+#ifdef JIT
+    unsigned jitThreshold = DEFAULT_JIT_THRESHOLD;
+    bool jitChecking = false;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -174,6 +284,8 @@ Initialize(int argc, char **argv)
               // Initialize pseudo-random number generator.
             randomYield = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-tl")) {
+            ticklessTimer = true;
         }
         // 2007, Jose Miguel Santos Espino
         else if (!strcmp(*argv, "-p")) {
@@ -188,6 +300,92 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-m")) {
+            ASSERT(argc > 1);
+            numPhysPages = ParseNumber(*argv, *(argv + 1), MIN_NUM_PHYS_PAGES,
+                                       MAX_MEMORY_SIZE / SECTOR_SIZE);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ps")) {
+            ASSERT(argc > 1);
+            pageSize = ParseNumber(*argv, *(argv + 1), SECTOR_SIZE,
+                                   MAX_PAGE_SIZE);
+            if (pageSize % SECTOR_SIZE != 0) {
+                fprintf(stderr, "The page size must be a multiple of the"
+                        " sector size, %u bytes.\n", SECTOR_SIZE);
+                ASSERT(false);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-io-chunk")) {
+            ASSERT(argc > 1);
+            ioChunkSize = ParseNumber(*argv, *(argv + 1), 1,
+                                      MAX_IO_CHUNK_SIZE);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-console-batch")) {
+            ASSERT(argc > 1);
+            consoleBatchSize = ParseNumber(*argv, *(argv + 1), 0,
+                                           MAX_CONSOLE_BATCH_SIZE);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-prof")) {
+            profileInterval = DEFAULT_PROFILE_INTERVAL;
+            if (argc > 1 && isdigit(**(argv + 1))) {
+                profileInterval = atoi(*(argv + 1));
+                ASSERT(profileInterval > 0);
+                argCount = 2;
+            }
+        } else if (!strcmp(*argv, "-trace")) {
+            ASSERT(argc > 1);
+            traceFile = *(argv + 1);
+            argCount = 2;
+            if (argc > 2 && isdigit(**(argv + 2))) {
+                traceRecords = atoi(*(argv + 2));
+                ASSERT(traceRecords > 0);
+                argCount = 3;
+            }
+        } else if (!strcmp(*argv, "-ckpt")) {
+            ASSERT(argc > 1);
+            checkpointFile = *(argv + 1);
+            argCount = 2;
+            if (argc > 2 && isdigit(**(argv + 2))) {
+                checkpointTicks = strtoul(*(argv + 2), nullptr, 10);
+                argCount = 3;
+            }
+        } else if (!strcmp(*argv, "-smp-model")) {
+            ASSERT(argc > 1);
+            numCpus = ParseNumber(*argv, *(argv + 1), 1, MAX_CPUS);
+            argCount = 2;
+        }
+#endif
+#ifdef JIT
+        if (!strcmp(*argv, "-jit")) {
+            ASSERT(argc > 1);
+            jitThreshold = ParseNumber(*argv, *(argv + 1), 0, UINT_MAX);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-jit-check")) {
+            jitChecking = true;
+        }
+#endif
+#ifdef USE_SWAP
+        if (!strcmp(*argv, "-vm-policy")) {
+            ASSERT(argc > 1);
+            vmPolicy = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-swap")) {
+            ASSERT(argc > 1);
+            swapPages = ParseNumber(*argv, *(argv + 1), 1,
+                                    MAX_SWAP_SIZE / SECTOR_SIZE);
+            argCount = 2;
+        }
+#endif
+#ifdef VMEM
+        if (!strcmp(*argv, "-vm-stats")) {
+            printVmStats = true;
+        }
+#endif
+#ifdef SWAP_CACHE
+        if (!strcmp(*argv, "-swap-cache")) {
+            ASSERT(argc > 1);
+            swapCacheFrames = ParseNumber(*argv, *(argv + 1), 0, UINT_MAX);
+            argCount = 2;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -240,13 +438,47 @@ Initialize(int argc, char **argv)
     }
 
 #ifdef USER_PROGRAM
+    if (numPhysPages > MAX_MEMORY_SIZE / pageSize) {
+        fprintf(stderr, "At most %u physical pages of %u bytes fit in"
+                " memory.\n", MAX_MEMORY_SIZE / pageSize, pageSize);
+        ASSERT(false);
+    }
+    SetMemoryGeometry(pageSize, numPhysPages);
     Debugger *d = debugUserProg ? new Debugger : nullptr;
     machine = new Machine(d);  // This must come first.
-    synchConsole = new SynchConsole("Main synch console");
+    #ifdef JIT
+    if (jitThreshold > 0) {
+        machine->EnableJit(jitThreshold, jitChecking);
+    }
+    #endif
+    if (traceFile != nullptr) {
+        machine->EnableTrace(traceFile, traceRecords);
+    }
+    if (profileInterval > 0) {
+        profiler = new Profiler(profileInterval);
+    }
+    if (numCpus > 1) {
+        multiprocessor = new Multiprocessor(numCpus);
+    }
+    synchConsole = new SynchConsole("Main synch console", consoleBatchSize);
     #ifndef USE_SWAP
     usedPages = new Bitmap(NUM_PHYS_PAGES);
     #else
     usedPages = new Coremap(NUM_PHYS_PAGES);
+    replacementPolicy = ReplacementPolicy::Create(vmPolicy, NUM_PHYS_PAGES);
+    if (replacementPolicy == nullptr) {
+        fprintf(stderr, "Unknown page replacement policy `%s`; valid ones"
+                " are: %s.\n", vmPolicy, ReplacementPolicy::Names());
+        ASSERT(false);
+    }
+    #endif
+    #ifdef DEMAND_LOADING
+    // Memory starts zeroed, and nobody ever writes to this frame.
+    #ifndef USE_SWAP
+    zeroFrame = usedPages->Find();
+    #else
+    zeroFrame = usedPages->Reserve();
+    #endif
     #endif
     SetExceptionHandlers();
 #endif
@@ -259,6 +491,42 @@ Initialize(int argc, char **argv)
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef USE_SWAP
+    if (swapPages == 0) {
+        swapPages = SWAP_PAGES_PER_FRAME * NUM_PHYS_PAGES;
+        if (swapPages > MAX_SWAP_SIZE / PAGE_SIZE) {
+            swapPages = MAX_SWAP_SIZE / PAGE_SIZE;
+        }
+    #ifdef FILESYS
+        // The swap file is kept on the simulated disk; leave most of it to
+        // other files.
+        unsigned diskPages = NUM_SECTORS * SECTOR_SIZE / 4 / PAGE_SIZE;
+        if (swapPages > diskPages) {
+            swapPages = diskPages > 0 ? diskPages : 1;
+        }
+    #endif
+    } else if (swapPages > MAX_SWAP_SIZE / PAGE_SIZE) {
+        fprintf(stderr, "At most %u swap pages of %u bytes fit in the swap"
+                " area.\n", MAX_SWAP_SIZE / PAGE_SIZE, PAGE_SIZE);
+        ASSERT(false);
+    }
+#endif
+#ifdef SWAP_CACHE
+    // Leave most of memory to user programs; this also leaves them at least
+    // `MIN_NUM_PHYS_PAGES - 1` frames besides the page of zeroes.
+    if (swapCacheFrames > NUM_PHYS_PAGES / 4) {
+        swapCacheFrames = NUM_PHYS_PAGES / 4;
+    }
+    swapArea = new SwapArea("SWAP", swapPages, swapCacheFrames);
+#elif defined(USE_SWAP)
+    swapArea = new SwapArea("SWAP", swapPages);
+#endif
+
+#ifdef PAGE_CLEANER
+    pageCleaner = new PageCleaner(PAGE_CLEANER_LOW_WATERMARK,
+                                  PAGE_CLEANER_PERIOD);
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
@@ -279,24 +547,25 @@ Cleanup()
 #endif
 
 #ifdef USER_PROGRAM  
+    #ifdef USE_SWAP
+    #ifdef PAGE_CLEANER
+    // The cleaner may be blocked in the middle of a write to swap.
+    if (pageCleaner != nullptr) {
+        pageCleaner->Stop();
+    }
+    #endif
+    // Removing the swap file may need to take file system locks, so do it
+    // while there is still a current thread.
+    DEBUG('f', "Removing swap area from halt\n");
+    delete swapArea;
+    swapArea = nullptr;
+    #endif
+
     currentThread = nullptr;
     for (unsigned i = 0; i < runningThreads->SIZE; i++) {
         Thread *t = runningThreads->Get(i);
         if (t != nullptr) {
             #ifdef USE_SWAP
-            #ifdef FILESYS
-            currentThread = t;
-            #endif
-            if (t->space != nullptr) {
-                if (t->space->nameSwap != nullptr) {
-                    DEBUG('f', "Removing swap file %s from halt\n", t->space->nameSwap);
-                    #ifndef FILESYS_STUB
-                    fileSystem->Close(t->space->swap->GetGlobalId());
-                    #endif
-                    fileSystem->Remove(t->space->nameSwap);
-                }
-            }
-            currentThread = nullptr;
             delete t;
             #endif
         }
@@ -317,6 +586,16 @@ Cleanup()
 #endif
 
     printf("\n");
+#ifdef USER_PROGRAM
+    if (profiler != nullptr) {
+        profiler->Print();
+        delete profiler;
+    }
+    if (multiprocessor != nullptr) {
+        multiprocessor->Print();
+        delete multiprocessor;
+    }
+#endif
     stats->Print();
 
     delete timer;
@@ -32,20 +32,42 @@ extern Scheduler *scheduler;         ///< The ready list.
 extern Interrupt *interrupt;         ///< Interrupt status.
 extern Statistics *stats;            ///< Performance metrics.
 extern Timer *timer;                 ///< The hardware alarm clock.
+extern bool ticklessTimer;           ///< Stop the timer when it is idle.
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
 #include "userprog/synch_console.hh"
+#include "userprog/profiler.hh"
+#include "userprog/multiprocessor.hh"
 extern Machine *machine;  // User program memory and registers.
 extern SynchConsole *synchConsole;
+extern Profiler *profiler;  // Null unless profiling user programs.
+extern Multiprocessor *multiprocessor;  // Null unless there are several CPUs.
 #ifndef USE_SWAP
 #include "lib/bitmap.hh"
 extern Bitmap *usedPages;
 #else
 #include "vmem/coremap.hh"
+#include "vmem/swap_area.hh"
+#include "vmem/replacement_policy.hh"
 extern Coremap *usedPages;
+extern SwapArea *swapArea;
+extern ReplacementPolicy *replacementPolicy;
+#endif
+#ifdef PAGE_CLEANER
+#include "vmem/page_cleaner.hh"
+extern PageCleaner *pageCleaner;
+#endif
+#ifdef DEMAND_LOADING
+extern unsigned zeroFrame;
 #endif
 extern Table<Thread *> *runningThreads;
+extern unsigned ioChunkSize;
+extern const char *checkpointFile;  // Null unless a checkpoint is pending.
+extern unsigned long checkpointTicks;
+#ifdef VMEM
+extern bool printVmStats;  // Print each process' paging at exit.
+#endif
 #endif
 
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
@@ -198,35 +198,21 @@ Thread::Finish(int code)
 
     DEBUG('t', "Finishing thread \"%s\" with code %d\n", GetName(), code);
 
-    #ifdef USE_SWAP
-    #ifdef FILESYS
-        if (space != nullptr) {
-            fileSystem->Close(space->swap->GetGlobalId());
-            fileSystem->Remove(space->nameSwap);
-            space->swap = nullptr;
-            space->nameSwap = nullptr;
-            DEBUG('t', "Swap is no more\n");
-        }
-    #endif
-    #endif
-
-    // Antes esto estaba antes de borrar el swap, pero se despertaba el thread
-    // padre antes de que termine de borrarse, por lo que intentaba obtener
-    // espacio en memoria, mandando páginas a la swap que se estaba borrando
-    // mientras, provocando seg fault
     if (joinable) {
         channel->Send(code);
     }
 
-    threadToBeDestroyed = currentThread;
-
     #ifdef USER_PROGRAM
+        // Halting may block on the disk, and whoever runs then must not
+        // destroy this thread under our feet.
         if (runningThreads->FetchCount() == 1) {
             DEBUG('t', "Finishing last process, halting machine\n");
             interrupt->Halt();
         }
     #endif
 
+    threadToBeDestroyed = currentThread;
+
     Sleep();  // Invokes `SWITCH`.
     // Not reached.
 }
@@ -289,6 +275,13 @@ Thread::Sleep()
     Thread *nextThread;
     status = BLOCKED;
     while ((nextThread = scheduler->FindNextToRun()) == nullptr) {
+#ifdef USER_PROGRAM
+        // Leave the CPU idle while the others go on; whoever makes this
+        // thread ready again gets it dispatched.
+        if (multiprocessor != nullptr && multiprocessor->Park()) {
+            return;
+        }
+#endif
         interrupt->Idle();  // No one to run, wait for an interrupt.
     }
 
@@ -4,6 +4,11 @@
 #define ARGC_ERROR    "Error: missing argument.\n"
 #define OPEN_ERROR  "Error: could not open file.\n"
 
+#define BUFFER_SIZE  1024
+
+// Not on the stack, which may be smaller than this.
+static char buffer[BUFFER_SIZE];
+
 int
 main(int argc, char *argv[])
 {
@@ -20,11 +25,13 @@ main(int argc, char *argv[])
     puts2(OPEN_ERROR);
     return -1;
   } else {
-    char buffer[1];
-    while (Read(buffer, 1, id) > 0) {
-       Write(buffer, 1, CONSOLE_OUTPUT);
+    char last = '\n';
+    int count;
+    while ((count = Read(buffer, BUFFER_SIZE, id)) > 0) {
+       Write(buffer, count, CONSOLE_OUTPUT);
+       last = buffer[count - 1];
     }
-    if (buffer[1] != '\n') {
+    if (last != '\n') {
       Write("\n", 1, CONSOLE_OUTPUT);
     }
     Close(id);
@@ -4,6 +4,11 @@
 #define ARGC_ERROR    "Error: missing argument.\n"
 #define OPEN_ERROR  "Error: could not open or create file.\n"
 
+#define BUFFER_SIZE  1024
+
+// Not on the stack, which may be smaller than this.
+static char buffer[BUFFER_SIZE];
+
 int
 main(int argc, char *argv[])
 {
@@ -22,10 +27,10 @@ main(int argc, char *argv[])
     puts2(OPEN_ERROR);
     return -1;
   } else {
-    char buffer[1];
-    
-    while (Read(buffer, 1, inputFile) > 0) {
-       Write(buffer, 1, outputFile);
+    int count;
+
+    while ((count = Read(buffer, BUFFER_SIZE, inputFile)) > 0) {
+       Write(buffer, count, outputFile);
     }
     Close(inputFile);
     Close(outputFile);
@@ -0,0 +1,96 @@
+/// Measure the throughput of `Read` and `Write` on large files.
+///
+/// Usage: `iobench <size>`.
+///
+/// Writes a file of `size` bytes, copies it as `cp` does and reads the copy
+/// back as `cat` does, checking its contents; all of it in chunks of
+/// `BUFFER_SIZE` bytes.  Run it under `time`, and compare the ticks and
+/// the page hits printed when Nachos halts: every page of a buffer moved
+/// by the kernel counts as one hit.
+///
+/// Exits with 0 if the copy is good.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+#define ARGC_ERROR  "Error: missing argument.\n"
+#define OPEN_ERROR  "Error: could not open or create file.\n"
+#define CHECK_ERROR "Error: the copy differs from the original.\n"
+
+#define BUFFER_SIZE  1024
+
+#define ORIGINAL  "iobench.in"
+#define COPY      "iobench.out"
+
+// Not on the stack, which may be smaller than this.
+static char buffer[BUFFER_SIZE];
+
+static char
+Pattern(int i)
+{
+  return (char) (i * 7 + i / 251);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (argc < 2) {
+      puts2(ARGC_ERROR);
+      Exit(1);
+  }
+  int size = atoi(argv[1]);
+
+  // Write.
+  Create(ORIGINAL);
+  OpenFileId out = Open(ORIGINAL);
+  if (out < 0) {
+    puts2(OPEN_ERROR);
+    return -1;
+  }
+  for (int done = 0; done < size; done += BUFFER_SIZE) {
+    int count = size - done < BUFFER_SIZE ? size - done : BUFFER_SIZE;
+    for (int i = 0; i < count; i++) {
+      buffer[i] = Pattern(done + i);
+    }
+    Write(buffer, count, out);
+  }
+  Close(out);
+
+  // Copy, like `cp`.
+  OpenFileId in = Open(ORIGINAL);
+  Create(COPY);
+  out = Open(COPY);
+  if (in < 0 || out < 0) {
+    puts2(OPEN_ERROR);
+    return -1;
+  }
+  int count;
+  while ((count = Read(buffer, BUFFER_SIZE, in)) > 0) {
+    Write(buffer, count, out);
+  }
+  Close(in);
+  Close(out);
+
+  // Read back, like `cat`, and check.
+  in = Open(COPY);
+  if (in < 0) {
+    puts2(OPEN_ERROR);
+    return -1;
+  }
+  int done = 0;
+  while ((count = Read(buffer, BUFFER_SIZE, in)) > 0) {
+    for (int i = 0; i < count; i++) {
+      if (buffer[i] != Pattern(done + i)) {
+        puts2(CHECK_ERROR);
+        return 1;
+      }
+    }
+    done += count;
+  }
+  Close(in);
+
+  Remove(ORIGINAL);
+  Remove(COPY);
+  return done == size ? 0 : 1;
+}
@@ -51,3 +51,120 @@ itoa(int n, char *str)
   reversestr(str, i);
 }
 
+
+int
+atoi(const char *str)
+{
+  int n = 0, minus = 0;
+
+  if (*str == '-') {
+    minus = 1;
+    str++;
+  }
+
+  for (; *str >= '0' && *str <= '9'; str++) {
+    n = n * 10 + (*str - '0');
+  }
+
+  return minus ? -n : n;
+}
+
+/// A simple first-fit allocator on top of `Sbrk`.
+///
+/// Every block starts with a header holding its size in units of headers.
+/// Free blocks are kept in a circular list sorted by address, so that
+/// neighbouring free blocks can be merged.
+
+typedef union header {
+  struct {
+    union header *next;
+    unsigned size;
+  } s;
+  long long align;
+} Header;
+
+/// Minimum number of units asked to the kernel at a time.
+#define MALLOC_CHUNK  128
+
+static Header mallocBase;
+static Header *freeList = 0;
+
+void
+free(void *ptr)
+{
+  if (ptr == 0) {
+    return;
+  }
+
+  Header *block = (Header *) ptr - 1;
+  Header *p = freeList;
+
+  // Find where the block goes in the list.
+  for (; !(block > p && block < p->s.next); p = p->s.next) {
+    if (p >= p->s.next && (block > p || block < p->s.next)) {
+      break;  // At one end of the list.
+    }
+  }
+
+  if (block + block->s.size == p->s.next) {
+    block->s.size += p->s.next->s.size;
+    block->s.next = p->s.next->s.next;
+  } else {
+    block->s.next = p->s.next;
+  }
+  if (p + p->s.size == block) {
+    p->s.size += block->s.size;
+    p->s.next = block->s.next;
+  } else {
+    p->s.next = block;
+  }
+  freeList = p;
+}
+
+static Header *
+moreCore(unsigned units)
+{
+  if (units < MALLOC_CHUNK) {
+    units = MALLOC_CHUNK;
+  }
+
+  char *mem = Sbrk(units * sizeof (Header));
+  if (mem == (char *) -1) {
+    return 0;
+  }
+
+  Header *block = (Header *) mem;
+  block->s.size = units;
+  free(block + 1);
+  return freeList;
+}
+
+void *
+malloc(unsigned size)
+{
+  unsigned units = (size + sizeof (Header) - 1) / sizeof (Header) + 1;
+
+  if (freeList == 0) {
+    mallocBase.s.next = freeList = &mallocBase;
+    mallocBase.s.size = 0;
+  }
+
+  Header *prev = freeList;
+  for (Header *p = prev->s.next; ; prev = p, p = p->s.next) {
+    if (p->s.size >= units) {
+      if (p->s.size == units) {
+        prev->s.next = p->s.next;
+      } else {
+        // Hand out the tail of the block.
+        p->s.size -= units;
+        p += p->s.size;
+        p->s.size = units;
+      }
+      freeList = prev;
+      return p + 1;
+    }
+    if (p == freeList && (p = moreCore(units)) == 0) {
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,54 @@
+/// Sort the first bytes of a file in place, through a memory mapping.
+///
+/// Usage: `msort <file> <size>`.
+///
+/// The file is never copied with `Read` or `Write`: its pages are brought
+/// in as they are touched, and written back when evicted or unmapped.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+#define ARGC_ERROR  "Error: missing argument.\n"
+#define OPEN_ERROR  "Error: could not open file.\n"
+#define MMAP_ERROR  "Error: could not map file.\n"
+
+int
+main(int argc, char *argv[])
+{
+  if (argc < 3) {
+      puts2(ARGC_ERROR);
+      Exit(1);
+  }
+
+  OpenFileId id = Open(argv[1]);
+  if (id < 0) {
+    puts2(OPEN_ERROR);
+    return -1;
+  }
+
+  // The kernel maps less if the file is shorter; the program has no way
+  // to tell, so it must be given the right size.
+  int size = atoi(argv[2]);
+  char *data = Mmap(id, 0, size);
+  if (data == 0) {
+    puts2(MMAP_ERROR);
+    Close(id);
+    return -1;
+  }
+
+  // Insertion sort.
+  for (int i = 1; i < size; i++) {
+    char c = data[i];
+    int j = i - 1;
+    while (j >= 0 && data[j] > c) {
+      data[j + 1] = data[j];
+      j--;
+    }
+    data[j + 1] = c;
+  }
+
+  Munmap(data);
+  Close(id);
+  return 0;
+}
@@ -141,6 +141,30 @@ Ps:
         j       $31
         .end    Ps
 
+        .globl  Mmap
+        .ent    Mmap
+Mmap:
+        addiu   $2, $0, SC_MMAP
+        syscall
+        j       $31
+        .end    Mmap
+
+        .globl  Munmap
+        .ent    Munmap
+Munmap:
+        addiu   $2, $0, SC_MUNMAP
+        syscall
+        j       $31
+        .end    Munmap
+
+        .globl  Sbrk
+        .ent    Sbrk
+Sbrk:
+        addiu   $2, $0, SC_SBRK
+        syscall
+        j       $31
+        .end    Sbrk
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
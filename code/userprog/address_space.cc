@@ -13,7 +13,7 @@
 
 #ifdef USE_SWAP
 #include "vmem/coremap.hh"
-#include "filesys/directory_entry.hh"
+#include "vmem/swap_area.hh"
 #endif
 
 #include <string.h>
@@ -23,22 +23,25 @@
 /// First, set up the translation from program memory to physical memory.
 /// For now, this is really simple (1:1), since we are only uniprogramming,
 /// and we have a single unsegmented page table.
-AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
+AddressSpace::AddressSpace(OpenFile *executable_file, const char *name)
 {
     ASSERT(executable_file != nullptr);
+    ASSERT(name != nullptr);
 
     exec = executable_file;
+    programName = new char [strlen(name) + 1];
+    strcpy(programName, name);
+    profile = nullptr;
 
     Executable exe (executable_file);
     ASSERT(exe.CheckMagic());
 
-    codeAddr = exe.GetCodeAddr();
-    initDataAddr = exe.GetInitDataAddr();
-    codeSize = exe.GetCodeSize();
-    initDataSize = exe.GetInitDataSize();
-
     // How big is address space?
+    #ifdef DEMAND_LOADING
+    unsigned size = exe.GetSize() + USER_STACK_LIMIT;
+    #else
     unsigned size = exe.GetSize() + USER_STACK_SIZE;
+    #endif
     // We need to increase the size to leave room for the stack.
     numPages = DivRoundUp(size, PAGE_SIZE);
     size = numPages * PAGE_SIZE;
@@ -46,15 +49,41 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
     DEBUG('a', "Initializing address space, num pages %u, size %u\n",
           numPages, size);
 
+    // Parse the layout once, so that loading a page never needs to read
+    // the header again.
+    regions[CODE_REGION] = { "code", exe.GetCodeAddr(), exe.GetCodeSize(),
+                             (int) exe.GetCodeFileAddr(), true };
+    regions[INIT_DATA_REGION] = { "init data", exe.GetInitDataAddr(),
+                                  exe.GetInitDataSize(),
+                                  (int) exe.GetInitDataFileAddr(), false };
+    regions[UNINIT_DATA_REGION] = { "uninit data", exe.GetUninitDataAddr(),
+                                    exe.GetUninitDataSize(), -1, false };
+    // The stack takes whatever is left after the program.
+    unsigned stackAddr = exe.GetSize();
+    regions[STACK_REGION] = { "stack", stackAddr, size - stackAddr,
+                              -1, false };
+    // The heap starts empty, right after the stack, and grows with `Sbrk`.
+    regions[HEAP_REGION] = { "heap", size, 0, -1, false };
+    for (unsigned r = 0; r < NUM_REGIONS; r++) {
+        DEBUG('a', "Region %s at 0x%X, size %u, file offset %d%s\n",
+              regions[r].name, regions[r].virtualAddr, regions[r].size,
+              regions[r].inFileAddr, regions[r].readOnly ? ", read-only" : "");
+    }
+
+    #ifdef DEMAND_LOADING
+    for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+        mappings[i].file = nullptr;
+    }
+    #endif
+
     #ifdef USE_SWAP
-    nameSwap = new char[FILE_NAME_MAX_LEN];
-    DEBUG('a', "Creating swap file\n");
-    snprintf(nameSwap, FILE_NAME_MAX_LEN, "SWAP.%u", pid);
-    ASSERT(fileSystem->Create(nameSwap, size));
-    ASSERT(swap = fileSystem->Open(nameSwap));
-    DEBUG('a', "Swap file created\n");
+    // Swap slots are only taken from the global swap area when a page is
+    // actually evicted.
+    swapSlots = new int[numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        swapSlots[i] = -1;
+    }
     #endif
-    inSwap = new Bitmap(numPages);
 
     #ifndef DEMAND_LOADING
     // Con demand loading no cargamos datos en este punto
@@ -65,62 +94,28 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
     #endif
 
     DEBUG('a', "Creating page table\n");
-    // First, set up the translation.
-    pageTable = new TranslationEntry[numPages];
+    // First, set up the translation.  With demand loading every page starts
+    // invalid, and entries are filled in as pages are loaded.
+    pageTable = new PageTable(numPages);
+    #ifndef DEMAND_LOADING
     for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].use          = false;
-        pageTable[i].dirty        = false;
-        pageTable[i].readOnly     = false;
-        pageTable[i].virtualPage  = i;
-        #ifndef DEMAND_LOADING
+        TranslationEntry *entry = pageTable->Get(i);
         #ifndef USE_SWAP
         int frame = usedPages->Find();
         #else
         int frame = usedPages->Find(this, i);
         #endif
-        pageTable[i].physicalPage = frame;
-        pageTable[i].valid        = true;
-        // If the code segment was entirely on a separate page, we could
-        // set its pages to be read-only.
-        memset(mainMemory + frame * PAGE_SIZE, 0, PAGE_SIZE);
-        #else
-        pageTable[i].physicalPage = NUM_PHYS_PAGES + 1;
-        pageTable[i].valid        = false;
+        entry->physicalPage = frame;
+        entry->readOnly     = IsReadOnly(i);
+        entry->valid        = true;
+        // Then, copy in the code and data segments into memory.
+        ReadFromExecutable(i, 1, mainMemory + frame * PAGE_SIZE);
+        #ifdef VMEM
+        vmStats.ResidentChanged(1);
         #endif
     }
-    DEBUG('a', "Page table created\n");
-
-    #ifndef DEMAND_LOADING
-    // Then, copy in the code and data segments into memory.
-    if (codeSize > 0) {
-        uint32_t virtualAddr = codeAddr;
-        DEBUG('a', "Initializing code segment, at 0x%X, size %u\n",
-              virtualAddr, codeSize);
-        for (uint32_t i = 0; i < codeSize; i++) {
-          // Calculamos el marco físico donde se encuentra
-          uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-          // Donde dentro de ese marco nos encontramos
-          uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-          // Y lo traducimos a la dirección física
-          uint32_t physicalAddr = frame * PAGE_SIZE + offset;
-          exe.ReadCodeBlock(&mainMemory[physicalAddr], 1, i);
-        }
-    }
-    if (initDataSize > 0) {
-        uint32_t virtualAddr = initDataAddr;
-        DEBUG('a', "Initializing data segment, at 0x%X, size %u\n",
-              virtualAddr, initDataSize);
-        for (uint32_t i = 0; i < initDataSize; i++) {
-          // Calculamos el marco físico donde se encuentra
-          uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-          // Donde dentro de ese marco nos encontramos
-          uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-          // Y lo traducimos a la dirección física
-          uint32_t physicalAddr = frame * PAGE_SIZE + offset;
-          exe.ReadDataBlock(&mainMemory[physicalAddr], 1, i);
-        }
-    }
     #endif
+    DEBUG('a', "Page table created\n");
 
     DEBUG('a', "Address space initializated\n");
 }
@@ -130,18 +125,42 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int pid)
 /// Nothing for now!
 AddressSpace::~AddressSpace()
 {
+    if (multiprocessor != nullptr) {
+        multiprocessor->Forget(this);
+    }
     for (unsigned i = 0; i < numPages; i++) {
-      if (pageTable[i].valid) {
-        usedPages->Clear(pageTable[i].physicalPage);
+      TranslationEntry *entry = pageTable->Lookup(i);
+      #ifdef USE_SWAP
+      // This runs as the thread is destroyed, where it cannot wait for
+      // writes of its pages in progress.  Those frames are only released,
+      // and the writer frees them and their swap slot when done.
+      if (entry != nullptr && HoldsFrame(i, entry)
+            && !usedPages->Clear(entry->physicalPage)) {
+        swapSlots[i] = -1;
+      }
+      #else
+      if (entry != nullptr && entry->valid && !MapsZeroFrame(entry)) {
+        usedPages->Clear(entry->physicalPage);
       }
+      #endif
     }
 
+    DEBUG('a', "Page table of %u pages took %u bytes\n",
+          numPages, (unsigned) pageTable->MemoryUsed());
     delete exec;
-    delete [] pageTable;
+    delete [] programName;
+    delete pageTable;
 
     #ifdef USE_SWAP
-    delete [] nameSwap;
-    delete inSwap;
+    // The swap area may already be gone if Nachos is halting.
+    if (swapArea != nullptr) {
+        for (unsigned i = 0; i < numPages; i++) {
+            if (swapSlots[i] != -1) {
+                swapArea->FreeSlot(swapSlots[i]);
+            }
+        }
+    }
+    delete [] swapSlots;
     #endif
 }
 
@@ -168,9 +187,10 @@ AddressSpace::InitRegisters()
     // Set the stack register to the end of the address space, where we
     // allocated the stack; but subtract off a bit, to make sure we do not
     // accidentally reference off the end!
-    machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
-    DEBUG('a', "Initializing stack register to %u\n",
-          numPages * PAGE_SIZE - 16);
+    unsigned stackTop = regions[STACK_REGION].virtualAddr
+                        + regions[STACK_REGION].size;
+    machine->WriteRegister(STACK_REG, stackTop - 16);
+    DEBUG('a', "Initializing stack register to %u\n", stackTop - 16);
 }
 
 /// On a context switch, save any machine state, specific to this address
@@ -181,14 +201,11 @@ void
 AddressSpace::SaveState()
 {
   #ifdef USE_TLB
-  unsigned vpn;
   TranslationEntry *tlb = machine->GetMMU()->tlb;
 
   for (unsigned i = 0; i < TLB_SIZE; i++) {
     if (tlb[i].valid) {
-      vpn = tlb[i].virtualPage;
-      pageTable[vpn].use = tlb[i].use;
-      pageTable[vpn].dirty = tlb[i].dirty;
+      UpdateFromTlb(&tlb[i]);
     }
   }
   #endif
@@ -201,13 +218,16 @@ void
 AddressSpace::RestoreState()
 {
     #ifdef USE_TLB
+      // Shootdowns keep a CPU's TLB right for the space it last ran.
+      if (multiprocessor != nullptr && !multiprocessor->ClaimTlb(this)) {
+          return;
+      }
       DEBUG('a', "TLB has been invalidated\n");
       for (unsigned i = 0; i < TLB_SIZE; i++) {
           machine->GetMMU()->tlb[i].valid = false;
       }
     #else
-      machine->GetMMU()->pageTable     = pageTable;
-      machine->GetMMU()->pageTableSize = numPages;
+      machine->GetMMU()->pageTable = pageTable;
     #endif
 }
 
@@ -215,27 +235,183 @@ TranslationEntry*
 AddressSpace::GetTranslationEntry(unsigned vpn) {
     ASSERT(vpn >= 0 && vpn < numPages);
 
-    return &pageTable[vpn];
+    return pageTable->Get(vpn);
 }
 
-#ifdef VMEM
 void
-AddressSpace::LoadPage(unsigned vpn)
-{  
-  ASSERT(!pageTable[vpn].valid);
+AddressSpace::UpdateFromTlb(const TranslationEntry *tlbEntry)
+{
+    TranslationEntry *entry = GetTranslationEntry(tlbEntry->virtualPage);
+
+    entry->use = tlbEntry->use;
+    entry->dirty = tlbEntry->dirty;
+    #ifdef USE_SWAP
+    if (entry->valid && !MapsZeroFrame(entry)) {
+        usedPages->Update(entry->physicalPage, entry->use, entry->dirty);
+    }
+    #endif
+}
+
+bool
+AddressSpace::CanCheckpoint() const
+{
+    #ifdef DEMAND_LOADING
+    for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+        if (mappings[i].file != nullptr) {
+            return false;
+        }
+    }
+    #endif
+    return true;
+}
+
+/// Pages are saved wherever they are: in memory, or in swap.  Read-only
+/// pages and pages that were never brought in are left out, since loading
+/// them again from the executable gives the same contents.
+bool
+AddressSpace::SavePage(unsigned vpn, char *into)
+{
+    ASSERT(vpn < numPages);
+    ASSERT(into != nullptr);
+
+    if (IsReadOnly(vpn)) {
+        return false;
+    }
+
+    const TranslationEntry *entry = pageTable->Lookup(vpn);
+    if (entry != nullptr && entry->valid) {
+        if (MapsZeroFrame(entry)) {
+            return false;
+        }
+        const char *mainMemory = machine->GetMMU()->mainMemory;
+        memcpy(into, &mainMemory[entry->physicalPage * PAGE_SIZE], PAGE_SIZE);
+        return true;
+    }
+    #ifdef USE_SWAP
+    if (swapSlots[vpn] != -1) {
+        swapArea->ReadPage(swapSlots[vpn], into);
+        return true;
+    }
+    #endif
+    return false;
+}
+
+/// The page is left dirty, so that it goes to swap rather than being
+/// loaded again from the executable if it is evicted.
+bool
+AddressSpace::RestorePage(unsigned vpn, const char *from)
+{
+    ASSERT(vpn < numPages);
+    ASSERT(from != nullptr);
+
+    TranslationEntry *entry = pageTable->Get(vpn);
+    #ifdef VMEM
+    if (MapsZeroFrame(entry)) {
+        entry->valid    = false;
+        entry->readOnly = false;
+    }
+    if (!entry->valid) {
+        #ifdef DEMAND_LOADING
+        bool loaded = LoadPage(vpn, true);
+        #else
+        bool loaded = LoadPage(vpn);
+        #endif
+        if (!loaded) {
+            return false;
+        }
+        entry = pageTable->Get(vpn);
+    }
+    #endif
+    ASSERT(entry->valid);
+
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    memcpy(&mainMemory[entry->physicalPage * PAGE_SIZE], from, PAGE_SIZE);
+    entry->dirty = true;
+    #ifdef USE_SWAP
+    usedPages->Update(entry->physicalPage, entry->use, true);
+    #endif
+    return true;
+}
+
+unsigned
+AddressSpace::GetHeapSize() const
+{
+    return regions[HEAP_REGION].size;
+}
+
+const char *
+AddressSpace::GetProgramName() const
+{
+    return programName;
+}
+
+#ifdef VMEM
+VmStats *
+AddressSpace::GetVmStats()
+{
+  return &vmStats;
+}
+
+bool
+AddressSpace::LoadPage(unsigned vpn, bool forWrite, FaultType *type)
+{
+  #ifdef USE_SWAP
+  // Another thread may be evicting the page; it is only in swap once the
+  // write is over.
+  WaitForWriteBack(vpn);
+  #endif
+
+  TranslationEntry *entry = pageTable->Get(vpn);
+  ASSERT(!entry->valid);
 
-  #if defined(DEMAND_LOADING) || defined(USE_SWAP)
-  unsigned virtualAddr = vpn * PAGE_SIZE;
+  FaultType loadType = DEMAND_LOAD_FAULT;
+
+  #ifdef DEMAND_LOADING
+  // Pages of zeroes share a single read-only frame until they are written.
+  if (!forWrite && IsZeroFill(vpn)) {
+    DEBUG('e', "Page %u mapped to the zero frame\n", vpn);
+    entry->physicalPage = zeroFrame;
+    entry->readOnly     = true;
+    entry->valid        = true;
+    if (type != nullptr) {
+      *type = ZERO_FILL_FAULT;
+    }
+    return true;
+  }
+  #else
+  ASSERT(!forWrite);
+  #endif
+
+  #ifdef DEMAND_LOADING
+  // Whether memory was full and a page had to be evicted.
+  bool evicted = false;
   #endif
 
   #ifndef USE_SWAP
   int frame = usedPages->Find();
   #else
+  // The frame stays pinned until the page is in, so that nobody picks it
+  // as a victim while it is being filled.
   int frame = usedPages->Find(this, vpn);
-  if (frame == - 1) {
+  if (frame != -1) {
+    usedPages->Pin(frame);
+  } else {
+    #ifdef DEMAND_LOADING
+    evicted = true;
+    #endif
     frame = PickVictim();
-    HandleVictim(frame);
+    usedPages->Pin(frame);
+    if (!HandleVictim(frame)) {
+      usedPages->Unpin(frame);
+      DEBUG('e', "No swap slot left for the victim of page %u\n", vpn);
+      return false;
+    }
+    vmStats.EvictionInflicted();
     usedPages->Mark(frame, this, vpn);
+    #ifdef PAGE_CLEANER
+    // Memory is full; make sure the next eviction finds a clean frame.
+    pageCleaner->WakeUp();
+    #endif
   }
   #endif
   ASSERT(frame != -1);
@@ -244,53 +420,593 @@ AddressSpace::LoadPage(unsigned vpn)
   uint32_t physicalAddr = frame * PAGE_SIZE;
   memset(mainMemory + physicalAddr, 0, PAGE_SIZE);
 
+  #ifdef USE_SWAP
+  bool inSwap = swapSlots[vpn] != -1;
+  #elif defined(DEMAND_LOADING)
+  bool inSwap = false;
+  #endif
+
   #ifdef DEMAND_LOADING
-  // No se cargó nunca por demand loading y no está en swap
-  if (!inSwap->Test(vpn)) {
-    Executable exe (exec);
-    ASSERT(exe.CheckMagic());
+  Mapping *mapping = FindMapping(vpn);
+  if (mapping != nullptr) {
+    // Pages of mapped files always come from the file.
+    ReadFromMapping(mapping, vpn, &mainMemory[physicalAddr]);
+  } else if (!inSwap) {
+    // No se cargó nunca por demand loading y no está en swap
+    // Also load the following pages, if they come from the file too, in
+    // the same read.  Their frames are taken before reading, so that
+    // nobody else grabs them if the read blocks.
+    unsigned count = 1;
+    int aroundFrames[FAULT_AROUND_PAGES];
+    unsigned window = FaultAroundWindow(vpn, evicted);
+    while (count <= window) {
+      #ifndef USE_SWAP
+      int aroundFrame = usedPages->Find();
+      #else
+      int aroundFrame = usedPages->Find(this, vpn + count);
+      #endif
+      if (aroundFrame == -1) {
+        break;
+      }
+      #ifdef USE_SWAP
+      usedPages->Pin(aroundFrame);
+      #endif
+      aroundFrames[count - 1] = aroundFrame;
+      count++;
+    }
+
+    if (count == 1) {
+      ReadFromExecutable(vpn, 1, &mainMemory[physicalAddr]);
+    } else {
+      char *buffer = new char [count * PAGE_SIZE];
+      ReadFromExecutable(vpn, count, buffer);
+      memcpy(&mainMemory[physicalAddr], buffer, PAGE_SIZE);
+      for (unsigned i = 1; i < count; i++) {
+        unsigned aroundFrame = aroundFrames[i - 1];
+        memcpy(&mainMemory[aroundFrame * PAGE_SIZE], buffer + i * PAGE_SIZE,
+               PAGE_SIZE);
+        TranslationEntry *aroundEntry = pageTable->Get(vpn + i);
+        aroundEntry->physicalPage = aroundFrame;
+        aroundEntry->readOnly     = IsReadOnly(vpn + i);
+        aroundEntry->valid        = true;
+        #ifdef USE_SWAP
+        usedPages->Unpin(aroundFrame);
+        replacementPolicy->PageLoaded(aroundFrame);
+        #endif
+      }
+      delete [] buffer;
+      DEBUG('e', "Pages %u to %u loaded around fault\n",
+            vpn + 1, vpn + count - 1);
+    }
 
     DEBUG('e', "Page demand loaded\n");
-    unsigned bytesRead = 0;
-    // We are in code segment
-    if (codeSize > 0 && virtualAddr < codeSize) {
-      unsigned codeBlockSize = codeSize - virtualAddr;
-      codeBlockSize = codeBlockSize < PAGE_SIZE ? codeBlockSize : PAGE_SIZE; 
-      exe.ReadCodeBlock(&mainMemory[physicalAddr], codeBlockSize, virtualAddr);
-      bytesRead += codeBlockSize;
-      DEBUG('e', "Code loaded\n");
-    }
-    
-    // We are in init data segment
-    if (bytesRead < PAGE_SIZE && initDataSize > 0 && virtualAddr + bytesRead < initDataAddr + initDataSize) {
-      unsigned offset = bytesRead > 0 ? 0 : virtualAddr - codeSize;
-      unsigned initDataBlockSize = initDataSize - offset < PAGE_SIZE - bytesRead ? initDataSize - offset : PAGE_SIZE - bytesRead;
-      exe.ReadDataBlock(&mainMemory[physicalAddr + bytesRead], initDataBlockSize, offset);
-      bytesRead += initDataBlockSize;
-      DEBUG('e', "Data loaded\n");
-    }
-    
-    stats->numPagesDemandLoaded++;
-    ASSERT(bytesRead <= PAGE_SIZE);
+    stats->numPagesDemandLoaded += count;
+    stats->numPagesFaultedAround += count - 1;
+    vmStats.ResidentChanged(count - 1);
   }
   #endif
 
   #ifdef USE_SWAP
-  // The page is in swap
-  if (inSwap->Test(vpn)) {
-    DEBUG('e', "Página brought to swap\n");
-    ASSERT(swap->ReadAt(&mainMemory[physicalAddr], PAGE_SIZE, virtualAddr) == PAGE_SIZE);
+  // The page is in swap.  The slot is kept while the page is resident: as
+  // long as the page stays clean the copy in swap is still good, so evicting
+  // it again costs no write.
+  if (inSwap) {
+    DEBUG('e', "Page brought from swap slot %d\n", swapSlots[vpn]);
+    swapArea->ReadPage(swapSlots[vpn], &mainMemory[physicalAddr]);
     stats->numBroughtSwap++;
+    loadType = SWAP_IN_FAULT;
   }
   #endif
 
-  pageTable[vpn].physicalPage = frame;
-  pageTable[vpn].valid        = true;
+  // The table may have been resized while the page was being read.
+  entry = pageTable->Get(vpn);
+  entry->physicalPage = frame;
+  entry->readOnly     = IsReadOnly(vpn);
+  entry->valid        = true;
+
+  #ifdef USE_SWAP
+  usedPages->Unpin(frame);
+  replacementPolicy->PageLoaded(frame);
+  #endif
+
+  vmStats.ResidentChanged(1);
+  if (type != nullptr) {
+    *type = loadType;
+  }
+  return true;
 }
 #endif
 
-#ifdef USE_SWAP
+#ifdef DEMAND_LOADING
+/// Return how many pages after `vpn` should be loaded along with it.
+///
+/// Only pages that are backed by the executable and have never been loaded
+/// qualify, and the run stops at the first one that does not.  Fault-around
+/// is turned off under memory pressure: when this fault had to evict a
+/// page, or when it would leave fewer than `FAULT_AROUND_MIN_FREE` free
+/// frames.
+unsigned
+AddressSpace::FaultAroundWindow(unsigned vpn, bool evicted) const
+{
+  if (evicted) {
+    return 0;
+  }
+
+  unsigned freeFrames = usedPages->CountClear();
+  if (freeFrames <= FAULT_AROUND_MIN_FREE) {
+    return 0;
+  }
+  unsigned window = freeFrames - FAULT_AROUND_MIN_FREE;
+  if (window > FAULT_AROUND_PAGES) {
+    window = FAULT_AROUND_PAGES;
+  }
+
+  unsigned count = 0;
+  while (count < window) {
+    unsigned next = vpn + count + 1;
+    if (next >= numPages || !IsFileBacked(next)) {
+      break;
+    }
+    const TranslationEntry *entry = pageTable->Lookup(next);
+    if (entry != nullptr && entry->valid) {
+      break;
+    }
+    #ifdef USE_SWAP
+    if (swapSlots[next] != -1) {
+      break;
+    }
+    #endif
+    count++;
+  }
+  return count;
+}
+
+Mapping *
+AddressSpace::FindMapping(unsigned vpn)
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    Mapping *mapping = &mappings[i];
+    if (mapping->file != nullptr && vpn >= mapping->firstPage
+          && vpn < mapping->firstPage + mapping->numPages) {
+      return mapping;
+    }
+  }
+  return nullptr;
+}
+
+bool
+AddressSpace::IsMapped(const OpenFile *file) const
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file == file) {
+      return true;
+    }
+  }
+  return false;
+}
+
+unsigned
+AddressSpace::Map(OpenFile *file, unsigned fileAddr, unsigned size)
+{
+  ASSERT(file != nullptr);
+  ASSERT(size > 0);
+
+  Mapping *mapping = nullptr;
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file == nullptr) {
+      mapping = &mappings[i];
+      break;
+    }
+  }
+  if (mapping == nullptr) {
+    DEBUG('e', "No room for another mapping\n");
+    return 0;
+  }
+
+  // Look for enough consecutive pages above the heap that are not used by
+  // other mappings.  The page table grows if they run past its end.
+  unsigned count = DivRoundUp(size, PAGE_SIZE);
+  unsigned base = DivRoundUp(regions[HEAP_REGION].virtualAddr
+                             + regions[HEAP_REGION].size, PAGE_SIZE);
+  unsigned first = base;
+  for (unsigned vpn = base; vpn < numPages && vpn < first + count; vpn++) {
+    if (FindMapping(vpn) != nullptr) {
+      first = vpn + 1;
+    }
+  }
+  if (first + count > numPages) {
+    Grow(first + count);
+  }
+
+  mapping->file      = file;
+  mapping->firstPage = first;
+  mapping->numPages  = count;
+  mapping->fileAddr  = fileAddr;
+  mapping->size      = size;
+
+  DEBUG('e', "Mapped %u bytes of file at offset %u to pages %u to %u\n",
+        size, fileAddr, first, first + count - 1);
+  return first * PAGE_SIZE;
+}
+
+bool
+AddressSpace::Unmap(unsigned addr)
+{
+  ASSERT(currentThread->space == this);
+
+  if (addr % PAGE_SIZE != 0) {
+    return false;
+  }
+  Mapping *mapping = FindMapping(addr / PAGE_SIZE);
+  if (mapping == nullptr || mapping->firstPage != addr / PAGE_SIZE) {
+    return false;
+  }
+
+  // Get the latest use and dirty bits from the TLB.
+  SaveState();
+
+  char *mainMemory = machine->GetMMU()->mainMemory;
+  unsigned last = mapping->firstPage + mapping->numPages;
+  if (multiprocessor != nullptr) {
+    for (unsigned vpn = mapping->firstPage; vpn < last; vpn++) {
+      multiprocessor->ShootDown(this, vpn);
+    }
+  }
+  for (unsigned vpn = mapping->firstPage; vpn < last; vpn++) {
+    #ifdef USE_SWAP
+    // The file must not be written to once this returns, since it may be
+    // closed then.
+    WaitForWriteBack(vpn);
+    #endif
+    TranslationEntry *entry = pageTable->Lookup(vpn);
+    if (entry == nullptr || !entry->valid) {
+      continue;
+    }
+    if (entry->dirty) {
+      #ifdef USE_SWAP
+      usedPages->Pin(entry->physicalPage);
+      #endif
+      WriteToMapping(mapping, vpn,
+                     &mainMemory[entry->physicalPage * PAGE_SIZE]);
+      entry->dirty = false;
+      #ifdef USE_SWAP
+      usedPages->Unpin(entry->physicalPage);
+      #endif
+    }
+    usedPages->Clear(entry->physicalPage);
+    entry->valid = false;
+    vmStats.ResidentChanged(-1);
+  }
+
+  #ifdef USE_TLB
+  TranslationEntry *tlb = machine->GetMMU()->tlb;
+  for (unsigned i = 0; i < TLB_SIZE; i++) {
+    if (tlb[i].valid && tlb[i].virtualPage >= mapping->firstPage
+          && tlb[i].virtualPage < last) {
+      tlb[i].valid = false;
+    }
+  }
+  #endif
+
+  DEBUG('e', "Unmapped pages %u to %u\n", mapping->firstPage, last - 1);
+  mapping->file = nullptr;
+  return true;
+}
+
+void
+AddressSpace::UnmapAll()
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file != nullptr) {
+      Unmap(mappings[i].firstPage * PAGE_SIZE);
+    }
+  }
+}
+
+void
+AddressSpace::Grow(unsigned newNumPages)
+{
+  ASSERT(newNumPages > numPages);
+
+  pageTable->Resize(newNumPages);
+
+  #ifdef USE_SWAP
+  int *newSwapSlots = new int[newNumPages];
+  for (unsigned i = 0; i < newNumPages; i++) {
+    newSwapSlots[i] = i < numPages ? swapSlots[i] : -1;
+  }
+  delete [] swapSlots;
+  swapSlots = newSwapSlots;
+  #endif
+
+  numPages = newNumPages;
+
+  #ifndef USE_TLB
+  if (currentThread->space == this) {
+    RestoreState();
+  }
+  #endif
+}
+
+bool
+AddressSpace::IsZeroFill(unsigned vpn) const
+{
+  if (IsFileBacked(vpn)) {
+    return false;
+  }
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    const Mapping *mapping = &mappings[i];
+    if (mapping->file != nullptr && vpn >= mapping->firstPage
+          && vpn < mapping->firstPage + mapping->numPages) {
+      return false;
+    }
+  }
+  #ifdef USE_SWAP
+  if (swapSlots[vpn] != -1) {
+    return false;
+  }
+  #endif
+  return true;
+}
+
+bool
+AddressSpace::IsCopyOnWrite(unsigned vpn) const
+{
+  const TranslationEntry *entry = pageTable->Lookup(vpn);
+  return entry != nullptr && MapsZeroFrame(entry);
+}
+
+bool
+AddressSpace::CopyOnWrite(unsigned vpn)
+{
+  ASSERT(currentThread->space == this);
+  ASSERT(IsCopyOnWrite(vpn));
+
+  TranslationEntry *entry = pageTable->Lookup(vpn);
+
+  // Other CPUs may still map the zero frame.
+  if (multiprocessor != nullptr) {
+    multiprocessor->ShootDown(this, vpn);
+  }
+
+  // Load the page again, this time into a frame of its own; it comes
+  // zeroed.  Then point the TLB entry that caused the fault to it.
+  entry->valid    = false;
+  entry->readOnly = false;
+  if (!LoadPage(vpn, true)) {
+    return false;
+  }
+
+  #ifdef USE_TLB
+  TranslationEntry *tlb = machine->GetMMU()->tlb;
+  for (unsigned i = 0; i < TLB_SIZE; i++) {
+    if (tlb[i].valid && tlb[i].virtualPage == vpn) {
+      tlb[i].physicalPage = entry->physicalPage;
+      tlb[i].readOnly     = false;
+    }
+  }
+  #endif
+
+  DEBUG('e', "Page %u copied from the zero frame\n", vpn);
+  return true;
+}
+
+int
+AddressSpace::Sbrk(int increment)
+{
+  Region *heap = &regions[HEAP_REGION];
+  unsigned oldBreak = heap->virtualAddr + heap->size;
+
+  // Computed in unsigned arithmetic, so that neither `-INT_MIN` nor the
+  // new break can overflow.
+  if (increment < 0 && 0U - (unsigned) increment > heap->size) {
+    return -1;
+  }
+  if (increment > 0 && (unsigned) increment > USER_HEAP_LIMIT - heap->size) {
+    DEBUG('e', "Heap cannot grow past %u bytes\n", USER_HEAP_LIMIT);
+    return -1;
+  }
+  unsigned newBreak = oldBreak + increment;
+
+  unsigned oldEnd = DivRoundUp(oldBreak, PAGE_SIZE);
+  unsigned newEnd = DivRoundUp(newBreak, PAGE_SIZE);
+
+  if (newEnd > oldEnd) {
+    // The heap cannot run into a mapping.
+    for (unsigned vpn = oldEnd; vpn < newEnd && vpn < numPages; vpn++) {
+      if (FindMapping(vpn) != nullptr) {
+        DEBUG('e', "Heap cannot grow past a mapping\n");
+        return -1;
+      }
+    }
+    if (newEnd > numPages) {
+      Grow(newEnd);
+    }
+  } else {
+    // Pages wholly above the new end are given back.
+    for (unsigned vpn = newEnd; vpn < oldEnd; vpn++) {
+      ReleasePage(vpn);
+    }
+  }
+
+  heap->size = newBreak - heap->virtualAddr;
+  DEBUG('e', "Heap end moved from 0x%X to 0x%X\n", oldBreak, newBreak);
+  return oldBreak;
+}
+
+void
+AddressSpace::ReleasePage(unsigned vpn)
+{
+  #ifdef USE_SWAP
+  // Neither the frame nor the slot may be given away while being written.
+  WaitForWriteBack(vpn);
+  #endif
+
+  TranslationEntry *entry = pageTable->Lookup(vpn);
+
+  if (entry != nullptr) {
+    if (entry->valid) {
+      InvalidateTlbEntry(vpn);
+      if (!MapsZeroFrame(entry)) {
+        usedPages->Clear(entry->physicalPage);
+        vmStats.ResidentChanged(-1);
+      }
+      entry->valid = false;
+    }
+    entry->use = entry->dirty = false;
+    entry->readOnly = false;
+  }
+
+  #ifdef USE_SWAP
+  if (swapSlots[vpn] != -1) {
+    swapArea->FreeSlot(swapSlots[vpn]);
+    swapSlots[vpn] = -1;
+  }
+  #endif
+}
+
+void
+AddressSpace::InvalidateTlbEntry(unsigned vpn)
+{
+  #ifdef USE_TLB
+  if (multiprocessor != nullptr) {
+    multiprocessor->ShootDown(this, vpn);
+  }
+  if (currentThread->space != this) {
+    return;
+  }
+  TranslationEntry *tlb = machine->GetMMU()->tlb;
+  for (unsigned i = 0; i < TLB_SIZE; i++) {
+    if (tlb[i].valid && tlb[i].virtualPage == vpn) {
+      tlb[i].valid = false;
+    }
+  }
+  #endif
+}
+
+/// Read the page `vpn` of `mapping` from its file.  The last page may be
+/// partial; the rest of it is left as is.
+void
+AddressSpace::ReadFromMapping(const Mapping *mapping, unsigned vpn,
+                              char *into)
+{
+  unsigned offset = (vpn - mapping->firstPage) * PAGE_SIZE;
+  unsigned count = mapping->size - offset < PAGE_SIZE
+                   ? mapping->size - offset : PAGE_SIZE;
+
+  DEBUG('e', "Reading page %u from mapped file\n", vpn);
+  mapping->file->ReadAt(into, count, mapping->fileAddr + offset);
+  stats->numMappedPagesRead++;
+}
+
+void
+AddressSpace::WriteToMapping(const Mapping *mapping, unsigned vpn,
+                             const char *from)
+{
+  unsigned offset = (vpn - mapping->firstPage) * PAGE_SIZE;
+  unsigned count = mapping->size - offset < PAGE_SIZE
+                   ? mapping->size - offset : PAGE_SIZE;
+
+  DEBUG('e', "Writing page %u back to mapped file\n", vpn);
+  mapping->file->WriteAt(from, count, mapping->fileAddr + offset);
+  stats->numMappedPagesWritten++;
+}
+
+#endif
+
+bool
+AddressSpace::MapsZeroFrame(const TranslationEntry *entry) const
+{
+  #ifdef DEMAND_LOADING
+  return entry->valid && entry->physicalPage == zeroFrame;
+  #else
+  return false;
+  #endif
+}
+
+bool
+AddressSpace::IsFileBacked(unsigned vpn) const
+{
+  unsigned start = vpn * PAGE_SIZE, end = start + PAGE_SIZE;
+
+  for (unsigned r = 0; r < NUM_REGIONS; r++) {
+    const Region *region = &regions[r];
+    if (region->inFileAddr >= 0 && region->size > 0
+          && start < region->virtualAddr + region->size
+          && end > region->virtualAddr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+AddressSpace::IsReadOnly(unsigned vpn) const
+{
+  unsigned start = vpn * PAGE_SIZE, end = start + PAGE_SIZE;
+
+  for (unsigned r = 0; r < NUM_REGIONS; r++) {
+    const Region *region = &regions[r];
+    if (region->readOnly && start >= region->virtualAddr
+          && end <= region->virtualAddr + region->size) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Read the parts of `count` consecutive pages starting at `vpn` that come
+/// from the executable into `into`, and zero the rest.
+///
+/// The pieces of the file-backed regions that fall inside the pages are
+/// merged while they are contiguous both in memory and in the file, so
+/// usually a single read is done whatever the number of pages.  Pages with
+/// nothing from the file do not touch it at all.
 void
+AddressSpace::ReadFromExecutable(unsigned vpn, unsigned count, char *into)
+{
+  unsigned start = vpn * PAGE_SIZE;
+  unsigned end = start + count * PAGE_SIZE;
+
+  memset(into, 0, count * PAGE_SIZE);
+
+  // Read still to be done.
+  unsigned readAddr = 0, readSize = 0, readFileAddr = 0;
+
+  for (unsigned r = 0; r < NUM_REGIONS; r++) {
+    const Region *region = &regions[r];
+    unsigned regionEnd = region->virtualAddr + region->size;
+    if (region->inFileAddr < 0 || region->size == 0
+          || start >= regionEnd || end <= region->virtualAddr) {
+      continue;
+    }
+
+    unsigned from = start > region->virtualAddr ? start : region->virtualAddr;
+    unsigned to = end < regionEnd ? end : regionEnd;
+    unsigned fileAddr = region->inFileAddr + (from - region->virtualAddr);
+
+    if (readSize > 0 && readAddr + readSize == from
+          && readFileAddr + readSize == fileAddr) {
+      readSize += to - from;
+      continue;
+    }
+    if (readSize > 0) {
+      exec->ReadAt(into + (readAddr - start), readSize, readFileAddr);
+    }
+    readAddr = from;
+    readSize = to - from;
+    readFileAddr = fileAddr;
+  }
+
+  if (readSize > 0) {
+    DEBUG('e', "Reading %u bytes at 0x%X from the executable\n",
+          readSize, readAddr);
+    exec->ReadAt(into + (readAddr - start), readSize, readFileAddr);
+  }
+}
+
+#ifdef USE_SWAP
+bool
 AddressSpace::HandleVictim(unsigned frame)
 {
   int vpn = usedPages->GetVpn(frame);
@@ -309,114 +1025,130 @@ AddressSpace::HandleVictim(unsigned frame)
   if (currentThread->space == space) {
     for (unsigned i = 0; i < TLB_SIZE; i++) {
       if (tlb[i].physicalPage == frame && tlb[i].valid) {
-        entry->dirty = tlb[i].dirty;
-        entry->use = tlb[i].use;
+        space->UpdateFromTlb(&tlb[i]);
         tlb[i].valid = false;
         break;
       }
     }
   }
-
-  // Puede pasar que al haber poco espacio en memoria, al terminar un proceso
-  // y volver al proceso padre, el proceso padre mande una pagina a swap
-  // pero swap ya no existe porque el proceso terminó
-  if (entry->dirty && swap != nullptr) {
-    DEBUG('e', "Sending page to swap\n");
-    char *mainMemory = machine->GetMMU()->mainMemory;
-    unsigned virtualAddr = vpn * PAGE_SIZE;
-    uint32_t physicalAddr = frame * PAGE_SIZE;
-    ASSERT(space->swap->WriteAt(&mainMemory[physicalAddr], PAGE_SIZE, virtualAddr) == PAGE_SIZE);
-    space->inSwap->Mark(vpn);
-    stats->numSentSwap++;
-    DEBUG('e', "Page sent to swap\n");
+  // And from the TLB of any other CPU that ran the space.
+  if (multiprocessor != nullptr) {
+    multiprocessor->ShootDown(space, vpn);
   }
 
-  entry->dirty = false;
+  // The page is taken away before it is written, so that its owner cannot
+  // change it meanwhile: a fault on it waits in `LoadPage` until the write
+  // is over, and then reads it back.
   entry->valid = false;
 
+  if (entry->dirty) {
+    if (!space->WriteBack(vpn)) {
+      entry->valid = true;
+      return false;
+    }
+    stats->numDirtyEvictions++;
+    if (usedPages->GetAddrSpace(frame) != space) {
+      DEBUG('e', "Owner of frame %u gone during the write\n", frame);
+      return true;
+    }
+  } else {
+    stats->numCleanEvictions++;
+  }
+
+  space->vmStats.EvictionSuffered();
+  space->vmStats.ResidentChanged(-1);
+
   DEBUG('e', "Frame %u freed\n", frame); 
+  return true;
 }
 
-// Second Chance Improved algorithm for picking a victim
-unsigned
-ClockPolicy() 
+/// Write a resident page to its swap slot, or to its file if it belongs to
+/// a mapping, and mark it clean.
+///
+/// Used both when evicting a dirty page and by the page cleaner.
+bool
+AddressSpace::WriteBack(unsigned vpn)
 {
-  static unsigned victim = 0;
-  unsigned temp;
-  int vpn;
-  AddressSpace* space;
-  TranslationEntry *entry;
+  TranslationEntry *entry = pageTable->Lookup(vpn);
+  ASSERT(entry != nullptr && HoldsFrame(vpn, entry));
 
-  currentThread->space->SaveState();
-  
-  // The algorithm makes at most 4 rounds
-  for (unsigned round = 1; round <= 4; round++) {
-    for (unsigned i = 0; i < NUM_PHYS_PAGES; i++) {
-      entry = nullptr;
-
-      // If it's not in the TLB, we look for it in some address space
-      if (entry == nullptr) {
-        space = usedPages->GetAddrSpace(victim);
-        if (space != nullptr) {
-          vpn = usedPages->GetVpn(victim);
-          entry = space->GetTranslationEntry(vpn);
-        }
-      }
-      // We found it! :D
-      if (entry != nullptr) {
-        if (round == 1 || round == 3) {
-          // We look for (0, 0)
-          if(!entry->use && !entry->dirty) {
-            temp = victim;
-            victim++;
-            victim %= NUM_PHYS_PAGES;
-            return temp;
-          }
-        } else if (round == 2 || round == 4) {
-          // We look for (0, 1)
-          if(!entry->use && entry->dirty) {
-            temp = victim;
-            victim++;
-            victim %= NUM_PHYS_PAGES;
-            return temp;
-          } else {
-            // If we are in the second round we have to set the use bit to false
-            if (round == 2) {
-              entry->use = false;
-            }
-          }
-        }
-      // It's free real estate
-      } else {
-        temp = victim;
-        victim++;
-        victim %= NUM_PHYS_PAGES;
-        return temp;
-      }
-      victim++;
-      victim %= NUM_PHYS_PAGES;
+  // Pages of mapped files go back to their file.
+  bool toSwap = true;
+  #ifdef DEMAND_LOADING
+  const Mapping *mapping = FindMapping(vpn);
+  toSwap = mapping == nullptr;
+  #endif
+
+  // A page keeps its slot once it has one, so only the first write
+  // allocates.  Without one, the page stays dirty.
+  if (toSwap && swapSlots[vpn] == -1) {
+    swapSlots[vpn] = swapArea->AllocateSlot();
+    if (swapSlots[vpn] == -1) {
+      return false;
     }
   }
 
-  // The function will always return in one of the rounds above, this is just
-  // for the compiler
-  return victim;
+  // Clear the dirty bit before writing: if the page is modified while the
+  // write is in progress it becomes dirty again and will be written again.
+  entry->dirty = false;
+  unsigned frame = entry->physicalPage;
+  usedPages->Update(frame, entry->use, false);
+
+  // Nobody may take the frame while it is being written from.
+  usedPages->Pin(frame);
+
+  char *mainMemory = machine->GetMMU()->mainMemory;
+  uint32_t physicalAddr = frame * PAGE_SIZE;
+  int slot = swapSlots[vpn];
+
+  #ifdef DEMAND_LOADING
+  if (mapping != nullptr) {
+    WriteToMapping(mapping, vpn, &mainMemory[physicalAddr]);
+  }
+  #endif
+  if (toSwap) {
+    DEBUG('e', "Sending page to swap slot %d\n", slot);
+    swapArea->WritePage(slot, &mainMemory[physicalAddr]);
+    stats->numSentSwap++;
+  }
+
+  // From here on, nothing of this address space may be touched unless it
+  // still holds the frame.  If it was deleted, it left us the slot.
+  if (usedPages->GetAddrSpace(frame) != this && toSwap) {
+    DEBUG('e', "Page written to swap after its owner went away\n");
+    swapArea->FreeSlot(slot);
+  }
+  usedPages->Unpin(frame);
+  return true;
+}
+
+bool
+AddressSpace::HoldsFrame(unsigned vpn, const TranslationEntry *entry) const
+{
+  ASSERT(entry != nullptr);
+
+  unsigned frame = entry->physicalPage;
+  return frame < usedPages->size && usedPages->GetAddrSpace(frame) == this
+         && usedPages->GetVpn(frame) == (int) vpn;
+}
+
+void
+AddressSpace::WaitForWriteBack(unsigned vpn)
+{
+  for (;;) {
+    const TranslationEntry *entry = pageTable->Lookup(vpn);
+    if (entry == nullptr || !HoldsFrame(vpn, entry)
+          || !usedPages->IsPinned(entry->physicalPage)) {
+      return;
+    }
+    DEBUG('e', "Waiting for page %u to be written back\n", vpn);
+    usedPages->WaitUnpinned(entry->physicalPage);
+  }
 }
 
 unsigned
 AddressSpace::PickVictim()
 {
-  #ifdef PRPOLICY_FIFO
-    static int victim = -1;
-    victim++;
-    victim %= NUM_PHYS_PAGES;
-    return victim;
-  #elif PRPOLICY_CLOCK
-    return ClockPolicy();
-  #else 
-    // If no policy is selected we use a random number as policy
-    return random() % NUM_PHYS_PAGES;
-  #endif
-
+  return replacementPolicy->PickVictim();
 }
-#endif
\ No newline at end of file
+#endif
@@ -15,12 +15,81 @@
 
 
 #include "filesys/file_system.hh"
+#include "machine/page_table.hh"
 #include "machine/translation_entry.hh"
 #include "lib/bitmap.hh"
+#ifdef VMEM
+#include "vmem/vm_stats.hh"
+#endif
+
+
+struct ProgramProfile;
 
 
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
 
+/// With demand loading, the stack can grow up to this size.  Its pages are
+/// only given a frame when they are first written, so the unused part of it
+/// costs nothing but page table entries.
+const unsigned USER_STACK_LIMIT = 16 * 1024;
+
+/// Largest heap a process can get with `Sbrk`.  Like the stack, its pages
+/// only cost page table entries and swap slot numbers until written.
+const unsigned USER_HEAP_LIMIT = 1024 * 1024;
+
+/// Maximum number of pages loaded from the executable after the one that
+/// caused a demand loading fault.
+const unsigned FAULT_AROUND_PAGES = 4;
+
+/// Number of free frames that fault-around always leaves untouched.
+const unsigned FAULT_AROUND_MIN_FREE = 2;
+
+
+/// A range of the address space whose pages all come from the same place
+/// and have the same permissions.
+struct Region {
+    const char *name;
+
+    /// Where the region starts in the address space, and its size.
+    unsigned virtualAddr;
+    unsigned size;
+
+    /// Where the contents of the region start in the executable, or -1 if
+    /// the region is filled with zeroes.
+    int inFileAddr;
+
+    bool readOnly;
+};
+
+enum RegionKind {
+    CODE_REGION,
+    INIT_DATA_REGION,
+    UNINIT_DATA_REGION,
+    STACK_REGION,
+    HEAP_REGION,
+    NUM_REGIONS
+};
+
+/// Maximum number of files that an address space can have mapped at once.
+const unsigned MAX_MAPPINGS = 8;
+
+/// A part of a file mapped into the address space with `Mmap`.
+///
+/// Its pages are loaded from the file on demand, and written back to it
+/// (never to swap) when they are evicted dirty or unmapped.
+struct Mapping {
+    /// The mapped file, or null if this mapping slot is free.
+    OpenFile *file;
+
+    /// First page of the mapping and number of pages.
+    unsigned firstPage;
+    unsigned numPages;
+
+    /// Part of the file that is mapped.
+    unsigned fileAddr;
+    unsigned size;
+};
+
 
 class AddressSpace {
 public:
@@ -35,7 +104,8 @@ public:
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
     ///   program; it contains the object code to load into memory.
-    AddressSpace(OpenFile *executable_file, int);
+    /// * `name` is the name it was opened with, kept for checkpoints.
+    AddressSpace(OpenFile *executable_file, const char *name);
 
     /// De-allocate an address space.
     ~AddressSpace();
@@ -48,34 +118,167 @@ public:
     void SaveState();
     void RestoreState();
 
+    /// Return the page table entry of `vpn`, creating it if needed.
     TranslationEntry *GetTranslationEntry(unsigned vpn);
 
-    void LoadPage(unsigned vpn);
+    /// Copy the use and dirty bits of a TLB entry of this address space
+    /// back into its page table entry.
+    void UpdateFromTlb(const TranslationEntry *tlbEntry);
 
-    /// Number of pages in the virtual address space.
-    unsigned numPages;
+    #ifdef VMEM
+    /// Bring page `vpn` into memory, and tell where it came from in
+    /// `type`, if not null.
+    ///
+    /// Pages that would be filled with zeroes are mapped read-only to the
+    /// shared zero frame instead, unless `forWrite` is set.
+    ///
+    /// Return false, leaving the page out, if memory is full and the page
+    /// chosen to make room cannot be written back because swap is full.
+    bool LoadPage(unsigned vpn, bool forWrite = false,
+                  FaultType *type = nullptr);
+
+    VmStats *GetVmStats();
+    #endif
 
-    
-    Bitmap *inSwap;
     #ifdef USE_SWAP
-    OpenFile *swap;
-    char *nameSwap;
+    /// Write a resident page to where it is kept while not in memory and
+    /// mark it clean.  Return false, leaving the page dirty, if it needs a
+    /// swap slot and there is none left.
+    ///
+    /// The frame stays pinned during the write.  If the write blocks, the
+    /// address space may be deleted meanwhile: then the frame no longer
+    /// belongs to it once this returns, the swap slot has been freed here,
+    /// and the caller must not touch the address space any more.
+    bool WriteBack(unsigned vpn);
+    #endif
+
+    #ifdef DEMAND_LOADING
+    /// Map `size` bytes of `file`, starting at `fileAddr`, into unused pages
+    /// above the stack.
+    ///
+    /// Return the virtual address of the mapping, or 0 if it could not be
+    /// made.
+    unsigned Map(OpenFile *file, unsigned fileAddr, unsigned size);
+
+    /// Remove the mapping starting at `addr`, writing its dirty pages back
+    /// to the file.  Return false if there is no such mapping.
+    bool Unmap(unsigned addr);
+
+    /// Remove every mapping; used when the process exits.
+    void UnmapAll();
+
+    /// Whether some part of `file` is mapped.
+    bool IsMapped(const OpenFile *file) const;
+
+    /// Move the end of the heap by `increment` bytes.
+    ///
+    /// Return the previous end, or -1 if the heap would run into a mapping,
+    /// below its start or past `USER_HEAP_LIMIT`.
+    int Sbrk(int increment);
+
+    /// Whether page `vpn` is mapped to the shared zero frame, so that
+    /// writing it needs `CopyOnWrite`.
+    bool IsCopyOnWrite(unsigned vpn) const;
+
+    /// Give page `vpn`, currently mapped to the shared zero frame, a frame
+    /// of its own so that it can be written.  Return false if there is no
+    /// room for it (see `LoadPage`).
+    bool CopyOnWrite(unsigned vpn);
     #endif
 
+    /// Checkpoints (see `checkpoint.hh`).
+
+    /// Whether the whole state of the space can be saved; mapped files
+    /// cannot.
+    bool CanCheckpoint() const;
+
+    /// Copy page `vpn` into `into` and return true, unless the page still
+    /// holds what it would be loaded with.
+    bool SavePage(unsigned vpn, char *into);
+
+    /// Overwrite page `vpn` with `from`, giving it a frame if needed.
+    /// Return false if there is no room for it (see `LoadPage`).
+    bool RestorePage(unsigned vpn, const char *from);
+
+    /// Size of the heap, in bytes.
+    unsigned GetHeapSize() const;
+
+    const char *GetProgramName() const;
+
+    /// Number of pages in the virtual address space.
+    unsigned numPages;
+
+    /// Where the profiler charges samples taken in this space, if anywhere.
+    ProgramProfile *profile;
+
 private:
 
-    /// Assume linear page table translation for now!
-    TranslationEntry *pageTable;
+    /// Linear or two-level, depending on `TWO_LEVEL_PAGE_TABLE`.
+    PageTable *pageTable;
 
-    unsigned codeAddr, initDataAddr;
+    #ifdef VMEM
+    VmStats vmStats;
+    #endif
 
-    unsigned codeSize, initDataSize;
+    /// Layout of the program, parsed once from the executable header.
+    Region regions[NUM_REGIONS];
 
     OpenFile *exec;
+    char *programName;
+
+    /// Whether some part of page `vpn` is read from the executable.
+    bool IsFileBacked(unsigned vpn) const;
+
+    /// Whether page `vpn` lies entirely inside a read-only region.
+    bool IsReadOnly(unsigned vpn) const;
+
+    /// Whether `entry` maps the shared zero frame.
+    bool MapsZeroFrame(const TranslationEntry *entry) const;
+
+    void ReadFromExecutable(unsigned vpn, unsigned count, char *into);
+
+    #ifdef DEMAND_LOADING
+    unsigned FaultAroundWindow(unsigned vpn, bool evicted) const;
+
+    Mapping mappings[MAX_MAPPINGS];
+
+    /// Mapping that page `vpn` belongs to, if any.
+    Mapping *FindMapping(unsigned vpn);
+
+    /// Resize the page table to `newNumPages` entries; new pages are
+    /// invalid.
+    void Grow(unsigned newNumPages);
+
+    void ReadFromMapping(const Mapping *mapping, unsigned vpn, char *into);
+
+    /// Whether page `vpn` would be filled with zeroes when loaded.
+    bool IsZeroFill(unsigned vpn) const;
+
+    /// Drop page `vpn` and whatever backs it.
+    void ReleasePage(unsigned vpn);
+
+    void InvalidateTlbEntry(unsigned vpn);
+    void WriteToMapping(const Mapping *mapping, unsigned vpn,
+                        const char *from);
+    #endif
 
     #ifdef USE_SWAP
-    void HandleVictim(unsigned frame);
+    /// Slot of the global swap area holding each virtual page, or -1 if
+    /// the page has never been sent to swap.
+    int *swapSlots;
+
+    /// Take the page in `frame` out of memory, writing it back if dirty.
+    /// Return false, leaving it in, if it cannot be written back.
+    bool HandleVictim(unsigned frame);
     unsigned PickVictim();
+
+    /// Whether the frame `entry` points to holds page `vpn`, even if the
+    /// page is on its way out and `entry` no longer valid.
+    bool HoldsFrame(unsigned vpn, const TranslationEntry *entry) const;
+
+    /// Wait until no other thread is writing page `vpn` back, either to
+    /// clean it or to evict it.
+    void WaitForWriteBack(unsigned vpn);
     #endif
 
 };
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Run some user programs and report how many simulated ticks Nachos goes
+# through per second of wall-clock time.
+#
+# Usage: ./bench_ticks.sh [-n runs] [program...]
+#
+# Must be run from a directory with a built `nachos` (`userprog` or any
+# later one), after building the user programs.  By default `halt` and
+# `matmult` are run, 3 times each, and the fastest run is reported.  A
+# program may also be given as a path to a NOFF file.
+
+RUNS=3
+if [ "$1" = "-n" ]; then
+    RUNS=$2
+    shift 2
+fi
+PROGRAMS=${@:-halt matmult}
+
+if [ ! -x ./nachos ]; then
+    echo "nachos not found; run \`make\` first." >&2
+    exit 1
+fi
+
+printf "%-10s %12s %12s %10s %14s\n" program ticks user-ticks seconds ticks/second
+for prog in $PROGRAMS; do
+    file=$prog
+    if [ ! -f "$file" ]; then
+        file=../userland/$prog
+    fi
+    if [ ! -f "$file" ]; then
+        echo "$prog not found; skipping." >&2
+        continue
+    fi
+    best=
+    for ((i = 0; i < RUNS; i++)); do
+        start=$(date +%s.%N)
+        out=$(./nachos -m 256 -x "$file" 2>&1 </dev/zero)
+        end=$(date +%s.%N)
+        seconds=$(awk "BEGIN { print $end - $start }")
+        if [ -z "$best" ] || awk "BEGIN { exit !($seconds < $best) }"; then
+            best=$seconds
+        fi
+    done
+    ticks=$(echo "$out"     | sed -n 's/^Ticks: total \([0-9]*\).*/\1/p')
+    userTicks=$(echo "$out" | sed -n 's/^Ticks: .*user \([0-9]*\).*/\1/p')
+    rate=$(awk "BEGIN { printf \"%.0f\", ${ticks:-0} / $best }")
+    printf "%-10s %12s %12s %10.3f %14s\n" \
+           $(basename $prog) ${ticks:--} ${userTicks:--} $best $rate
+done
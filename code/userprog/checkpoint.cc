@@ -0,0 +1,268 @@
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "checkpoint.hh"
+#include "address_space.hh"
+#include "syscall.h"
+#include "machine/statistics.hh"
+#include "threads/system.hh"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/// Identifies checkpoint files: "NCKP".
+static const uint32_t CHECKPOINT_MAGIC = 0x4E434B50;
+static const uint32_t CHECKPOINT_VERSION = 2;
+
+/// Longest program name accepted, including the final null character.
+static const uint32_t MAX_NAME_LENGTH = 1024;
+
+/// Start of a checkpoint file.  It is followed by the name of the program,
+/// and then by each saved page: its number, as a `uint32_t`, and its
+/// contents.
+///
+/// Everything is in host byte order, and statistics are saved as they are
+/// laid out in memory: checkpoints are only meant to be restored by the
+/// same build of Nachos that wrote them.
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t statsSize;   ///< Size of `Statistics`.
+    uint32_t vmStatsSize; ///< Size of `VmStats`, or 0 without them.
+    uint32_t numSaved;    ///< Pages saved.
+    uint32_t heapSize;
+    uint32_t nameLength;  ///< Including the final null character.
+    int32_t registers[NUM_TOTAL_REGS];
+    Statistics stats;
+#ifdef VMEM
+    VmStats vmStats;      ///< Of the process.
+#endif
+};
+
+#ifdef VMEM
+static const uint32_t VM_STATS_SIZE = sizeof (VmStats);
+#else
+static const uint32_t VM_STATS_SIZE = 0;
+#endif
+
+/// Number of threads running user programs.
+static unsigned
+CountProcesses()
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < runningThreads->SIZE; i++) {
+        if (runningThreads->HasKey(i)
+              && runningThreads->Get(i)->space != nullptr) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/// Whether the current thread has files open besides the console.
+static bool
+HasOpenFiles()
+{
+    Table<OpenFile *> *files = currentThread->filesTable;
+    for (unsigned i = CONSOLE_OUTPUT + 1; i < files->SIZE; i++) {
+        if (files->HasKey(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+TakeCheckpoint(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    AddressSpace *space = currentThread->space;
+    ASSERT(space != nullptr);
+
+    if (CountProcesses() > 1 || HasOpenFiles() || !space->CanCheckpoint()) {
+        DEBUG('a', "Checkpoint put off: the process does not run alone, "
+                   "or it has files open\n");
+        return false;
+    }
+
+    const char *name = space->GetProgramName();
+    CheckpointHeader header;
+    header.magic      = CHECKPOINT_MAGIC;
+    header.version    = CHECKPOINT_VERSION;
+    header.pageSize   = PAGE_SIZE;
+    header.statsSize  = sizeof (Statistics);
+    header.vmStatsSize = VM_STATS_SIZE;
+    header.numSaved   = 0;
+    header.heapSize   = space->GetHeapSize();
+    header.nameLength = strlen(name) + 1;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        header.registers[i] = machine->ReadRegister(i);
+    }
+    // Taken before reading pages from swap, which takes time.
+    header.stats = *stats;
+    #ifdef VMEM
+    header.vmStats = *space->GetVmStats();
+    #endif
+
+    int fd = SystemDep::OpenForWrite(fileName);
+    SystemDep::WriteFile(fd, (const char *) &header, sizeof header);
+    SystemDep::WriteFile(fd, name, header.nameLength);
+
+    char *page = new char [PAGE_SIZE];
+    for (uint32_t vpn = 0; vpn < space->numPages; vpn++) {
+        if (space->SavePage(vpn, page)) {
+            SystemDep::WriteFile(fd, (const char *) &vpn, sizeof vpn);
+            SystemDep::WriteFile(fd, page, PAGE_SIZE);
+            header.numSaved++;
+        }
+    }
+    delete [] page;
+
+    // Now that the number of pages is known.
+    SystemDep::Lseek(fd, 0, 0);
+    SystemDep::WriteFile(fd, (const char *) &header, sizeof header);
+    SystemDep::Close(fd);
+
+    DEBUG('a', "Checkpoint of `%s` written to %s, with %u of %u pages\n",
+          name, fileName, header.numSaved, space->numPages);
+    return true;
+}
+
+/// Read exactly `size` bytes from `fd` into `buffer`; return false if the
+/// file ends first.
+static bool
+ReadAll(int fd, void *buffer, unsigned size)
+{
+    return SystemDep::ReadPartial(fd, (char *) buffer, size) == (int) size;
+}
+
+/// Give `space` the heap and the pages saved in checkpoint `fd`, read up to
+/// the pages.  Return false, after saying why, if they do not fit it.
+static bool
+RestorePages(int fd, const char *fileName, AddressSpace *space,
+             const CheckpointHeader *header)
+{
+    if (header->heapSize > 0) {
+        #ifdef DEMAND_LOADING
+        if (header->heapSize > USER_HEAP_LIMIT
+              || space->Sbrk(header->heapSize) == -1) {
+            printf("Checkpoint %s has a heap of %u bytes, which does not "
+                   "fit\n", fileName, header->heapSize);
+            return false;
+        }
+        #else
+        printf("Checkpoint %s has a heap, which needs DEMAND_LOADING\n",
+               fileName);
+        return false;
+        #endif
+    }
+
+    if (header->numSaved > space->numPages) {
+        printf("Checkpoint %s has %u pages, more than the %u of its "
+               "program\n", fileName, header->numSaved, space->numPages);
+        return false;
+    }
+
+    char *page = new char [PAGE_SIZE];
+    bool restored = true;
+    for (unsigned i = 0; i < header->numSaved && restored; i++) {
+        uint32_t vpn;
+        if (!ReadAll(fd, &vpn, sizeof vpn) || !ReadAll(fd, page, PAGE_SIZE)) {
+            printf("Checkpoint %s is cut short after %u of its %u pages\n",
+                   fileName, i, header->numSaved);
+            restored = false;
+        } else if (vpn >= space->numPages) {
+            printf("Checkpoint %s has page %u, past the %u of its program\n",
+                   fileName, vpn, space->numPages);
+            restored = false;
+        } else if (!space->RestorePage(vpn, page)) {
+            printf("Out of swap space restoring checkpoint %s\n", fileName);
+            restored = false;
+        }
+    }
+    delete [] page;
+    return restored;
+}
+
+void
+RestoreProcess(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    int fd = SystemDep::OpenForReadWrite(fileName, false);
+    if (fd < 0) {
+        printf("Unable to open checkpoint %s\n", fileName);
+        return;
+    }
+
+    CheckpointHeader header;
+    if (SystemDep::ReadPartial(fd, (char *) &header, sizeof header)
+            != (int) sizeof header
+          || header.magic != CHECKPOINT_MAGIC
+          || header.version != CHECKPOINT_VERSION
+          || header.pageSize != PAGE_SIZE
+          || header.statsSize != sizeof (Statistics)
+          || header.vmStatsSize != VM_STATS_SIZE
+          || header.nameLength == 0
+          || header.nameLength > MAX_NAME_LENGTH) {
+        printf("%s is not a checkpoint of this Nachos, with this page "
+               "size\n", fileName);
+        SystemDep::Close(fd);
+        return;
+    }
+
+    char *name = new char [header.nameLength];
+    if (!ReadAll(fd, name, header.nameLength)
+          || name[header.nameLength - 1] != '\0') {
+        printf("Checkpoint %s is cut short or corrupt\n", fileName);
+        delete [] name;
+        SystemDep::Close(fd);
+        return;
+    }
+
+    OpenFile *executable = fileSystem->Open(name);
+    if (executable == nullptr) {
+        printf("Unable to open file %s\n", name);
+        delete [] name;
+        SystemDep::Close(fd);
+        return;
+    }
+
+    AddressSpace *space = new AddressSpace(executable, name);
+    currentThread->space = space;
+    if (profiler != nullptr) {
+        profiler->Attach(space, name, executable);
+    }
+    delete [] name;
+
+    bool restored = RestorePages(fd, fileName, space, &header);
+    SystemDep::Close(fd);
+    if (!restored) {
+        delete space;
+        currentThread->space = nullptr;
+        return;
+    }
+
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, header.registers[i]);
+    }
+    space->RestoreState();
+
+    // Pending interrupts keep their distance to the present.
+    interrupt->SetTicks(header.stats.totalTicks);
+    *stats = header.stats;
+    #ifdef VMEM
+    space->GetVmStats()->Resume(header.vmStats);
+    #endif
+
+    DEBUG('a', "Restored %u pages from checkpoint %s, at tick %lu\n",
+          header.numSaved, fileName, stats->totalTicks);
+    machine->Run();  // Jump back to the user program.
+    ASSERT(false);
+}
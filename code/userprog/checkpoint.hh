@@ -0,0 +1,38 @@
+/// Checkpoints of a running user program, to start later runs from it.
+///
+/// With `-ckpt <file> [<ticks>]`, the first system call made after so many
+/// ticks writes the state of the calling process to a UNIX file: its
+/// registers, the contents of every page that differs from the executable
+/// (wherever it is: in memory or in swap), the size of its heap, and the
+/// statistics, both global and, with *VMEM*, those of the process.
+/// `-restore <file>` then boots Nachos as usual and, instead of starting a
+/// program from scratch, rebuilds that process and resumes it at the system
+/// call, which runs again.  Several runs can start from the same checkpoint.
+///
+/// Kernel stacks and the other host-side state of the kernel hold host
+/// pointers that mean nothing to another run, so only what the program can
+/// see is saved; the kernel is rebuilt by the boot.  This is only sound if
+/// nothing else depends on the kernel state, so a checkpoint waits until
+/// the process runs alone, with no files open besides the console and none
+/// mapped.  Files on the Nachos disk are not saved either: the disk must be
+/// left as it was when the checkpoint was taken.
+
+#ifndef NACHOS_USERPROG_CHECKPOINT__HH
+#define NACHOS_USERPROG_CHECKPOINT__HH
+
+
+/// Save the state of the current process to the UNIX file `fileName`.
+///
+/// Return false, without writing anything, if the process cannot be
+/// checkpointed right now.
+bool TakeCheckpoint(const char *fileName);
+
+/// Rebuild the process saved in the UNIX file `fileName` and run it.
+///
+/// Only returns, after saying why, if the checkpoint cannot be restored:
+/// the file is not a checkpoint of this build, is cut short, or does not
+/// fit the program it names.
+void RestoreProcess(const char *fileName);
+
+
+#endif
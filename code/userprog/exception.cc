@@ -27,6 +27,7 @@
 #include "filesys/directory_entry.hh"
 #include "threads/system.hh"
 #include "args.hh"
+#include "checkpoint.hh"
 
 #include <stdio.h>
 
@@ -53,6 +54,37 @@ InitProcess(void *args)
 }
 
 
+/// Terminate the current process with `status`.
+static void
+ExitProcess(int status)
+{
+    DEBUG('e', "Thread '%s' exiting with status %d\n", currentThread->GetName(), status);
+
+    #ifdef DEMAND_LOADING
+    // Write mapped files back while their files are still open.
+    currentThread->space->UnmapAll();
+    #endif
+    #ifdef VMEM
+    if (printVmStats) {
+        currentThread->space->GetVmStats()->Print(
+            currentThread->GetName());
+    }
+    #endif
+
+    currentThread->Finish(status);
+}
+
+#ifdef VMEM
+/// Kill the current process because page `vpn` cannot be brought in.
+static void
+OutOfSwap(unsigned vpn)
+{
+    fprintf(stderr, "Out of swap space for page %u of %s; killing it.\n",
+            vpn, currentThread->GetName());
+    ExitProcess(-1);
+}
+#endif
+
 static void
 IncrementPC()
 {
@@ -66,6 +98,74 @@ IncrementPC()
     machine->WriteRegister(NEXT_PC_REG, pc);
 }
 
+/// Move `size` bytes from `file`, or from the console if it is null, to
+/// user memory at `userAddress`.
+///
+/// The data goes through a kernel buffer of `ioChunkSize` bytes, one chunk
+/// at a time, so any size can be read with constant kernel memory.  Stops
+/// early on a short read, at the end of a file.  Return the number of bytes
+/// read.
+static int
+ReadToUser(OpenFile *file, int userAddress, int size)
+{
+    char *buffer = new char [ioChunkSize];
+    int done = 0;
+
+    while (done < size) {
+        int count = size - done < (int) ioChunkSize
+                    ? size - done : (int) ioChunkSize;
+        int read;
+        if (file == nullptr) {
+            synchConsole->ReadBuffer(buffer, count);
+            read = count;
+        } else {
+            read = file->Read(buffer, count);
+        }
+        if (read > 0) {
+            WriteBufferToUser(buffer, userAddress + done, read);
+            done += read;
+        }
+        if (read < count) {
+            break;
+        }
+    }
+
+    delete [] buffer;
+    return done;
+}
+
+/// Move `size` bytes from user memory at `userAddress` to `file`, or to the
+/// console if it is null, in chunks as `ReadToUser` does.  Return the number
+/// of bytes written.
+static int
+WriteFromUser(OpenFile *file, int userAddress, int size)
+{
+    char *buffer = new char [ioChunkSize];
+    int done = 0;
+
+    while (done < size) {
+        int count = size - done < (int) ioChunkSize
+                    ? size - done : (int) ioChunkSize;
+        ReadBufferFromUser(userAddress + done, buffer, count);
+        int written;
+        if (file == nullptr) {
+            synchConsole->WriteBuffer(buffer, count);
+            written = count;
+        } else {
+            written = file->Write(buffer, count);
+        }
+        if (written > 0) {
+            done += written;
+        }
+        if (written < count) {
+            break;
+        }
+    }
+
+    delete [] buffer;
+    return done;
+}
+
 /// Do some default behavior for an unexpected exception.
 ///
 /// NOTE: this function is meant specifically for unexpected exceptions.  If
@@ -105,6 +205,13 @@ SyscallHandler(ExceptionType _et)
 {
     int scid = machine->ReadRegister(2);
 
+    // Registers still point at the system call, so a restored checkpoint
+    // makes it again.
+    if (checkpointFile != nullptr && stats->totalTicks >= checkpointTicks
+          && TakeCheckpoint(checkpointFile)) {
+        checkpointFile = nullptr;
+    }
+
     switch (scid) {
 
         case SC_HALT:
@@ -114,10 +221,7 @@ SyscallHandler(ExceptionType _et)
         
         case SC_EXIT: {
             int status = machine->ReadRegister(4);
-            DEBUG('e', "Thread '%s' exiting with status %d\n", currentThread->GetName(), status);
-
-            currentThread->Finish(status);
-
+            ExitProcess(status);
             break;
         }
 
@@ -150,8 +254,11 @@ SyscallHandler(ExceptionType _et)
             }
 
             Thread *t = new Thread(filename, (bool) joinable, currentThread->GetPriority());
-            AddressSpace *space = new AddressSpace(executable, t->pid);
+            AddressSpace *space = new AddressSpace(executable, filename);
             t->space = space;
+            if (profiler != nullptr) {
+                profiler->Attach(space, filename, executable);
+            }
 
             char **args = nullptr;
 
@@ -285,6 +392,16 @@ SyscallHandler(ExceptionType _et)
             OpenFileId fid = machine->ReadRegister(4);
             DEBUG('e', "`Close` requested for id %u.\n", fid);
 
+            #ifdef DEMAND_LOADING
+            if (fid > CONSOLE_OUTPUT && currentThread->filesTable->HasKey(fid)
+                  && currentThread->space->IsMapped(
+                         currentThread->filesTable->Get(fid))) {
+                DEBUG('e', "Error: file id %u is mapped.\n", fid);
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            #endif
+
             if (currentThread->filesTable->HasKey(fid)) {
                 OpenFile *file = currentThread->filesTable->Remove(fid);
                 #ifndef FILESYS_STUB
@@ -305,7 +422,6 @@ SyscallHandler(ExceptionType _et)
             int userAddress = machine->ReadRegister(4);
             int size = machine->ReadRegister(5);
             OpenFileId fid = machine->ReadRegister(6);
-            char buffer[size];
             int bytesRead = 0;
             
             if (size <= 0) {
@@ -318,17 +434,12 @@ SyscallHandler(ExceptionType _et)
                 break;
             } else if(fid == CONSOLE_INPUT) {
                 DEBUG('e', "Reading from console.\n");
-                synchConsole->ReadBuffer(buffer, size);
-                bytesRead = size;
-                WriteBufferToUser(buffer, userAddress, bytesRead);
+                bytesRead = ReadToUser(nullptr, userAddress, size);
             } else {
                 if (currentThread->filesTable->HasKey(fid)) {
                     DEBUG('e', "Reading from file with id %u.\n", fid);
                     OpenFile *file = currentThread->filesTable->Get(fid);
-                    bytesRead = file->Read(buffer, size);
-                    if (bytesRead > 0) {
-                        WriteBufferToUser(buffer, userAddress, bytesRead);
-                    }
+                    bytesRead = ReadToUser(file, userAddress, size);
                 } else {
                     DEBUG('e', "File with id %u does not exists.\n", fid);
                     machine->WriteRegister(2, -1);
@@ -345,7 +456,6 @@ SyscallHandler(ExceptionType _et)
             int userAddress = machine->ReadRegister(4);
             int size = machine->ReadRegister(5);
             OpenFileId fid = machine->ReadRegister(6);
-            char buffer[size];
             int bytesWritten = 0;
 
             if (size <= 0) {
@@ -358,15 +468,12 @@ SyscallHandler(ExceptionType _et)
                 break;
             } else if (fid == CONSOLE_OUTPUT) {
                 DEBUG('e', "Writing to console.\n");
-                ReadBufferFromUser(userAddress, buffer, size);
-                synchConsole->WriteBuffer(buffer, size);
-                bytesWritten = size;
+                bytesWritten = WriteFromUser(nullptr, userAddress, size);
             } else {
                 if (currentThread->filesTable->HasKey(fid)) {
                     DEBUG('e', "Writing to file with id %u.\n", fid);
                     OpenFile *file = currentThread->filesTable->Get(fid);
-                    ReadBufferFromUser(userAddress, buffer, size);
-                    bytesWritten = file->Write(buffer, size);
+                    bytesWritten = WriteFromUser(file, userAddress, size);
                 } else {
                     DEBUG('e', "File with id %u does not exists.\n", fid);
                     machine->WriteRegister(2, -1);
@@ -381,6 +488,82 @@ SyscallHandler(ExceptionType _et)
 
         case SC_PS: {
             scheduler->Print();
+            #ifdef VMEM
+            for (unsigned i = 0; i < runningThreads->SIZE; i++) {
+                if (!runningThreads->HasKey(i)) {
+                    continue;
+                }
+                Thread *t = runningThreads->Get(i);
+                if (t->space != nullptr) {
+                    t->space->GetVmStats()->Print(t->GetName());
+                }
+            }
+            #endif
+            break;
+        }
+
+        case SC_MMAP: {
+            #ifdef DEMAND_LOADING
+            OpenFileId fid = machine->ReadRegister(4);
+            int offset = machine->ReadRegister(5);
+            int size = machine->ReadRegister(6);
+
+            if (fid <= CONSOLE_OUTPUT
+                  || !currentThread->filesTable->HasKey(fid)) {
+                DEBUG('e', "Error: file id %d cannot be mapped.\n", fid);
+                machine->WriteRegister(2, 0);
+                break;
+            }
+
+            OpenFile *file = currentThread->filesTable->Get(fid);
+            unsigned length = file->Length();
+            if (offset < 0 || (unsigned) offset >= length) {
+                DEBUG('e', "Error: offset %d is out of the file.\n", offset);
+                machine->WriteRegister(2, 0);
+                break;
+            }
+            // Map up to the end of the file at most.
+            if (size <= 0 || (unsigned) size > length - offset) {
+                size = length - offset;
+            }
+
+            DEBUG('e', "`Mmap` requested for file id %d, offset %d, size %d.\n",
+                  fid, offset, size);
+            machine->WriteRegister(2,
+                currentThread->space->Map(file, offset, size));
+            #else
+            DEBUG('e', "Error: mapping files needs demand loading.\n");
+            machine->WriteRegister(2, 0);
+            #endif
+            break;
+        }
+
+        case SC_SBRK: {
+            #ifdef DEMAND_LOADING
+            int increment = machine->ReadRegister(4);
+            DEBUG('e', "`Sbrk` requested, increment %d.\n", increment);
+            machine->WriteRegister(2, currentThread->space->Sbrk(increment));
+            #else
+            DEBUG('e', "Error: growing the heap needs demand loading.\n");
+            machine->WriteRegister(2, -1);
+            #endif
+            break;
+        }
+
+        case SC_MUNMAP: {
+            #ifdef DEMAND_LOADING
+            int addr = machine->ReadRegister(4);
+            DEBUG('e', "`Munmap` requested for address %d.\n", addr);
+
+            if (!currentThread->space->Unmap(addr)) {
+                DEBUG('e', "Error: no mapping starts at address %d.\n", addr);
+                machine->WriteRegister(2, -1);
+            } else {
+                machine->WriteRegister(2, 0);
+            }
+            #else
+            machine->WriteRegister(2, -1);
+            #endif
             break;
         }
         
@@ -399,6 +582,8 @@ PageFaultHandler(ExceptionType _et)
 {
     int badVAddr = machine->ReadRegister(BAD_VADDR_REG);
     unsigned vpn = badVAddr / PAGE_SIZE;
+    unsigned long start = stats->totalTicks;
+    FaultType type = TLB_MISS_FAULT;
     
     DEBUG('e', "Page fault in thread %s, virtual page %u, badVAddr %u\n",
          currentThread->GetName(), vpn, badVAddr);
@@ -407,18 +592,16 @@ PageFaultHandler(ExceptionType _et)
 
     if (!entry->valid) {
         DEBUG('e', "Page not found in memory\n");
-        currentThread->space->LoadPage(vpn);
+        if (!currentThread->space->LoadPage(vpn, false, &type)) {
+            OutOfSwap(vpn);
+        }
     }
     
     static int circularIndex = 0;
     TranslationEntry *tlb = machine->GetMMU()->tlb;
 
     if (tlb[circularIndex].valid) {
-        unsigned victimVpn = tlb[circularIndex].virtualPage;
-        TranslationEntry *victimEntry = currentThread->space->GetTranslationEntry(victimVpn);
-
-        victimEntry->use = tlb[circularIndex].use;
-        victimEntry->dirty = tlb[circularIndex].dirty;
+        currentThread->space->UpdateFromTlb(&tlb[circularIndex]);
     }
 
     tlb[circularIndex].virtualPage = vpn;
@@ -431,12 +614,29 @@ PageFaultHandler(ExceptionType _et)
     circularIndex++;
     circularIndex %= TLB_SIZE;
     stats->numPageFaults++;
+    currentThread->space->GetVmStats()->RecordFault(type,
+        stats->totalTicks - start);
 }
 #endif
 
 static void
 ReadOnlyHandler(ExceptionType _et)
-{   
+{
+    #ifdef DEMAND_LOADING
+    // Pages still mapped to the zero frame are read-only until written.
+    int badVAddr = machine->ReadRegister(BAD_VADDR_REG);
+    unsigned vpn = badVAddr / PAGE_SIZE;
+    unsigned long start = stats->totalTicks;
+    if (currentThread->space->IsCopyOnWrite(vpn)) {
+        if (!currentThread->space->CopyOnWrite(vpn)) {
+            OutOfSwap(vpn);
+        }
+        currentThread->space->GetVmStats()->RecordFault(COPY_ON_WRITE_FAULT,
+            stats->totalTicks - start);
+        return;
+    }
+    #endif
+
     fprintf(stderr, "Cannot write on page marked as read only :'(\n");
     ASSERT(false);
     return;
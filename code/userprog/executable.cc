@@ -82,6 +82,24 @@ Executable::GetInitDataAddr() const
     return header.initData.virtualAddr;
 }
 
+uint32_t
+Executable::GetUninitDataAddr() const
+{
+    return header.uninitData.virtualAddr;
+}
+
+uint32_t
+Executable::GetCodeFileAddr() const
+{
+    return header.code.inFileAddr;
+}
+
+uint32_t
+Executable::GetInitDataFileAddr() const
+{
+    return header.initData.inFileAddr;
+}
+
 int
 Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
 {
@@ -47,6 +47,11 @@ public:
     uint32_t GetInitDataAddr() const;
     uint32_t GetUninitDataAddr() const;
 
+    /// Offsets in the file where the contents of the code and the
+    /// initialized data segments are found.
+    uint32_t GetCodeFileAddr() const;
+    uint32_t GetInitDataFileAddr() const;
+
     /// The following methods read a block from a given program segment into
     /// memory.  Reads are possible only from the code and the initialized
     /// data segments, because these are the ones that actually encode their
@@ -0,0 +1,327 @@
+/// Copyright (c) 2019-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "multiprocessor.hh"
+#include "address_space.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+
+
+Multiprocessor::Multiprocessor(unsigned numCpus_)
+{
+    ASSERT(numCpus_ > 1 && numCpus_ <= MAX_CPUS);
+
+    numCpus = numCpus_;
+    cpus = new Cpu [numCpus];
+    for (unsigned i = 0; i < numCpus; i++) {
+        cpus[i].thread        = nullptr;
+        cpus[i].clock         = stats->totalTicks;
+        cpus[i].tlbSpace      = nullptr;
+        cpus[i].lockedFrom    = 0;
+        cpus[i].lockedUntil   = 0;
+        cpus[i].busyTicks     = 0;
+        cpus[i].lockWaitTicks = 0;
+        cpus[i].ipisReceived  = 0;
+        cpus[i].shootdowns    = 0;
+    }
+    running = &cpus[0];
+    running->thread = currentThread;
+    target = nullptr;
+    since = stats->totalTicks;
+    idleSince = stats->idleTicks;
+    sliceEnd = since + CPU_SLICE;
+    kicked = false;
+    lockHolder = nullptr;
+    switches = 0;
+
+    machine->SetNumCpus(numCpus);
+}
+
+Multiprocessor::~Multiprocessor()
+{
+    delete [] cpus;
+}
+
+unsigned
+Multiprocessor::Index(const Cpu *cpu) const
+{
+    return cpu - cpus;
+}
+
+unsigned long
+Multiprocessor::Now() const
+{
+    return running->clock + (stats->totalTicks - since);
+}
+
+void
+Multiprocessor::Leave()
+{
+    unsigned long spent = stats->totalTicks - since;
+    running->clock += spent;
+    running->busyTicks += spent - (stats->idleTicks - idleSince);
+    since = stats->totalTicks;
+    idleSince = stats->idleTicks;
+}
+
+bool
+Multiprocessor::SwitchDue() const
+{
+    return kicked || stats->totalTicks >= sliceEnd;
+}
+
+void
+Multiprocessor::Switch()
+{
+    kicked = false;
+
+    // A ready thread goes to an idle CPU first.
+    Cpu *next = nullptr;
+    if (!scheduler->IsEmpty()) {
+        for (unsigned i = 0; i < numCpus; i++) {
+            if (cpus[i].thread == nullptr) {
+                next = &cpus[i];
+                break;
+            }
+        }
+    }
+
+    // Otherwise, the CPU furthest behind goes on, if it is not this one.
+    if (next == nullptr) {
+        unsigned long now = Now();
+        for (unsigned k = 1; k < numCpus; k++) {
+            Cpu *cpu = &cpus[(Index(running) + k) % numCpus];
+            if (cpu->thread != nullptr && cpu->clock < now
+                  && (next == nullptr || cpu->clock < next->clock)) {
+                next = cpu;
+            }
+        }
+    }
+
+    if (next == nullptr) {
+        sliceEnd = stats->totalTicks + CPU_SLICE;
+        return;
+    }
+
+    // Switching CPUs is the kernel's business, like a context switch.  The
+    // thread of a busy CPU resumes here, in user mode, so interrupts need
+    // not be turned off, and turning them back on would cost a tick.
+    interrupt->SetStatus(SYSTEM_MODE);
+    IntStatus oldLevel = interrupt->GetLevel();
+    Thread *thread = next->thread;
+    if (thread == nullptr) {
+        interrupt->SetLevel(INT_OFF);
+        thread = scheduler->FindNextToRun();
+    }
+    SwitchTo(next, thread);
+    // Whoever moved back to this CPU may have had interrupts off.
+    interrupt->SetLevel(oldLevel);
+    interrupt->SetStatus(USER_MODE);
+}
+
+bool
+Multiprocessor::Park()
+{
+    ASSERT(interrupt->GetLevel() == INT_OFF);
+
+    Cpu *next = nullptr;
+    for (unsigned k = 1; k < numCpus; k++) {
+        Cpu *cpu = &cpus[(Index(running) + k) % numCpus];
+        if (cpu->thread != nullptr
+              && (next == nullptr || cpu->clock < next->clock)) {
+            next = cpu;
+        }
+    }
+    if (next == nullptr) {
+        return false;
+    }
+
+    DEBUG('t', "CPU %u goes idle\n", Index(running));
+    LeaveKernel();
+    running->thread = nullptr;
+    SwitchTo(next, next->thread);
+    return true;
+}
+
+void
+Multiprocessor::SwitchTo(Cpu *next, Thread *thread)
+{
+    ASSERT(next != running);
+    ASSERT(thread != nullptr);
+
+    DEBUG('t', "Moving on from CPU %u to CPU %u\n",
+          Index(running), Index(next));
+    Leave();
+    target = next;
+    // The new CPU is selected once the TLB of the old one has been saved.
+    scheduler->Run(thread);
+}
+
+void
+Multiprocessor::Dispatch(Thread *thread)
+{
+    if (target != nullptr) {
+        const Cpu *from = running;
+        bool waking = target->thread == nullptr;
+
+        running = target;
+        target = nullptr;
+        since = stats->totalTicks;
+        idleSince = stats->idleTicks;
+        sliceEnd = since + CPU_SLICE;
+        machine->SelectCpu(Index(running));
+        switches++;
+
+        if (waking) {
+            // Woken up by an inter-processor interrupt, into the kernel.
+            if (running->clock < from->clock) {
+                running->clock = from->clock;
+            }
+            running->clock += IPI_TICKS;
+            running->ipisReceived++;
+            EnterKernel();
+        }
+    }
+    running->thread = thread;
+}
+
+void
+Multiprocessor::Kick()
+{
+    for (unsigned i = 0; i < numCpus; i++) {
+        if (cpus[i].thread == nullptr) {
+            kicked = true;
+            return;
+        }
+    }
+}
+
+bool
+Multiprocessor::EnterKernel()
+{
+    if (lockHolder == running) {
+        return false;
+    }
+    ASSERT(lockHolder == nullptr);
+
+    // Spin while some other CPU held the lock at this moment.
+    unsigned long now = Now();
+    for (bool waited = true; waited;) {
+        waited = false;
+        for (unsigned i = 0; i < numCpus; i++) {
+            Cpu *cpu = &cpus[i];
+            if (cpu != running && cpu->lockedFrom <= now
+                  && now < cpu->lockedUntil) {
+                unsigned long wait = cpu->lockedUntil - now;
+                running->clock += wait;
+                running->lockWaitTicks += wait;
+                now += wait;
+                waited = true;
+            }
+        }
+    }
+
+    lockHolder = running;
+    running->lockedFrom = now;
+    return true;
+}
+
+void
+Multiprocessor::LeaveKernel()
+{
+    if (lockHolder != running) {
+        return;
+    }
+    lockHolder = nullptr;
+    running->lockedUntil = Now();
+}
+
+bool
+Multiprocessor::ClaimTlb(AddressSpace *space)
+{
+    if (running->tlbSpace == space) {
+        return false;
+    }
+    running->tlbSpace = space;
+    return true;
+}
+
+void
+Multiprocessor::ShootDown(AddressSpace *space, unsigned vpn)
+{
+    ASSERT(space != nullptr);
+
+    bool sent = false;
+    for (unsigned i = 0; i < numCpus; i++) {
+        Cpu *cpu = &cpus[i];
+        TranslationEntry *tlb = machine->GetTlb(i);
+        if (tlb == nullptr || cpu->tlbSpace != space) {
+            continue;
+        }
+        for (unsigned j = 0; j < TLB_SIZE; j++) {
+            if (tlb[j].valid && tlb[j].virtualPage == vpn) {
+                space->UpdateFromTlb(&tlb[j]);
+                tlb[j].valid = false;
+            }
+        }
+        if (cpu != running) {
+            cpu->clock += IPI_TICKS;
+            cpu->ipisReceived++;
+            sent = true;
+        }
+    }
+
+    // The sender waits for every CPU to acknowledge.
+    if (sent) {
+        running->clock += IPI_TICKS;
+        running->shootdowns++;
+    }
+}
+
+void
+Multiprocessor::Forget(AddressSpace *space)
+{
+    for (unsigned i = 0; i < numCpus; i++) {
+        if (cpus[i].tlbSpace != space) {
+            continue;
+        }
+        TranslationEntry *tlb = machine->GetTlb(i);
+        for (unsigned j = 0; tlb != nullptr && j < TLB_SIZE; j++) {
+            tlb[j].valid = false;
+        }
+        cpus[i].tlbSpace = nullptr;
+    }
+}
+
+void
+Multiprocessor::Print() const
+{
+    unsigned long elapsed = 0;
+    unsigned long busyTotal = 0;
+
+    printf("Multiprocessor model: %u CPUs simulated one at a time, switched"
+           " between %lu times\n", numCpus, switches);
+    for (unsigned i = 0; i < numCpus; i++) {
+        const Cpu *cpu = &cpus[i];
+        unsigned long clock = cpu->clock;
+        unsigned long busy = cpu->busyTicks;
+        if (cpu == running) {
+            clock = Now();
+            busy += stats->totalTicks - since
+                    - (stats->idleTicks - idleSince);
+        }
+        printf("CPU %u: clock %lu, busy %lu, lock wait %lu, IPIs received"
+               " %lu, shootdowns %lu\n", i, clock, busy, cpu->lockWaitTicks,
+               cpu->ipisReceived, cpu->shootdowns);
+        if (clock > elapsed) {
+            elapsed = clock;
+        }
+        busyTotal += busy;
+    }
+    printf("Estimated elapsed ticks %lu, against %lu on one CPU; %.2f CPUs"
+           " busy on average\n", elapsed, stats->totalTicks,
+           elapsed == 0 ? 0.0 : (double) busyTotal / elapsed);
+}
@@ -0,0 +1,163 @@
+/// A cost model of a multiprocessor, to estimate how the kernel would scale.
+///
+/// With `-smp-model <cpus>`, the machine has several MIPS CPUs sharing main
+/// memory.  Each of them runs a thread of its own, with its own registers
+/// (kept in the thread while another CPU is simulated) and its own TLB.
+/// `currentThread` is always the thread of the CPU being simulated.
+///
+/// This is a timing model, not a parallel kernel: its figures are estimates,
+/// not measurements of SMP execution.  The CPUs are simulated one at a time,
+/// on the only host thread, so runs stay repeatable and the kernel needs no
+/// host-level locking; turning interrupts off still is what gives it mutual
+/// exclusion.  What the model gives is how long a workload would take on so
+/// many CPUs, and how much of that time goes to waiting for the kernel.
+///
+/// Each CPU has a virtual clock, advanced by the ticks that pass while it
+/// is simulated; the machine moves on to the CPU that is furthest behind
+/// every `CPU_SLICE` ticks of user code, so that the CPUs advance together.
+/// `stats->totalTicks` keeps counting the ticks of all of them one after
+/// the other, while devices are scheduled against the virtual clock of the
+/// CPU being simulated (see `Interrupt::Schedule`), so that a disk request
+/// takes as long as it would on the multiprocessor.  The time the workload
+/// would take there is that of the clock furthest ahead.
+///
+/// The kernel was written for a uniprocessor, so it runs under a big kernel
+/// lock: the machine only moves on to another CPU while the simulated one
+/// runs user code, or when it goes idle, so kernel code never interleaves.
+/// The lock accounts for what that costs.  A CPU takes it when it traps or
+/// is interrupted out of user mode and releases it when it returns there;
+/// if another CPU held the lock at that moment of virtual time, the CPU
+/// spins until it is free, and the wait is charged to it.
+///
+/// CPUs with nothing to run go idle.  A thread made ready wakes one of
+/// them up with an inter-processor interrupt.  Changing a translation
+/// shoots it down from the TLB of every CPU that may cache it, with an
+/// inter-processor interrupt to each of them; in return, a TLB is not
+/// flushed when its CPU goes back to the address space it last ran.
+
+#ifndef NACHOS_USERPROG_MULTIPROCESSOR__HH
+#define NACHOS_USERPROG_MULTIPROCESSOR__HH
+
+
+class AddressSpace;
+class Thread;
+
+
+/// Most CPUs that can be simulated.
+const unsigned MAX_CPUS = 16;
+
+/// Ticks of user code that a CPU runs before the machine moves on to
+/// another one.
+const unsigned CPU_SLICE = 50;
+
+/// Ticks taken to deliver an inter-processor interrupt and handle it.
+const unsigned IPI_TICKS = 5;
+
+/// State and statistics of one CPU.
+struct Cpu {
+    Thread *thread;               ///< Null while the CPU is idle.
+    unsigned long clock;          ///< Virtual time, as of when the machine
+                                  ///< last moved on from this CPU.
+    AddressSpace *tlbSpace;       ///< Space whose translations the TLB may
+                                  ///< hold, if any.
+
+    /// Virtual time when the CPU last took and released the kernel lock.
+    unsigned long lockedFrom;
+    unsigned long lockedUntil;
+
+    unsigned long busyTicks;      ///< Time spent running threads.
+    unsigned long lockWaitTicks;  ///< Time spent spinning on the kernel
+                                  ///< lock.
+    unsigned long ipisReceived;
+    unsigned long shootdowns;     ///< TLB shootdowns started.
+};
+
+class Multiprocessor {
+public:
+
+    /// Simulate `numCpus` CPUs; the running thread is on the first one.
+    Multiprocessor(unsigned numCpus);
+
+    ~Multiprocessor();
+
+    /// Whether the machine should move on to another CPU, as checked
+    /// between user instructions.
+    bool SwitchDue() const;
+
+    /// Move on to the CPU that is furthest behind, or to an idle one if a
+    /// thread is ready.  Returns when this CPU is simulated again.
+    void Switch();
+
+    /// Leave the running CPU idle, as its thread blocks with nothing else
+    /// ready, and move on to another CPU.
+    ///
+    /// Return false if every other CPU is idle too; otherwise, return once
+    /// the blocked thread has been dispatched again, on any CPU.
+    bool Park();
+
+    /// Called by the scheduler as `thread` is about to run, on the CPU the
+    /// machine is moving on to, if any, or else on the running one.
+    void Dispatch(Thread *thread);
+
+    /// A thread has been made ready: wake up an idle CPU, if any.
+    void Kick();
+
+    /// Take the big kernel lock on behalf of the running CPU.  Return false
+    /// if it already holds it.
+    bool EnterKernel();
+
+    /// Release the kernel lock, if the running CPU holds it.
+    void LeaveKernel();
+
+    /// Make the running CPU's TLB cache translations of `space`.  Return
+    /// false if it already does, so that it needs no flush.
+    bool ClaimTlb(AddressSpace *space);
+
+    /// Remove page `vpn` of `space` from every TLB, merging its use and
+    /// dirty bits back into `space`.
+    void ShootDown(AddressSpace *space, unsigned vpn);
+
+    /// `space` is being deleted.
+    void Forget(AddressSpace *space);
+
+    /// Print the statistics of every CPU.
+    void Print() const;
+
+    /// Virtual time of the running CPU.  Devices are scheduled against it.
+    unsigned long Now() const;
+
+private:
+
+    /// Account for the time spent in the running CPU until now.
+    void Leave();
+
+    /// Go on with `thread` on CPU `next`.
+    void SwitchTo(Cpu *next, Thread *thread);
+
+    unsigned Index(const Cpu *cpu) const;
+
+    Cpu *cpus;
+    unsigned numCpus;
+    Cpu *running;
+
+    /// CPU being switched to, until its thread is dispatched.
+    Cpu *target;
+
+    /// Values of `stats->totalTicks` and `stats->idleTicks` when the
+    /// running CPU started to be simulated.
+    unsigned long since;
+    unsigned long idleSince;
+
+    /// When the running CPU has had its slice.
+    unsigned long sliceEnd;
+
+    /// Whether an idle CPU has been sent a wake-up.
+    bool kicked;
+
+    Cpu *lockHolder;  ///< Null if the kernel lock is free.
+
+    unsigned long switches;
+};
+
+
+#endif
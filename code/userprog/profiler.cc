@@ -0,0 +1,320 @@
+#include "profiler.hh"
+#include "address_space.hh"
+#include "executable.hh"
+#include "machine/endianness.hh"
+#include "machine/instruction.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Instructions listed in a flat profile by address, when there are no
+/// symbols.
+static const unsigned HOTTEST_INSTRUCTIONS = 10;
+
+Profiler::Profiler(unsigned interval_)
+{
+    ASSERT(interval_ > 0);
+
+    interval = interval_;
+    untilSample = interval;
+    samples = 0;
+    lost = 0;
+    programs = nullptr;
+}
+
+Profiler::~Profiler()
+{
+    while (programs != nullptr) {
+        ProgramProfile *p = programs;
+        programs = p->next;
+        for (unsigned i = 0; i < p->numSymbols; i++) {
+            delete [] p->symbols[i].name;
+        }
+        delete [] p->symbols;
+        delete [] p->counts;
+        delete [] p->code;
+        delete [] p->name;
+        delete p;
+    }
+}
+
+void
+Profiler::Attach(AddressSpace *space, const char *name, OpenFile *executable)
+{
+    ASSERT(space != nullptr);
+    ASSERT(name != nullptr);
+    ASSERT(executable != nullptr);
+
+    for (ProgramProfile *p = programs; p != nullptr; p = p->next) {
+        if (strcmp(p->name, name) == 0) {
+            space->profile = p;
+            return;
+        }
+    }
+
+    Executable exe (executable);
+    ASSERT(exe.CheckMagic());
+
+    ProgramProfile *p = new ProgramProfile;
+    p->name = new char [strlen(name) + 1];
+    strcpy(p->name, name);
+    p->codeAddr = exe.GetCodeAddr();
+    p->codeSize = exe.GetCodeSize() / 4 * 4;
+    unsigned words = p->codeSize / 4;
+    p->code = new unsigned [words];
+    exe.ReadCodeBlock((char *) p->code, p->codeSize, 0);
+    p->counts = new unsigned long [words];
+    memset(p->counts, 0, words * sizeof *p->counts);
+    p->samples = 0;
+    LoadSymbols(p);
+
+    p->next = programs;
+    programs = p;
+    space->profile = p;
+}
+
+void
+Profiler::Sample(unsigned pc, unsigned count)
+{
+    const AddressSpace *space = currentThread->space;
+    ProgramProfile *p = space != nullptr ? space->profile : nullptr;
+
+    unsigned i = untilSample - 1;
+    for (; i < count; i += interval) {
+        samples++;
+        if (p == nullptr) {
+            lost++;
+            continue;
+        }
+        p->samples++;
+        unsigned offset = pc + 4 * i - p->codeAddr;
+        if (offset < p->codeSize) {
+            p->counts[offset / 4]++;
+        }
+    }
+    untilSample = i - count + 1;
+}
+
+/// Read the symbols of `p` from its `.sym` file, if there is one.
+void
+Profiler::LoadSymbols(ProgramProfile *p)
+{
+    ASSERT(p != nullptr);
+
+    p->symbols = nullptr;
+    p->numSymbols = 0;
+
+    char *fileName = new char [strlen(p->name) + 5];
+    sprintf(fileName, "%s.sym", p->name);
+    FILE *f = fopen(fileName, "r");
+    delete [] fileName;
+    if (f == nullptr) {
+        return;
+    }
+
+    unsigned capacity = 0;
+    unsigned addr;
+    char name[256];
+    while (fscanf(f, "%x %255s", &addr, name) == 2) {
+        if (p->numSymbols == capacity) {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            ProgramProfile::Symbol *s = new ProgramProfile::Symbol [capacity];
+            memcpy(s, p->symbols, p->numSymbols * sizeof *s);
+            delete [] p->symbols;
+            p->symbols = s;
+        }
+        // Keep them sorted; `coffsyms` already writes them in order.
+        unsigned j = p->numSymbols++;
+        for (; j > 0 && p->symbols[j - 1].addr > addr; j--) {
+            p->symbols[j] = p->symbols[j - 1];
+        }
+        p->symbols[j].addr = addr;
+        p->symbols[j].name = new char [strlen(name) + 1];
+        strcpy(p->symbols[j].name, name);
+    }
+    fclose(f);
+}
+
+/// A line of a flat profile.
+struct Entry {
+    unsigned long samples;
+    unsigned index;
+};
+
+static int
+CompareEntries(const void *a, const void *b)
+{
+    const Entry *x = (const Entry *) a;
+    const Entry *y = (const Entry *) b;
+    if (x->samples != y->samples) {
+        return x->samples < y->samples ? 1 : -1;
+    }
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static double
+Percent(unsigned long part, unsigned long whole)
+{
+    return whole == 0 ? 0 : 100.0 * part / whole;
+}
+
+void
+Profiler::Print() const
+{
+    printf("Profile: one sample every %u user instructions, %lu samples",
+           interval, samples);
+    if (lost > 0) {
+        printf(", %lu with no program", lost);
+    }
+    printf(".\n");
+
+    for (const ProgramProfile *p = programs; p != nullptr; p = p->next) {
+        PrintProgram(p);
+    }
+    printf("\n");
+}
+
+void
+Profiler::PrintProgram(const ProgramProfile *p) const
+{
+    ASSERT(p != nullptr);
+
+    printf("\nProgram %s: %lu samples\n", p->name, p->samples);
+    if (p->samples == 0) {
+        return;
+    }
+
+    unsigned words = p->codeSize / 4;
+    unsigned long outside = p->samples;
+    for (unsigned i = 0; i < words; i++) {
+        outside -= p->counts[i];
+    }
+
+    if (p->numSymbols == 0) {
+        // No functions to speak of: list the hottest instructions, and
+        // then every instruction sampled.
+        Entry *entries = new Entry [words];
+        for (unsigned i = 0; i < words; i++) {
+            entries[i] = { p->counts[i], i };
+        }
+        qsort(entries, words, sizeof *entries, CompareEntries);
+        printf("\n%10s %6s  %s\n", "samples", "%", "address");
+        for (unsigned i = 0; i < words && i < HOTTEST_INSTRUCTIONS; i++) {
+            if (entries[i].samples == 0) {
+                break;
+            }
+            printf("%10lu %6.2f  0x%X\n", entries[i].samples,
+                   Percent(entries[i].samples, p->samples),
+                   p->codeAddr + 4 * entries[i].index);
+        }
+        if (outside > 0) {
+            printf("%10lu %6.2f  (outside the code)\n",
+                   outside, Percent(outside, p->samples));
+        }
+        delete [] entries;
+
+        printf("\nSampled instructions (no symbols in %s.sym):\n", p->name);
+        Annotate(p, 0, words, true);
+        return;
+    }
+
+    // Function `i` runs up to the start of the next one.  Code before the
+    // first symbol, if any, goes under index `numSymbols`.
+    unsigned n = p->numSymbols + 1;
+    Entry *entries = new Entry [n];
+    for (unsigned i = 0; i < n; i++) {
+        entries[i] = { 0, i };
+    }
+    unsigned f = p->numSymbols, next = 0;
+    for (unsigned i = 0; i < words; i++) {
+        unsigned addr = p->codeAddr + 4 * i;
+        while (next < p->numSymbols && p->symbols[next].addr <= addr) {
+            f = next++;
+        }
+        entries[f].samples += p->counts[i];
+    }
+    qsort(entries, n, sizeof *entries, CompareEntries);
+
+    printf("\n%10s %6s  %s\n", "samples", "%", "function");
+    for (unsigned i = 0; i < n && entries[i].samples > 0; i++) {
+        unsigned s = entries[i].index;
+        printf("%10lu %6.2f  %s\n", entries[i].samples,
+               Percent(entries[i].samples, p->samples),
+               s == p->numSymbols ? "(before any symbol)"
+                                  : p->symbols[s].name);
+    }
+    if (outside > 0) {
+        printf("%10lu %6.2f  (outside the code)\n",
+               outside, Percent(outside, p->samples));
+    }
+
+    for (unsigned i = 0; i < n && entries[i].samples > 0; i++) {
+        if (Percent(entries[i].samples, p->samples)
+              < PROFILE_ANNOTATE_THRESHOLD) {
+            break;
+        }
+        unsigned s = entries[i].index;
+        unsigned start, end;
+        if (s == p->numSymbols) {
+            start = p->codeAddr;
+            end = p->symbols[0].addr;
+        } else {
+            start = p->symbols[s].addr;
+            end = s + 1 < p->numSymbols ? p->symbols[s + 1].addr
+                                        : p->codeAddr + p->codeSize;
+        }
+        if (start < p->codeAddr) {
+            start = p->codeAddr;
+        }
+        if (end > p->codeAddr + p->codeSize) {
+            end = p->codeAddr + p->codeSize;
+        }
+        printf("\n%s:\n", s == p->numSymbols ? "(before any symbol)"
+                                             : p->symbols[s].name);
+        Annotate(p, (start - p->codeAddr) / 4, (end - p->codeAddr) / 4,
+                 false);
+    }
+    delete [] entries;
+}
+
+void
+Profiler::Annotate(const ProgramProfile *p, unsigned start, unsigned end,
+                   bool hitsOnly) const
+{
+    ASSERT(p != nullptr);
+
+    bool skipped = false;
+    for (unsigned i = start; i < end; i++) {
+        if (hitsOnly && p->counts[i] == 0) {
+            skipped = true;
+            continue;
+        }
+        if (skipped) {
+            printf("%10s\n", "...");
+            skipped = false;
+        }
+
+        Instruction instr;
+        instr.value = WordToHost(p->code[i]);
+        instr.Decode();
+        ASSERT(instr.opCode <= MAX_OPCODE);
+        const struct OpString *str = &OP_STRINGS[instr.opCode];
+        char text[64];
+        snprintf(text, sizeof text, str->string,
+                 instr.RegFromType(str->args[0]),
+                 instr.RegFromType(str->args[1]),
+                 instr.RegFromType(str->args[2]));
+
+        if (p->counts[i] == 0) {
+            printf("%10s %6s  0x%06X:  %s\n", "", "",
+                   p->codeAddr + 4 * i, text);
+        } else {
+            printf("%10lu %6.2f  0x%06X:  %s\n", p->counts[i],
+                   Percent(p->counts[i], p->samples),
+                   p->codeAddr + 4 * i, text);
+        }
+    }
+}
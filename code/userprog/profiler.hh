@@ -0,0 +1,103 @@
+/// A sampling profiler for user programs.
+///
+/// With `-prof`, the machine reports every run of user instructions to the
+/// profiler, which takes the program counter of one instruction every
+/// `interval` of them and charges it to the program of the running thread.
+/// An interval of 1 counts every instruction exactly.
+///
+/// Samples are kept per program, by name, so that every run of the same
+/// executable adds up to one profile.  At exit, a flat profile and the
+/// annotated disassembly of the hottest code are printed for each of them.
+///
+/// NOFF files have no symbols.  If there is a UNIX file named like the
+/// executable plus `.sym`, its lines of the form `<hex address> <name>`
+/// (as written by `bin/coffsyms` from the COFF file) name the functions
+/// starting at each address; otherwise samples are only shown by address.
+
+#ifndef NACHOS_USERPROG_PROFILER__HH
+#define NACHOS_USERPROG_PROFILER__HH
+
+
+#include "filesys/open_file.hh"
+
+
+/// User instructions between two samples, by default.
+const unsigned DEFAULT_PROFILE_INTERVAL = 100;
+
+/// Functions with at least this share of the samples of a program, in
+/// percent, get their disassembly printed.
+const unsigned PROFILE_ANNOTATE_THRESHOLD = 5;
+
+class AddressSpace;
+
+/// Samples of one program.
+struct ProgramProfile {
+    char *name;
+    unsigned codeAddr;
+    unsigned codeSize;
+    unsigned *code;           ///< Copy of the code, to disassemble it.
+    unsigned long *counts;    ///< Samples of each instruction of the code.
+    unsigned long samples;    ///< All samples, also from outside the code.
+
+    struct Symbol {
+        unsigned addr;
+        char *name;
+    } *symbols;               ///< Sorted by address.
+    unsigned numSymbols;
+
+    ProgramProfile *next;
+};
+
+class Profiler {
+public:
+
+    /// Sample one every `interval` user instructions.
+    Profiler(unsigned interval);
+
+    ~Profiler();
+
+    /// Charge the samples taken while running `space` to program `name`,
+    /// loaded from `executable`.
+    void Attach(AddressSpace *space, const char *name, OpenFile *executable);
+
+    /// Account for `count` instructions run one after the other, starting
+    /// at `pc`.
+    void Count(unsigned pc, unsigned count);
+
+    /// Print the profile of every program.
+    void Print() const;
+
+private:
+
+    /// Take the samples falling within a run of `count` instructions from
+    /// `pc`; the first one is the instruction at index `untilSample - 1`.
+    void Sample(unsigned pc, unsigned count);
+
+    void PrintProgram(const ProgramProfile *p) const;
+
+    /// Print the instructions from `start` to `end` (not included) with
+    /// their samples; with `hitsOnly`, just those that have any.
+    void Annotate(const ProgramProfile *p, unsigned start, unsigned end,
+                  bool hitsOnly) const;
+
+    static void LoadSymbols(ProgramProfile *p);
+
+    unsigned interval;
+    unsigned untilSample;    ///< Instructions left until the next sample.
+    unsigned long samples;   ///< All samples taken.
+    unsigned long lost;      ///< Samples with no program to charge.
+    ProgramProfile *programs;
+};
+
+inline void
+Profiler::Count(unsigned pc, unsigned count)
+{
+    if (count < untilSample) {
+        untilSample -= count;
+    } else {
+        Sample(pc, count);
+    }
+}
+
+
+#endif
@@ -31,8 +31,11 @@ void
         return;
     }
 
-    AddressSpace *space = new AddressSpace(executable, currentThread->pid);
+    AddressSpace *space = new AddressSpace(executable, filename);
     currentThread->space = space;
+    if (profiler != nullptr) {
+        profiler->Attach(space, filename, executable);
+    }
 
     space->InitRegisters();  // Set the initial register values.
     space->RestoreState();   // Load page table register.    
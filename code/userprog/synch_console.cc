@@ -1,5 +1,7 @@
 #include "synch_console.hh"
 
+#include <string.h>
+
 
 /// Dummy functions because C++ is weird about pointers to member functions.
 static void
@@ -18,13 +20,26 @@ WriteDoneDummy(void *arg)
     console->WriteDone();
 }
 
-SynchConsole::SynchConsole(const char *name)
+SynchConsole::SynchConsole(const char *name, unsigned batchSize_)
 {
     console = new Console(nullptr, nullptr, ReadAvailDummy, WriteDoneDummy, this);
     readAvail = new Semaphore("Read avail synch console", 0);
     writeDone = new Semaphore("Write done synch console", 0);
     readLock = new Lock("Reading synch console lock");
     writeLock = new Lock("Writing synch console lock");
+
+    ASSERT(batchSize_ <= MAX_CONSOLE_BATCH_SIZE);
+
+    batchSize = batchSize_;
+    pending = inFlight = nullptr;
+    if (batchSize > 0) {
+        pending = new char [batchSize];
+        inFlight = new char [batchSize];
+    }
+    pendingSize = 0;
+    queued = written = 0;
+    flushing = false;
+    flushed = new Condition("Synch console flushed", writeLock);
 }
 
 SynchConsole::~SynchConsole()
@@ -33,7 +48,10 @@ SynchConsole::~SynchConsole()
     delete readAvail;
     delete writeDone;
     delete readLock;
+    delete flushed;
     delete writeLock;
+    delete [] pending;
+    delete [] inFlight;
 }
 
 void
@@ -48,6 +66,11 @@ SynchConsole::ReadChar(char *c)
 void
 SynchConsole::WriteChar(const char *c)
 {
+    if (batchSize > 0) {
+        char ch = *c;
+        WriteBuffer(&ch, 1);
+        return;
+    }
     writeLock->Acquire();
     console->PutChar(*c);
     writeDone->P();
@@ -70,14 +93,72 @@ void
 SynchConsole::WriteBuffer(char *buffer, unsigned size) 
 {
     writeLock->Acquire();
-    for (unsigned i = 0; i < size; i++)
-    {
-        console->PutChar(buffer[i]);
-        writeDone->P();
+    if (batchSize == 0) {
+        for (unsigned i = 0; i < size; i++)
+        {
+            console->PutChar(buffer[i]);
+            writeDone->P();
+        }
+        writeLock->Release();
+        return;
+    }
+
+    for (unsigned done = 0; done < size; ) {
+        unsigned room = batchSize - pendingSize;
+        if (room == 0) {
+            // Someone else is putting a batch; theirs ends with ours.
+            if (flushing) {
+                flushed->Wait();
+            } else {
+                Flush();
+            }
+            continue;
+        }
+        unsigned count = size - done < room ? size - done : room;
+        memcpy(&pending[pendingSize], &buffer[done], count);
+        pendingSize += count;
+        queued += count;
+        done += count;
+    }
+
+    // Wait until our last character is out.
+    unsigned long end = queued;
+    while (written < end) {
+        if (flushing) {
+            flushed->Wait();
+        } else {
+            Flush();
+        }
     }
     writeLock->Release();
 }
 
+void
+SynchConsole::Flush()
+{
+    ASSERT(writeLock->IsHeldByCurrentThread());
+    ASSERT(!flushing);
+
+    flushing = true;
+    while (pendingSize > 0) {
+        char *batch = pending;
+        unsigned count = pendingSize;
+        pending = inFlight;
+        inFlight = batch;
+        pendingSize = 0;
+
+        // Let other writers fill the next batch meanwhile.
+        writeLock->Release();
+        console->PutBuffer(batch, count);
+        writeDone->P();
+        writeLock->Acquire();
+
+        written += count;
+        flushed->Broadcast();
+    }
+    flushing = false;
+}
+
 void
 SynchConsole::ReadAvail()
 {
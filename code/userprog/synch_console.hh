@@ -2,13 +2,25 @@
 #define NACHOS_FILESYS_SYNCHCONSOLE__HH
 
 #include "machine/console.hh"
+#include "threads/condition.hh"
 #include "threads/lock.hh"
 #include "threads/semaphore.hh"
 
+
+/// Default size of the batches in which output is sent to the console.
+const unsigned DEFAULT_CONSOLE_BATCH_SIZE = 256;
+
+/// Largest batch size accepted.  Two buffers of this size are kept.
+const unsigned MAX_CONSOLE_BATCH_SIZE = 64 * 1024;
+
 class SynchConsole {
 public:
 
-  SynchConsole(const char *name);
+  /// With a `batchSize` of 0, characters are put on the console one at a
+  /// time.  Otherwise, output from every thread is gathered into batches of
+  /// up to `batchSize` characters, each put with a single device request:
+  /// while one batch is being put, writers append to the next one.
+  SynchConsole(const char *name, unsigned batchSize = 0);
 
   ~SynchConsole();
 
@@ -34,7 +46,22 @@ private:
   Semaphore *writeDone;
   Lock *readLock;  
   Lock *writeLock;
-  
+
+  /// Batched output.  `pending` holds the characters not yet handed to the
+  /// device, `inFlight` the batch being put.  Counters tell writers when
+  /// their characters are out.
+  unsigned batchSize;
+  char *pending;
+  char *inFlight;
+  unsigned pendingSize;
+  unsigned long queued;
+  unsigned long written;
+  bool flushing;
+  Condition *flushed;
+
+  /// Put pending batches until there are none left.  Called with
+  /// `writeLock` held, by the writer that finds the device idle.
+  void Flush();
 };
 
 #endif
\ No newline at end of file
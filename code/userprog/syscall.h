@@ -32,6 +32,9 @@
 #define SC_READ    14
 #define SC_WRITE   15
 #define SC_PS      16
+#define SC_MMAP    17
+#define SC_MUNMAP  18
+#define SC_SBRK    19
 
 
 #ifndef IN_ASM
@@ -125,6 +128,28 @@ int Close(OpenFileId id);
 
 void Ps();
 
+/// Map `size` bytes of the open file `id`, starting at byte `offset`, into
+/// the address space.  If `size` is not positive, or goes past the end of
+/// the file, everything up to the end of the file is mapped.
+///
+/// Pages are read from the file as they are touched, and modified ones are
+/// written back when evicted or unmapped, so no copying system call is
+/// needed.  A mapped file cannot be closed until it is unmapped; mappings
+/// still in place when the program exits are unmapped then.
+///
+/// Return the address of the mapping, or 0 on error.
+void *Mmap(OpenFileId id, int offset, int size);
+
+/// Remove the mapping that starts at `addr`, writing back modified pages.
+int Munmap(void *addr);
+
+/// Move the end of the heap by `increment` bytes, which may be negative.
+///
+/// New heap memory reads as zeroes, and only takes up memory once written.
+/// The heap can grow up to 1 MiB.  Return the previous end of the heap, or
+/// `(void *) -1` on error.
+void *Sbrk(int increment);
+
 #endif
 
 
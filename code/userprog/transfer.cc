@@ -7,12 +7,42 @@
 #include "lib/utility.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
 #ifdef USE_TLB
 static const int MAX_MEM_TRIES = 4;
 #else
 static const int MAX_MEM_TRIES = 1;
 #endif
 
+/// Return where the byte at `userAddress` lives in main memory.
+///
+/// Faults are handled by the usual exception handlers and the translation
+/// is retried, as for any other access.  The rest of the page can then be
+/// accessed directly, without translating every byte.
+static char *
+TranslateUserAddress(unsigned userAddress, bool writing)
+{
+    unsigned physAddr;
+    int tries = 0;
+    for (; tries < MAX_MEM_TRIES
+             && !machine->Translate(userAddress, &physAddr, writing);
+         tries++) {}
+    if (tries == MAX_MEM_TRIES) {
+        ASSERT(false);
+    }
+    return &machine->GetMMU()->mainMemory[physAddr];
+}
+
+/// Number of bytes from `userAddress` to the end of its page, up to
+/// `count`.
+static unsigned
+SpanInPage(unsigned userAddress, unsigned count)
+{
+    unsigned left = PAGE_SIZE - userAddress % PAGE_SIZE;
+    return count < left ? count : left;
+}
+
 void ReadBufferFromUser(int userAddress, char *outBuffer,
                         unsigned byteCount)
 {
@@ -20,20 +50,13 @@ void ReadBufferFromUser(int userAddress, char *outBuffer,
     ASSERT(outBuffer != nullptr);
     ASSERT(byteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        count++;
-        int tries = 0;
-        for (; tries < MAX_MEM_TRIES && !machine->ReadMem(userAddress, 1, &temp); tries++){};
-        if (tries == MAX_MEM_TRIES) {
-            ASSERT(false);
-        }
-        userAddress++;
-        *outBuffer = (unsigned char) temp;
-        outBuffer++;
-    } while (count < byteCount);
-
+    while (byteCount > 0) {
+        unsigned span = SpanInPage(userAddress, byteCount);
+        memcpy(outBuffer, TranslateUserAddress(userAddress, false), span);
+        userAddress += span;
+        outBuffer += span;
+        byteCount -= span;
+    }
 }
 
 bool ReadStringFromUser(int userAddress, char *outString,
@@ -43,20 +66,21 @@ bool ReadStringFromUser(int userAddress, char *outString,
     ASSERT(outString != nullptr);
     ASSERT(maxByteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        count++;
-        int tries = 0;
-        for (; tries < MAX_MEM_TRIES && !machine->ReadMem(userAddress, 1, &temp); tries++){};
-        if (tries == MAX_MEM_TRIES) {
-            ASSERT(false);
+    while (maxByteCount > 0) {
+        unsigned span = SpanInPage(userAddress, maxByteCount);
+        const char *from = TranslateUserAddress(userAddress, false);
+        const char *end = (const char *) memchr(from, '\0', span);
+        if (end != nullptr) {
+            memcpy(outString, from, end - from + 1);
+            return true;
         }
-        userAddress++;
-        *outString = (unsigned char) temp;
-    } while (*outString++ != '\0' && count < maxByteCount);
+        memcpy(outString, from, span);
+        userAddress += span;
+        outString += span;
+        maxByteCount -= span;
+    }
 
-    return *(outString - 1) == '\0';
+    return false;
 }
 
 void WriteBufferToUser(const char *buffer, int userAddress,
@@ -66,16 +90,13 @@ void WriteBufferToUser(const char *buffer, int userAddress,
     ASSERT(userAddress != 0);
     ASSERT(byteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp = (int) buffer[count++];
-        int tries = 0;
-        for (; tries < MAX_MEM_TRIES && !machine->WriteMem(userAddress, 1, temp); tries++){};
-        if (tries == MAX_MEM_TRIES) {
-            ASSERT(false);
-        }
-        userAddress++;
-    } while (count < byteCount);
+    while (byteCount > 0) {
+        unsigned span = SpanInPage(userAddress, byteCount);
+        memcpy(TranslateUserAddress(userAddress, true), buffer, span);
+        userAddress += span;
+        buffer += span;
+        byteCount -= span;
+    }
 }
 
 void WriteStringToUser(const char *string, int userAddress)
@@ -83,13 +104,5 @@ void WriteStringToUser(const char *string, int userAddress)
     ASSERT(string != nullptr);
     ASSERT(userAddress != 0);
 
-    do {
-        int temp = (int) *string;
-        int tries = 0;
-        for (; tries < MAX_MEM_TRIES && !machine->WriteMem(userAddress, 1, temp); tries++){};
-        if (tries == MAX_MEM_TRIES) {
-            ASSERT(false);
-        }
-        userAddress++;
-    } while (*string++ != '\0');
+    WriteBufferToUser(string, userAddress, strlen(string) + 1);
 }
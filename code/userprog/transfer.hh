@@ -7,6 +7,15 @@
 #define NACHOS_USERPROG_TRANSFER__HH
 
 
+/// Default size of the kernel buffer through which `Read` and `Write` move
+/// data, one chunk at a time.
+const unsigned DEFAULT_IO_CHUNK_SIZE = 256;
+
+/// Largest chunk that can be asked for; the buffer is allocated on each
+/// call, so it must stay small.
+const unsigned MAX_IO_CHUNK_SIZE = 64 * 1024;
+
+
 /// Copy a byte array from virtual machine to host.
 void ReadBufferFromUser(int userAddress, char *outBuffer,
                         unsigned byteCount);
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Run some user programs under every page replacement policy and tabulate
+# the paging statistics printed by Nachos when it halts.
+#
+# Usage: ./bench_policies.sh [program...]
+#
+# Must be run from the `vmem` directory, after building both `nachos` and
+# the user programs.  By default `matmult` and `sort` are run.
+
+POLICIES="fifo random clock wsclock aging lru2"
+PROGRAMS=${@:-matmult sort}
+
+if [ ! -x ./nachos ]; then
+    echo "nachos not found; run \`make\` first." >&2
+    exit 1
+fi
+
+printf "%-10s %-8s %10s %10s %10s %12s\n" \
+       program policy faults swap-ins swap-outs ticks
+for prog in $PROGRAMS; do
+    if [ ! -f ../userland/$prog ]; then
+        echo "../userland/$prog not found; skipping." >&2
+        continue
+    fi
+    for policy in $POLICIES; do
+        out=$(./nachos -vm-policy $policy -x ../userland/$prog 2>&1)
+        faults=$(echo "$out"  | sed -n 's/^Paging: .*faults \([0-9]*\).*/\1/p')
+        swapIn=$(echo "$out"  | sed -n 's/^Swap: .*brought \([0-9]*\).*/\1/p')
+        swapOut=$(echo "$out" | sed -n 's/^Swap: pages sent \([0-9]*\).*/\1/p')
+        ticks=$(echo "$out"   | sed -n 's/^Ticks: total \([0-9]*\).*/\1/p')
+        printf "%-10s %-8s %10s %10s %10s %12s\n" \
+               $prog $policy ${faults:--} ${swapIn:--} ${swapOut:--} ${ticks:--}
+    done
+done
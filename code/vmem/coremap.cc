@@ -2,74 +2,277 @@
 
 Coremap::Coremap(unsigned nitems)
 {
-  framesMap = new Bitmap(nitems);
-  addrSpaces = new AddressSpace*[nitems];
-  vpns = new unsigned[nitems];
-  size = nitems; 
+  ASSERT(nitems > 0);
+
+  size = nitems;
+  frames = new FrameInfo[nitems];
+  for (unsigned i = 0; i < NUM_FRAME_LISTS; i++) {
+    heads[i] = tails[i] = -1;
+    counts[i] = 0;
+  }
+
+  for (unsigned i = 0; i < nitems; i++) {
+    frames[i].space = nullptr;
+    frames[i].pinCount = 0;
+    frames[i].released = false;
+    frames[i].use = frames[i].dirty = false;
+    Append(i, FREE_FRAMES);
+  }
+
+  pinLock = new Lock("coremap pin lock");
+  unpinned = new Condition("coremap unpinned", pinLock);
+  numWaiting = 0;
 }
 
 Coremap::~Coremap()
 {
-  delete framesMap;
-  delete [] addrSpaces;
-  delete [] vpns;
+  delete unpinned;
+  delete pinLock;
+  delete [] frames;
+}
+
+void
+Coremap::Append(unsigned frame, FrameList list)
+{
+  FrameInfo *info = &frames[frame];
+
+  info->list = list;
+  info->prev = tails[list];
+  info->next = -1;
+  if (tails[list] == -1) {
+    heads[list] = frame;
+  } else {
+    frames[tails[list]].next = frame;
+  }
+  tails[list] = frame;
+  counts[list]++;
 }
 
 void
-Coremap::Mark(unsigned which, AddressSpace *space, unsigned vpn) 
+Coremap::Unlink(unsigned frame)
 {
-  framesMap->Mark(which);
-  addrSpaces[which] = space;
-  vpns[which] = vpn;
+  FrameInfo *info = &frames[frame];
+  FrameList list = info->list;
+
+  if (info->prev == -1) {
+    heads[list] = info->next;
+  } else {
+    frames[info->prev].next = info->next;
+  }
+  if (info->next == -1) {
+    tails[list] = info->prev;
+  } else {
+    frames[info->next].prev = info->prev;
+  }
+  counts[list]--;
 }
 
 void
-Coremap::Clear(unsigned which) 
+Coremap::Mark(unsigned which, AddressSpace *space, unsigned vpn)
 {
-  framesMap->Clear(which);
-  addrSpaces[which] = nullptr;
+  ASSERT(which < size);
+  ASSERT(space != nullptr);
+
+  FrameInfo *info = &frames[which];
+  if (info->released) {
+    // Taken over before its last pin went away; it is in no list.
+    info->released = false;
+  } else {
+    Unlink(which);
+  }
+  info->space = space;
+  info->vpn = vpn;
+  info->use = info->dirty = false;
+  Append(which, CLEAN_FRAMES);
+}
+
+bool
+Coremap::Clear(unsigned which)
+{
+  ASSERT(which < size);
+
+  FrameInfo *info = &frames[which];
+  if (info->space == nullptr) {
+    return true;
+  }
+  Unlink(which);
+  info->space = nullptr;
+  info->use = info->dirty = false;
+  if (info->pinCount > 0) {
+    // Someone is still writing from it; the last `Unpin` frees it.
+    info->released = true;
+    info->list = NUM_FRAME_LISTS;
+    return false;
+  }
+  Append(which, FREE_FRAMES);
+  return true;
 }
 
 bool
 Coremap::Test(unsigned which) const
 {
-  return framesMap->Test(which) && addrSpaces[which] != nullptr; 
+  ASSERT(which < size);
+  return frames[which].space != nullptr;
 }
 
 int
 Coremap::Find(AddressSpace *space, unsigned vpn)
 {
-  int which = framesMap->Find();
+  int which = heads[FREE_FRAMES];
   if (which != -1) {
-    addrSpaces[which] = space;
-    vpns[which] = vpn;
+    Mark(which, space, vpn);
   }
-  
+
+  return which;
+}
+
+unsigned
+Coremap::Reserve()
+{
+  int which = heads[FREE_FRAMES];
+  ASSERT(which != -1);
+
+  // A reserved frame has no owner, so it is never a victim; being in no
+  // list, it is neither handed out nor cleaned.
+  Unlink(which);
+  frames[which].list = NUM_FRAME_LISTS;
+  frames[which].pinCount = 1;
   return which;
 }
 
 unsigned
 Coremap::CountClear() const
 {
-  return framesMap->CountClear();
+  return counts[FREE_FRAMES];
+}
+
+unsigned
+Coremap::CountClean() const
+{
+  return counts[FREE_FRAMES] + counts[CLEAN_FRAMES];
 }
 
 AddressSpace*
 Coremap::GetAddrSpace(unsigned frame)
 {
-  if (Test(frame)){
-    return addrSpaces[frame];
-  } else {
-    return nullptr;
-  }
+  return Test(frame) ? frames[frame].space : nullptr;
 }
 
 int
 Coremap::GetVpn(unsigned frame)
 {
-  if (Test(frame)){
-    return vpns[frame];
-  } else {
-    return -1;
+  return Test(frame) ? (int) frames[frame].vpn : -1;
+}
+
+void
+Coremap::Pin(unsigned frame)
+{
+  ASSERT(Test(frame));
+  frames[frame].pinCount++;
+}
+
+void
+Coremap::Unpin(unsigned frame)
+{
+  ASSERT(frame < size);
+  ASSERT(frames[frame].pinCount > 0);
+
+  FrameInfo *info = &frames[frame];
+  info->pinCount--;
+  if (info->pinCount > 0) {
+    return;
+  }
+  if (info->released) {
+    info->released = false;
+    Append(frame, FREE_FRAMES);
+  }
+  if (numWaiting > 0) {
+    pinLock->Acquire();
+    unpinned->Broadcast();
+    pinLock->Release();
+  }
+}
+
+void
+Coremap::WaitUnpinned(unsigned frame)
+{
+  ASSERT(frame < size);
+
+  // `Unpin` checks `numWaiting` before taking the lock, so it has to be
+  // counted before the pin count is looked at.
+  pinLock->Acquire();
+  numWaiting++;
+  while (frames[frame].pinCount > 0) {
+    unpinned->Wait();
+  }
+  numWaiting--;
+  pinLock->Release();
+}
+
+bool
+Coremap::IsPinned(unsigned frame) const
+{
+  ASSERT(frame < size);
+  return frames[frame].pinCount > 0;
+}
+
+void
+Coremap::Update(unsigned frame, bool use, bool dirty)
+{
+  ASSERT(Test(frame));
+
+  FrameInfo *info = &frames[frame];
+  info->use = use;
+  if (info->dirty != dirty) {
+    info->dirty = dirty;
+    Unlink(frame);
+    Append(frame, dirty ? DIRTY_FRAMES : CLEAN_FRAMES);
   }
-}
\ No newline at end of file
+}
+
+bool
+Coremap::IsUsed(unsigned frame) const
+{
+  ASSERT(frame < size);
+  return frames[frame].use;
+}
+
+bool
+Coremap::IsDirty(unsigned frame) const
+{
+  ASSERT(frame < size);
+  return frames[frame].dirty;
+}
+
+int
+Coremap::First(FrameList list) const
+{
+  ASSERT(list < NUM_FRAME_LISTS);
+  return heads[list];
+}
+
+int
+Coremap::Next(unsigned frame) const
+{
+  ASSERT(frame < size);
+  ASSERT(frames[frame].list < NUM_FRAME_LISTS);
+  return frames[frame].next;
+}
+
+void
+Coremap::Skip(unsigned frame)
+{
+  ASSERT(frame < size);
+
+  FrameList list = frames[frame].list;
+  ASSERT(list < NUM_FRAME_LISTS);
+  Unlink(frame);
+  Append(frame, list);
+}
+
+unsigned
+Coremap::Count(FrameList list) const
+{
+  ASSERT(list < NUM_FRAME_LISTS);
+  return counts[list];
+}
@@ -1,49 +1,149 @@
+/// Reverse map from physical frames to the virtual pages they hold.
+///
+/// Every frame has a record with its owner, the virtual page it holds, a
+/// pin count and what the kernel last learned of its use and dirty bits.
+/// Frames are kept on one of three lists: free, clean and dirty, so that
+/// allocating a frame, counting clean ones and finding dirty ones take
+/// constant time, whatever the size of physical memory.
+///
+/// The use and dirty summaries are only as fresh as the page tables: they
+/// are updated whenever the bits are copied back from the TLB (see
+/// `AddressSpace::UpdateFromTlb`) and when a page is written back.
+///
+/// A pinned frame is never chosen as a victim nor cleaned.  Frames are
+/// pinned while a page is being read into them or written from them, since
+/// disk I/O may block and let other threads run.  Freeing a pinned frame,
+/// as an address space is deleted under a write, takes it from its owner
+/// at once but leaves it out of every list until the last `Unpin`.
+
 #ifndef NACHOS_LIB_COREMAP__HH
 #define NACHOS_LIB_COREMAP__HH
 
 
 #include "lib/bitmap.hh"
+#include "threads/condition.hh"
 #include "userprog/address_space.hh"
 
+
+enum FrameList {
+    FREE_FRAMES,
+    CLEAN_FRAMES,
+    DIRTY_FRAMES,
+    NUM_FRAME_LISTS
+};
+
+struct FrameInfo {
+    /// Owner of the frame, or null if it is free.
+    AddressSpace *space;
+    unsigned vpn;
+
+    /// Number of operations in progress on the frame.
+    unsigned pinCount;
+
+    /// Freed while pinned: it goes to the free list on the last `Unpin`.
+    bool released;
+
+    bool use;
+    bool dirty;
+
+    /// List the frame is in, and its neighbours there (-1 for none).
+    FrameList list;
+    int prev;
+    int next;
+};
+
 class Coremap {
 public:
 
-    /// Initialize a coremap with `nitems` bits; all bits are cleared.
+    /// Initialize a coremap with `nitems` frames; all frames are free.
     ///
-    /// * `nitems` is the number of items in the bitmap.
+    /// * `nitems` is the number of physical frames.
     Coremap(unsigned nitems);
 
     /// Uninitialize a coremap.
     ~Coremap();
 
-    /// Set the “nth” bit.
+    /// Give frame `which`, already in use or released, to page `vpn` of
+    /// `space`.  The frame starts clean and keeps its pins.
     void Mark(unsigned which, AddressSpace *space, unsigned vpn);
 
-    /// Clear the “nth” bit.
-    void Clear(unsigned which);
+    /// Free frame `which`.  If it is pinned, it is only released: it has
+    /// no owner any more, but is not free until it is unpinned; return
+    /// false then.
+    bool Clear(unsigned which);
 
-    /// Is the “nth” bit set?
+    /// Is frame `which` in use?
     bool Test(unsigned which) const;
 
-    /// Given an address space and a virtual page, finds a physical frame.
-    /// If a frame can't be found it returns -1.
+    /// Given an address space and a virtual page, finds a free physical
+    /// frame.  If a frame can't be found it returns -1.
     int Find(AddressSpace *space, unsigned vpn);
 
-    /// Return the number of clear bits.
+    /// Take a free frame out of the coremap for good, for the kernel's own
+    /// use.  It is never handed out, evicted nor cleaned.
+    unsigned Reserve();
+
+    /// Return the number of free frames.
     unsigned CountClear() const;
 
+    /// Return the number of frames that are free or clean, that is, that
+    /// can be reused without writing anything back.
+    unsigned CountClean() const;
+
     unsigned size;
 
     AddressSpace *GetAddrSpace(unsigned frame);
 
     int GetVpn(unsigned frame);
-    
+
+    /// Pinning can be nested; the frame is unpinned when every `Pin` has
+    /// been matched by an `Unpin`.
+
+    void Pin(unsigned frame);
+    void Unpin(unsigned frame);
+    bool IsPinned(unsigned frame) const;
+
+    /// Block until `frame` is unpinned.
+    void WaitUnpinned(unsigned frame);
+
+    /// Record the use and dirty bits of the page in `frame`, moving it to
+    /// the clean or the dirty list as needed.
+    void Update(unsigned frame, bool use, bool dirty);
+
+    bool IsUsed(unsigned frame) const;
+    bool IsDirty(unsigned frame) const;
+
+    /// Return the frame at the head of `list`, or -1 if it is empty.
+    int First(FrameList list) const;
+
+    /// Return the frame after `frame` in its list, or -1 if it is the last
+    /// one.
+    int Next(unsigned frame) const;
+
+    /// Move `frame` to the tail of its list, so that the next `First`
+    /// returns another one.
+    void Skip(unsigned frame);
+
+    /// Return the number of frames in `list`.
+    unsigned Count(FrameList list) const;
+
 private:
 
-   Bitmap *framesMap;
-   AddressSpace **addrSpaces;
-   unsigned *vpns;
+    void Append(unsigned frame, FrameList list);
+    void Unlink(unsigned frame);
+
+    FrameInfo *frames;
+
+    /// Threads in `WaitUnpinned` wait on `unpinned`.
+    Lock *pinLock;
+    Condition *unpinned;
+    unsigned numWaiting;
+
+    /// Ends and lengths of each list.
+    int heads[NUM_FRAME_LISTS];
+    int tails[NUM_FRAME_LISTS];
+    unsigned counts[NUM_FRAME_LISTS];
 };
 
 
-#endif
\ No newline at end of file
+#endif
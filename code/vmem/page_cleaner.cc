@@ -0,0 +1,127 @@
+#include "page_cleaner.hh"
+#include "threads/semaphore.hh"
+#include "threads/system.hh"
+
+
+#ifdef PAGE_CLEANER
+
+static void
+PageCleanerThread(void *arg)
+{
+    ((PageCleaner *) arg)->Run();
+}
+
+PageCleaner::PageCleaner(unsigned lowWatermark_, unsigned period_)
+{
+    lowWatermark = lowWatermark_;
+    period = period_;
+    ticks = 0;
+    pending = false;
+    stopping = false;
+    wakeUp = new Semaphore("page cleaner", 0);
+    stopped = new Semaphore("page cleaner stopped", 0);
+
+    Thread *t = new Thread("page cleaner", false, 0);
+    // The cleaner is a kernel daemon: it must not count as a running
+    // process, or the machine would never halt after the last `Exit`.
+    runningThreads->Remove(t->pid);
+    t->Fork(PageCleanerThread, this);
+}
+
+PageCleaner::~PageCleaner()
+{
+    delete wakeUp;
+    delete stopped;
+}
+
+void
+PageCleaner::TimerTick()
+{
+    if (++ticks >= period) {
+        ticks = 0;
+        WakeUp();
+    }
+}
+
+bool
+PageCleaner::WantsTicks() const
+{
+    return usedPages->CountClean() < lowWatermark;
+}
+
+void
+PageCleaner::WakeUp()
+{
+    if (!pending) {
+        pending = true;
+        wakeUp->V();
+    }
+}
+
+void
+PageCleaner::Run()
+{
+    while (!stopping) {
+        wakeUp->P();
+        pending = false;
+        if (!stopping) {
+            CleanFrames();
+        }
+    }
+    stopped->V();
+
+    // Sleep without being on any queue, so that timer wake-ups do not
+    // bring the cleaner back.
+    interrupt->SetLevel(INT_OFF);
+    currentThread->Sleep();
+}
+
+void
+PageCleaner::Stop()
+{
+    ASSERT(!stopping);
+
+    stopping = true;
+    wakeUp->V();
+    stopped->P();
+}
+
+void
+PageCleaner::CleanFrames()
+{
+    // The cleaner has no address space, so the user state of whoever ran
+    // before has already been saved by the context switch, and the page
+    // tables and the coremap are up to date.
+    unsigned clean = usedPages->CountClean();
+
+    DEBUG('e', "Page cleaner running, %u clean frames\n", clean);
+
+    // Only the dirty list is looked at.  Frames that cannot be cleaned now
+    // are moved to its tail, and each dirty frame is looked at once.
+    unsigned dirty = usedPages->Count(DIRTY_FRAMES);
+    for (unsigned i = 0; i < dirty && clean < lowWatermark; i++) {
+        int frame = usedPages->First(DIRTY_FRAMES);
+        if (frame == -1) {
+            break;
+        }
+
+        if (usedPages->IsUsed(frame) || usedPages->IsPinned(frame)) {
+            usedPages->Skip(frame);
+            continue;
+        }
+
+        AddressSpace *space = usedPages->GetAddrSpace(frame);
+        unsigned vpn = usedPages->GetVpn(frame);
+        DEBUG('e', "Cleaning frame %u, vpn %u\n", frame, vpn);
+        // The owner may exit while the write blocks; `WriteBack` then lets
+        // go of the frame and the slot itself, so `space` is not looked at
+        // again.
+        if (!space->WriteBack(vpn)) {
+            DEBUG('e', "Swap is full, nothing more can be cleaned\n");
+            break;
+        }
+        stats->numPagesCleaned++;
+        clean++;
+    }
+}
+#endif
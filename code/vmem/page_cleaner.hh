@@ -0,0 +1,81 @@
+/// A kernel daemon that writes dirty pages to swap ahead of demand.
+///
+/// Evicting a dirty page means writing it to swap on the faulting thread,
+/// before the page it is waiting for can even be read.  The cleaner runs
+/// now and then and writes back dirty pages that have not been used
+/// recently, so that there are always some clean frames the replacement
+/// policy can take for free.
+
+#ifndef NACHOS_VMEM_PAGECLEANER__HH
+#define NACHOS_VMEM_PAGECLEANER__HH
+
+
+class Semaphore;
+
+
+/// Number of clean or free frames the cleaner tries to keep available.
+const unsigned PAGE_CLEANER_LOW_WATERMARK = 4;
+
+/// Number of timer interrupts between two periodic runs of the cleaner.
+const unsigned PAGE_CLEANER_PERIOD = 10;
+
+
+class PageCleaner {
+public:
+
+    /// Fork the cleaner thread.
+    ///
+    /// * `lowWatermark` is the number of clean or free frames to keep.
+    /// * `period` is the number of timer interrupts between periodic runs.
+    PageCleaner(unsigned lowWatermark, unsigned period);
+
+    ~PageCleaner();
+
+    /// Called on every timer interrupt; wakes the cleaner up once every
+    /// `period` calls.
+    void TimerTick();
+
+    /// Whether a periodic run could find anything to do, that is, whether
+    /// there are fewer clean frames than wanted.
+    bool WantsTicks() const;
+
+    /// Ask the cleaner to run as soon as it is scheduled.  It is cheap to
+    /// call this repeatedly: requests are merged until the cleaner runs.
+    void WakeUp();
+
+    /// Body of the cleaner thread.  Never returns.
+    void Run();
+
+    /// Wait until the cleaner is done with any write in progress and make
+    /// it stop for good.  Called as Nachos halts, before the swap area is
+    /// deleted.
+    void Stop();
+
+private:
+
+    /// Write back dirty, not recently used pages until there are
+    /// `lowWatermark` clean frames, or every dirty frame has been looked
+    /// at.
+    void CleanFrames();
+
+    Semaphore *wakeUp;
+
+    /// Whether a `WakeUp` is already pending.
+    bool pending;
+
+    /// Whether `Stop` has been called.
+    bool stopping;
+
+    /// Signalled by the cleaner once it has stopped.
+    Semaphore *stopped;
+
+    unsigned lowWatermark;
+
+    unsigned period;
+
+    /// Timer interrupts since the last periodic run.
+    unsigned ticks;
+};
+
+
+#endif
@@ -0,0 +1,689 @@
+#include "replacement_policy.hh"
+#include "threads/system.hh"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#ifdef USE_SWAP
+
+FrameQueues::FrameQueues(unsigned nframes, unsigned nqueues)
+{
+    ASSERT(nframes > 0);
+    ASSERT(nqueues > 0);
+
+    links = new Link [nframes];
+    for (unsigned i = 0; i < nframes; i++) {
+        links[i].queue = -1;
+    }
+    numQueues = nqueues;
+    heads = new int [nqueues];
+    tails = new int [nqueues];
+    counts = new unsigned [nqueues];
+    for (unsigned i = 0; i < nqueues; i++) {
+        heads[i] = tails[i] = -1;
+        counts[i] = 0;
+    }
+}
+
+FrameQueues::~FrameQueues()
+{
+    delete [] links;
+    delete [] heads;
+    delete [] tails;
+    delete [] counts;
+}
+
+void
+FrameQueues::Append(unsigned frame, unsigned queue)
+{
+    ASSERT(queue < numQueues);
+
+    Remove(frame);
+    Link *link = &links[frame];
+    link->queue = queue;
+    link->prev = tails[queue];
+    link->next = -1;
+    if (tails[queue] == -1) {
+        heads[queue] = frame;
+    } else {
+        links[tails[queue]].next = frame;
+    }
+    tails[queue] = frame;
+    counts[queue]++;
+}
+
+void
+FrameQueues::Remove(unsigned frame)
+{
+    Link *link = &links[frame];
+    if (link->queue == -1) {
+        return;
+    }
+
+    unsigned queue = link->queue;
+    if (link->prev == -1) {
+        heads[queue] = link->next;
+    } else {
+        links[link->prev].next = link->next;
+    }
+    if (link->next == -1) {
+        tails[queue] = link->prev;
+    } else {
+        links[link->next].prev = link->prev;
+    }
+    counts[queue]--;
+    link->queue = -1;
+}
+
+int
+FrameQueues::First(unsigned queue) const
+{
+    ASSERT(queue < numQueues);
+    return heads[queue];
+}
+
+unsigned
+FrameQueues::Count(unsigned queue) const
+{
+    ASSERT(queue < numQueues);
+    return counts[queue];
+}
+
+void
+FrameQueues::Splice(unsigned from, unsigned to)
+{
+    ASSERT(from < numQueues);
+    ASSERT(to < numQueues);
+
+    if (from == to || heads[from] == -1) {
+        return;
+    }
+    for (int frame = heads[from]; frame != -1; frame = links[frame].next) {
+        links[frame].queue = to;
+    }
+    if (tails[to] == -1) {
+        heads[to] = heads[from];
+    } else {
+        links[tails[to]].next = heads[from];
+        links[heads[from]].prev = tails[to];
+    }
+    tails[to] = tails[from];
+    counts[to] += counts[from];
+    heads[from] = tails[from] = -1;
+    counts[from] = 0;
+}
+
+
+ReplacementPolicy *
+ReplacementPolicy::Create(const char *name, unsigned nframes)
+{
+    ASSERT(name != nullptr);
+
+    if (strcmp(name, "fifo") == 0) {
+        return new FifoPolicy(nframes);
+    } else if (strcmp(name, "random") == 0) {
+        return new RandomPolicy(nframes);
+    } else if (strcmp(name, "clock") == 0) {
+        return new ClockPolicy(nframes);
+    } else if (strcmp(name, "wsclock") == 0) {
+        return new WsClockPolicy(nframes);
+    } else if (strcmp(name, "aging") == 0) {
+        return new AgingPolicy(nframes);
+    } else if (strcmp(name, "lru2") == 0) {
+        return new Lru2Policy(nframes);
+    }
+    return nullptr;
+}
+
+const char *
+ReplacementPolicy::Names()
+{
+    return "fifo random clock wsclock aging lru2";
+}
+
+ReplacementPolicy::ReplacementPolicy(unsigned nframes)
+{
+    ASSERT(nframes > 0);
+    numFrames = nframes;
+    sampleHand = 0;
+    sweeps = 1;
+}
+
+ReplacementPolicy::~ReplacementPolicy()
+{}
+
+void
+ReplacementPolicy::PageLoaded(unsigned frame)
+{}
+
+void
+ReplacementPolicy::Tick()
+{}
+
+bool
+ReplacementPolicy::WantsTicks() const
+{
+    return false;
+}
+
+TranslationEntry *
+ReplacementPolicy::GetEntry(unsigned frame) const
+{
+    AddressSpace *space = usedPages->GetAddrSpace(frame);
+    if (space == nullptr) {
+        return nullptr;
+    }
+    return space->GetTranslationEntry(usedPages->GetVpn(frame));
+}
+
+bool
+ReplacementPolicy::Evictable(unsigned frame) const
+{
+    TranslationEntry *entry = GetEntry(frame);
+    return entry != nullptr && entry->valid && !usedPages->IsPinned(frame);
+}
+
+TranslationEntry *
+ReplacementPolicy::GetTlbEntry(unsigned frame) const
+{
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+
+    // Only the running address space has its translations in the TLB.
+    if (tlb == nullptr || currentThread->space == nullptr
+          || currentThread->space != usedPages->GetAddrSpace(frame)) {
+        return nullptr;
+    }
+
+    for (unsigned i = 0; i < TLB_SIZE; i++) {
+        if (tlb[i].valid && tlb[i].physicalPage == frame) {
+            return &tlb[i];
+        }
+    }
+    return nullptr;
+}
+
+bool
+ReplacementPolicy::TestUse(unsigned frame) const
+{
+    TranslationEntry *tlbEntry = GetTlbEntry(frame);
+    if (tlbEntry != nullptr && tlbEntry->use) {
+        return true;
+    }
+    return GetEntry(frame)->use;
+}
+
+bool
+ReplacementPolicy::TestDirty(unsigned frame) const
+{
+    TranslationEntry *tlbEntry = GetTlbEntry(frame);
+    if (tlbEntry != nullptr && tlbEntry->dirty) {
+        return true;
+    }
+    return GetEntry(frame)->dirty;
+}
+
+void
+ReplacementPolicy::ClearUse(unsigned frame)
+{
+    TranslationEntry *tlbEntry = GetTlbEntry(frame);
+    if (tlbEntry != nullptr) {
+        tlbEntry->use = false;
+    }
+    TranslationEntry *entry = GetEntry(frame);
+    entry->use = false;
+    usedPages->Update(frame, false, entry->dirty);
+}
+
+int
+ReplacementPolicy::FirstEvictable(FrameList list) const
+{
+    for (int frame = usedPages->First(list); frame != -1;
+         frame = usedPages->Next(frame)) {
+        if (Evictable(frame)) {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+unsigned
+ReplacementPolicy::AnyEvictable() const
+{
+    int frame = FirstEvictable(CLEAN_FRAMES);
+    if (frame == -1) {
+        frame = FirstEvictable(DIRTY_FRAMES);
+    }
+    // Unless every frame is being loaded, some frame is found.
+    ASSERT(frame != -1);
+    return frame;
+}
+
+unsigned
+ReplacementPolicy::NextSample()
+{
+    unsigned frame = sampleHand;
+    sampleHand = (sampleHand + 1) % numFrames;
+    if (sampleHand == 0) {
+        sweeps++;
+    }
+    return frame;
+}
+
+unsigned
+ReplacementPolicy::SamplesPerTick() const
+{
+    unsigned count = (numFrames + SAMPLE_SWEEP_TICKS - 1) / SAMPLE_SWEEP_TICKS;
+    if (count < SAMPLE_FRAMES_PER_TICK) {
+        count = SAMPLE_FRAMES_PER_TICK;
+    }
+    return count < numFrames ? count : numFrames;
+}
+
+unsigned long
+ReplacementPolicy::Sweeps() const
+{
+    return sweeps;
+}
+
+int
+ReplacementPolicy::PickFrom(FrameQueues *queues, unsigned clean,
+                            unsigned dirty)
+{
+    ASSERT(queues != nullptr);
+
+    // Each frame at the head is looked at once: whatever is not taken
+    // leaves the head, for the tail of some queue or for none.
+    for (unsigned i = queues->Count(clean); i > 0; i--) {
+        int frame = queues->First(clean);
+        if (GetEntry(frame) == nullptr) {
+            // Freed; `PageLoaded` queues it again.
+            queues->Remove(frame);
+        } else if (!Evictable(frame)) {
+            queues->Append(frame, clean);
+        } else if (TestUse(frame)) {
+            Referenced(frame);
+        } else if (TestDirty(frame)) {
+            // The TLB may know of writes the coremap does not.
+            queues->Append(frame, dirty);
+        } else {
+            return frame;
+        }
+    }
+    for (unsigned i = queues->Count(dirty); i > 0; i--) {
+        int frame = queues->First(dirty);
+        if (GetEntry(frame) == nullptr) {
+            queues->Remove(frame);
+        } else if (!Evictable(frame)) {
+            queues->Append(frame, dirty);
+        } else if (TestUse(frame)) {
+            Referenced(frame);
+        } else {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+void
+ReplacementPolicy::Referenced(unsigned frame)
+{
+    ClearUse(frame);
+}
+
+
+FifoPolicy::FifoPolicy(unsigned nframes) : ReplacementPolicy(nframes)
+{
+    loaded = new unsigned long [nframes];
+    for (unsigned i = 0; i < nframes; i++) {
+        loaded[i] = 0;
+    }
+    numLoaded = 0;
+}
+
+FifoPolicy::~FifoPolicy()
+{
+    delete [] loaded;
+}
+
+void
+FifoPolicy::PageLoaded(unsigned frame)
+{
+    loaded[frame] = ++numLoaded;
+}
+
+unsigned
+FifoPolicy::PickVictim()
+{
+    int clean = FirstEvictable(CLEAN_FRAMES);
+    int dirty = FirstEvictable(DIRTY_FRAMES);
+    if (clean == -1) {
+        ASSERT(dirty != -1);
+        return dirty;
+    }
+    return dirty != -1 && loaded[dirty] < loaded[clean] ? dirty : clean;
+}
+
+
+RandomPolicy::RandomPolicy(unsigned nframes) : ReplacementPolicy(nframes)
+{}
+
+unsigned
+RandomPolicy::PickVictim()
+{
+    unsigned frame = random() % numFrames;
+    while (!Evictable(frame)) {
+        frame = (frame + 1) % numFrames;
+    }
+    return frame;
+}
+
+
+ClockPolicy::ClockPolicy(unsigned nframes) : ReplacementPolicy(nframes)
+{}
+
+int
+ClockPolicy::Sweep(FrameList list, bool clear)
+{
+    for (unsigned i = usedPages->Count(list); i > 0; i--) {
+        int frame = usedPages->First(list);
+        if (frame == -1) {
+            break;
+        }
+
+        if (Evictable(frame)) {
+            if (!TestUse(frame)) {
+                // The TLB may know of writes the coremap does not.
+                if (list == DIRTY_FRAMES || !TestDirty(frame)) {
+                    return frame;
+                }
+            } else if (clear) {
+                ClearUse(frame);
+            }
+        }
+        usedPages->Skip(frame);
+    }
+    return -1;
+}
+
+unsigned
+ClockPolicy::PickVictim()
+{
+    // We look for (0, 0), then for (0, 1), clearing the use bits of the
+    // frames we pass by, and then once more.
+    for (unsigned round = 1; round <= 2; round++) {
+        int frame = Sweep(CLEAN_FRAMES, round == 1);
+        if (frame == -1) {
+            frame = Sweep(DIRTY_FRAMES, round == 1);
+        }
+        if (frame != -1) {
+            return frame;
+        }
+    }
+
+    // Every frame has been used since, by some other thread.
+    return AnyEvictable();
+}
+
+
+WsClockPolicy::WsClockPolicy(unsigned nframes) : ReplacementPolicy(nframes)
+{
+    lastUse = new unsigned long [nframes];
+    for (unsigned i = 0; i < nframes; i++) {
+        lastUse[i] = 0;
+    }
+}
+
+WsClockPolicy::~WsClockPolicy()
+{
+    delete [] lastUse;
+}
+
+void
+WsClockPolicy::PageLoaded(unsigned frame)
+{
+    lastUse[frame] = stats->totalTicks;
+}
+
+int
+WsClockPolicy::Sweep(FrameList list, unsigned long now, int *oldDirty)
+{
+    ASSERT(oldDirty != nullptr);
+
+    for (unsigned i = usedPages->Count(list); i > 0; i--) {
+        int frame = usedPages->First(list);
+        if (frame == -1) {
+            break;
+        }
+
+        if (Evictable(frame)) {
+            if (TestUse(frame)) {
+                // Still in the working set.
+                ClearUse(frame);
+                lastUse[frame] = now;
+            } else if (now - lastUse[frame] > WSCLOCK_TAU) {
+                if (list == CLEAN_FRAMES && !TestDirty(frame)) {
+                    return frame;
+                } else if (*oldDirty == -1) {
+                    *oldDirty = frame;
+                }
+            }
+        }
+        usedPages->Skip(frame);
+    }
+    return -1;
+}
+
+unsigned
+WsClockPolicy::PickVictim()
+{
+    unsigned long now = stats->totalTicks;
+    int oldDirty = -1;
+
+    int frame = Sweep(CLEAN_FRAMES, now, &oldDirty);
+    if (frame != -1) {
+        return frame;
+    }
+    Sweep(DIRTY_FRAMES, now, &oldDirty);
+
+    if (oldDirty != -1) {
+        #ifdef PAGE_CLEANER
+        // Old dirty pages should have been cleaned already; ask for it.
+        pageCleaner->WakeUp();
+        #endif
+        return oldDirty;
+    }
+
+    // Used frames went to the tail of their list, so the frame at the head
+    // is the one used the longest ago.
+    return AnyEvictable();
+}
+
+
+/// Classes of aging counters, by the number of bits up to the highest one
+/// set: from 0, for counters of 0, to 8.
+static const unsigned AGING_CLASSES = 9;
+
+AgingPolicy::AgingPolicy(unsigned nframes) : ReplacementPolicy(nframes)
+{
+    age = new uint8_t [nframes];
+    for (unsigned i = 0; i < nframes; i++) {
+        age[i] = 0;
+    }
+    // A clean and a dirty queue for each class.
+    queues = new FrameQueues(nframes, 2 * AGING_CLASSES);
+}
+
+AgingPolicy::~AgingPolicy()
+{
+    delete [] age;
+    delete queues;
+}
+
+void
+AgingPolicy::Requeue(unsigned frame)
+{
+    unsigned bits = 0;
+    for (unsigned counter = age[frame]; counter != 0; counter >>= 1) {
+        bits++;
+    }
+    queues->Append(frame, 2 * bits + (TestDirty(frame) ? 1 : 0));
+}
+
+void
+AgingPolicy::PageLoaded(unsigned frame)
+{
+    // The page has just been referenced.
+    age[frame] = 0x80;
+    Requeue(frame);
+}
+
+void
+AgingPolicy::Referenced(unsigned frame)
+{
+    age[frame] |= 0x80;
+    ClearUse(frame);
+    Requeue(frame);
+}
+
+void
+AgingPolicy::Tick()
+{
+    for (unsigned i = SamplesPerTick(); i > 0; i--) {
+        unsigned frame = NextSample();
+        if (!Evictable(frame)) {
+            continue;
+        }
+        age[frame] >>= 1;
+        if (TestUse(frame)) {
+            Referenced(frame);
+        } else {
+            Requeue(frame);
+        }
+    }
+}
+
+bool
+AgingPolicy::WantsTicks() const
+{
+    return true;
+}
+
+unsigned
+AgingPolicy::PickVictim()
+{
+    for (unsigned bits = 0; bits < AGING_CLASSES; bits++) {
+        int frame = PickFrom(queues, 2 * bits, 2 * bits + 1);
+        if (frame != -1) {
+            return frame;
+        }
+    }
+
+    // Every frame has been used since, by some other thread.
+    return AnyEvictable();
+}
+
+
+/// Queues of `Lru2Policy`, each a clean one and then a dirty one: frames
+/// referenced once, frames whose second to last reference is older than
+/// the sweeps told apart, and then one for each of those sweeps.
+static const unsigned LRU2_ONCE = 0;
+static const unsigned LRU2_OLD = 2;
+static const unsigned LRU2_RECENT = 4;
+
+Lru2Policy::Lru2Policy(unsigned nframes) : ReplacementPolicy(nframes)
+{
+    last = new unsigned long [nframes];
+    previous = new unsigned long [nframes];
+    for (unsigned i = 0; i < nframes; i++) {
+        last[i] = previous[i] = 0;
+    }
+    queues = new FrameQueues(nframes, LRU2_RECENT + 2 * LRU2_SWEEPS);
+}
+
+Lru2Policy::~Lru2Policy()
+{
+    delete [] last;
+    delete [] previous;
+    delete queues;
+}
+
+void
+Lru2Policy::Requeue(unsigned frame)
+{
+    unsigned queue;
+    if (previous[frame] == 0) {
+        queue = LRU2_ONCE;
+    } else if (Sweeps() - previous[frame] >= LRU2_SWEEPS) {
+        queue = LRU2_OLD;
+    } else {
+        queue = LRU2_RECENT + 2 * (previous[frame] % LRU2_SWEEPS);
+    }
+    queues->Append(frame, queue + (TestDirty(frame) ? 1 : 0));
+}
+
+void
+Lru2Policy::PageLoaded(unsigned frame)
+{
+    // A previous reference of 0 stands for “never”.
+    last[frame] = Sweeps();
+    previous[frame] = 0;
+    Requeue(frame);
+}
+
+void
+Lru2Policy::Referenced(unsigned frame)
+{
+    previous[frame] = last[frame];
+    last[frame] = Sweeps();
+    ClearUse(frame);
+    Requeue(frame);
+}
+
+void
+Lru2Policy::Tick()
+{
+    for (unsigned i = SamplesPerTick(); i > 0; i--) {
+        unsigned long sweep = Sweeps();
+        unsigned frame = NextSample();
+        if (Sweeps() != sweep) {
+            // The queue of the sweep that is now too old to be told apart
+            // is taken over by the new one.
+            unsigned queue = LRU2_RECENT + 2 * (Sweeps() % LRU2_SWEEPS);
+            queues->Splice(queue, LRU2_OLD);
+            queues->Splice(queue + 1, LRU2_OLD + 1);
+        }
+        if (Evictable(frame) && TestUse(frame)) {
+            Referenced(frame);
+        }
+    }
+}
+
+bool
+Lru2Policy::WantsTicks() const
+{
+    return true;
+}
+
+unsigned
+Lru2Policy::PickVictim()
+{
+    int frame = PickFrom(queues, LRU2_ONCE, LRU2_ONCE + 1);
+    if (frame == -1) {
+        frame = PickFrom(queues, LRU2_OLD, LRU2_OLD + 1);
+    }
+
+    // Then the sweeps told apart, the oldest first.
+    unsigned long now = Sweeps();
+    for (unsigned i = LRU2_SWEEPS; frame == -1 && i > 0; i--) {
+        unsigned long ago = i - 1;
+        if (ago < now) {
+            unsigned queue = LRU2_RECENT + 2 * ((now - ago) % LRU2_SWEEPS);
+            frame = PickFrom(queues, queue, queue + 1);
+        }
+    }
+
+    return frame != -1 ? frame : AnyEvictable();
+}
+
+#endif
@@ -0,0 +1,269 @@
+/// Page replacement policies.
+///
+/// When a page fault finds no free frame, the address space asks the
+/// current policy for a victim frame.  Policies are selected at startup with
+/// `-vm-policy <name>`; the `PRPOLICY_*` macros only choose the default.
+///
+/// Reference and dirty information is taken from the page tables, except
+/// for pages of the running address space that are currently in the TLB,
+/// whose bits are read from (and cleared in) the TLB entry directly.  That
+/// way no policy needs to flush the whole TLB state on every fault.
+///
+/// Victims are looked for in the clean and dirty lists of the coremap, clean
+/// ones first, rather than by going through every frame: the clock policies
+/// keep their hand in the order of the lists, moving the frames they pass
+/// over to the tail.  Policies that sample reference bits do it only on
+/// timer interrupts, enough frames at a time to go through all of them
+/// every `SAMPLE_SWEEP_TICKS` interrupts; they keep frames in queues by
+/// how recently they were used, and take victims from the heads.
+
+#ifndef NACHOS_VMEM_REPLACEMENTPOLICY__HH
+#define NACHOS_VMEM_REPLACEMENTPOLICY__HH
+
+
+#include "coremap.hh"
+#include "machine/translation_entry.hh"
+
+#include <stdint.h>
+
+
+/// Working set window of the WSClock policy, in ticks.
+const unsigned long WSCLOCK_TAU = 2000;
+
+/// Fewest frames whose reference bits are sampled on each timer interrupt.
+const unsigned SAMPLE_FRAMES_PER_TICK = 16;
+
+/// Timer interrupts it takes to sample every frame once, if there are more
+/// than `SAMPLE_FRAMES_PER_TICK` times as many frames.
+const unsigned SAMPLE_SWEEP_TICKS = 8;
+
+/// Number of recent sweeps that LRU-2 tells apart; references older than
+/// that are all alike.
+const unsigned LRU2_SWEEPS = 8;
+
+
+/// Frames kept in a number of queues, each frame in one queue at most, so
+/// that a policy can keep them in the order it evicts them and take a
+/// victim from the head of a queue instead of going through every frame.
+class FrameQueues {
+public:
+
+    FrameQueues(unsigned nframes, unsigned nqueues);
+
+    ~FrameQueues();
+
+    /// Put `frame` at the tail of `queue`, taking it out of the queue it
+    /// was in, if any.
+    void Append(unsigned frame, unsigned queue);
+
+    /// Take `frame` out of its queue, if it is in one.
+    void Remove(unsigned frame);
+
+    /// Head of `queue`, or -1 if it is empty.
+    int First(unsigned queue) const;
+
+    unsigned Count(unsigned queue) const;
+
+    /// Move every frame of `from` to the tail of `to`, in the same order.
+    void Splice(unsigned from, unsigned to);
+
+private:
+
+    struct Link {
+        int queue;  ///< -1 if the frame is in no queue.
+        int prev;
+        int next;
+    };
+
+    Link *links;
+    int *heads;
+    int *tails;
+    unsigned *counts;
+    unsigned numQueues;
+};
+
+
+class ReplacementPolicy {
+public:
+
+    /// Return a policy given its name, or null if there is no such policy.
+    ///
+    /// * `nframes` is the number of physical frames to manage.
+    static ReplacementPolicy *Create(const char *name, unsigned nframes);
+
+    /// Names accepted by `Create`, separated by spaces.
+    static const char *Names();
+
+    ReplacementPolicy(unsigned nframes);
+
+    virtual ~ReplacementPolicy();
+
+    /// Choose a frame to evict.  Every frame is assumed to be occupied.
+    virtual unsigned PickVictim() = 0;
+
+    /// A page has just been loaded into `frame`.
+    virtual void PageLoaded(unsigned frame);
+
+    /// Called on every timer interrupt, for policies that sample
+    /// reference bits periodically.
+    virtual void Tick();
+
+    /// Whether `Tick` does anything, so that timer interrupts have to keep
+    /// coming even with a single runnable thread.
+    virtual bool WantsTicks() const;
+
+protected:
+
+    /// Page table entry of the page held in `frame`, or null if the frame
+    /// is free.
+    TranslationEntry *GetEntry(unsigned frame) const;
+
+    /// Whether the page in `frame` can be evicted right now.  Frames whose
+    /// page is still being loaded, or that are pinned, are skipped.
+    bool Evictable(unsigned frame) const;
+
+    bool TestUse(unsigned frame) const;
+    bool TestDirty(unsigned frame) const;
+    void ClearUse(unsigned frame);
+
+    /// First frame of `list` that can be evicted, or -1 if none.
+    int FirstEvictable(FrameList list) const;
+
+    /// First frame that can be evicted, clean ones first.  Every frame is
+    /// assumed to be occupied, and some of them not to be pinned.
+    unsigned AnyEvictable() const;
+
+    /// Next frame to sample, in round robin order, for policies that
+    /// sample reference bits.
+    unsigned NextSample();
+
+    /// How many frames to sample on each timer interrupt.
+    unsigned SamplesPerTick() const;
+
+    /// Number of times every frame has been sampled, plus one, so that 0
+    /// can stand for “never”.
+    unsigned long Sweeps() const;
+
+    /// Take a victim from `queues`, looking at `clean` and then at `dirty`.
+    /// Frames that cannot be evicted go to the tail, free ones are dropped,
+    /// those found dirty in `clean` move to `dirty`, and those found used
+    /// are passed to `Referenced`, which requeues them.  Each frame is then
+    /// looked at about once for each time it changes.  Return -1 if both
+    /// queues have nothing to evict.
+    int PickFrom(FrameQueues *queues, unsigned clean, unsigned dirty);
+
+    /// `frame` was found used outside of sampling; count it as sampled.
+    virtual void Referenced(unsigned frame);
+
+    unsigned numFrames;
+
+private:
+
+    /// TLB entry mapping `frame` for the running address space, if any.
+    TranslationEntry *GetTlbEntry(unsigned frame) const;
+
+    unsigned sampleHand;
+    unsigned long sweeps;
+};
+
+/// Evict the frame loaded the longest ago.  Frames join the tail of the
+/// clean list when loaded, and move to the tail of the other list whenever
+/// they are dirtied or written back, so only the heads of the two lists are
+/// compared; the order is approximate.
+class FifoPolicy : public ReplacementPolicy {
+public:
+    FifoPolicy(unsigned nframes);
+    ~FifoPolicy();
+    unsigned PickVictim();
+    void PageLoaded(unsigned frame);
+private:
+    unsigned long *loaded;  ///< Load number of the page in each frame.
+    unsigned long numLoaded;
+};
+
+/// Evict a random frame.
+class RandomPolicy : public ReplacementPolicy {
+public:
+    RandomPolicy(unsigned nframes);
+    unsigned PickVictim();
+};
+
+/// Enhanced second chance: look for a (not used, clean) frame, then for a
+/// (not used, dirty) one, clearing use bits along the way, and repeat.  The
+/// head of each list is the hand; used frames go to the tail.
+class ClockPolicy : public ReplacementPolicy {
+public:
+    ClockPolicy(unsigned nframes);
+    unsigned PickVictim();
+private:
+    /// Go once through `list`, looking for a frame that is not used, and
+    /// clearing use bits along the way if `clear` is set.
+    int Sweep(FrameList list, bool clear);
+};
+
+/// WSClock: a frame used within the last `WSCLOCK_TAU` ticks is in the
+/// working set of its process and is skipped.  Old clean frames are
+/// evicted first, then old dirty ones, and as a last resort the frame that
+/// was used the longest ago.  As with `ClockPolicy`, used frames go to the
+/// tail of their list, so the heads are the frames used the longest ago.
+class WsClockPolicy : public ReplacementPolicy {
+public:
+    WsClockPolicy(unsigned nframes);
+    ~WsClockPolicy();
+    unsigned PickVictim();
+    void PageLoaded(unsigned frame);
+private:
+    /// Go once through `list`, looking for a clean frame out of the working
+    /// set.  Remember the first dirty one in `oldDirty`, if still -1.
+    int Sweep(FrameList list, unsigned long now, int *oldDirty);
+    unsigned long *lastUse;
+};
+
+/// LRU approximation with 8-bit aging counters: whenever a frame is
+/// sampled, its counter is shifted right and the use bit is shifted in from
+/// the left.  Frames are queued by the highest bit set in their counter, so
+/// the victim comes from the first queue with an evictable frame, clean
+/// ones first; within a class, the frame that has been in it the longest.
+/// A frame found used on the way gets its top bit set and is requeued.
+class AgingPolicy : public ReplacementPolicy {
+public:
+    AgingPolicy(unsigned nframes);
+    ~AgingPolicy();
+    unsigned PickVictim();
+    void PageLoaded(unsigned frame);
+    void Tick();
+    bool WantsTicks() const;
+private:
+    void Referenced(unsigned frame);
+    /// Put `frame` in the queue for its counter and whether it is dirty.
+    void Requeue(unsigned frame);
+    uint8_t *age;
+    FrameQueues *queues;
+};
+
+/// LRU-2: remember the sweeps of the last two sampled references of each
+/// frame and evict the one whose second to last reference is the oldest.
+/// Frames referenced only once are evicted before any other, in the order
+/// they were loaded.  The rest are queued by the sweep of their second to
+/// last reference, over the last `LRU2_SWEEPS` sweeps, with older ones all
+/// in one queue; the victim comes from the oldest queue with an evictable
+/// frame, clean ones first.
+class Lru2Policy : public ReplacementPolicy {
+public:
+    Lru2Policy(unsigned nframes);
+    ~Lru2Policy();
+    unsigned PickVictim();
+    void PageLoaded(unsigned frame);
+    void Tick();
+    bool WantsTicks() const;
+private:
+    void Referenced(unsigned frame);
+    /// Put `frame` in the queue for its references and whether it is dirty.
+    void Requeue(unsigned frame);
+    unsigned long *last;
+    unsigned long *previous;
+    FrameQueues *queues;
+};
+
+
+#endif
@@ -0,0 +1,157 @@
+#include "swap_area.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+#ifdef SWAP_CACHE
+#include "threads/lock.hh"
+#endif
+
+#include <stdio.h>
+
+
+SwapArea::SwapArea(const char *swapName, unsigned nslots,
+                   unsigned cacheFrames)
+{
+    ASSERT(swapName != nullptr);
+    ASSERT(nslots > 0);
+
+    name = swapName;
+    numSlots = nslots;
+
+    fileSystem->Remove(name);
+    if (!fileSystem->Create(name, numSlots * PAGE_SIZE)) {
+        fprintf(stderr, "Unable to create a swap file of %u pages.\n",
+                numSlots);
+        ASSERT(false);
+    }
+    file = fileSystem->Open(name);
+    ASSERT(file != nullptr);
+
+    slots = new Bitmap(numSlots);
+    DEBUG('e', "Swap area %s created, %u slots\n", name, numSlots);
+
+#ifdef SWAP_CACHE
+    cache = nullptr;
+    if (cacheFrames > 0) {
+        cache = new SwapCache(cacheFrames, numSlots);
+        cacheLock = new Lock("swap cache lock");
+        compressed = new char [cache->MaxCompressedSize()];
+        spilled = new char [PAGE_SIZE];
+    }
+#endif
+}
+
+SwapArea::~SwapArea()
+{
+    #ifndef FILESYS_STUB
+    fileSystem->Close(file->GetGlobalId());
+    #endif
+    delete file;
+    fileSystem->Remove(name);
+    delete slots;
+#ifdef SWAP_CACHE
+    if (cache != nullptr) {
+        delete cache;
+        delete cacheLock;
+        delete [] compressed;
+        delete [] spilled;
+    }
+#endif
+}
+
+int
+SwapArea::AllocateSlot()
+{
+    return slots->Find();
+}
+
+void
+SwapArea::FreeSlot(unsigned slot)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(slots->Test(slot));
+
+    slots->Clear(slot);
+#ifdef SWAP_CACHE
+    if (cache != nullptr) {
+        cacheLock->Acquire();
+        cache->Drop(slot);
+        cacheLock->Release();
+    }
+#endif
+}
+
+void
+SwapArea::WritePage(unsigned slot, const char *from)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(from != nullptr);
+
+#ifdef SWAP_CACHE
+    if (cache != nullptr) {
+        // Whatever the pool had for the slot is stale now.  Taking the lock
+        // also waits for it to finish if it was being spilled.
+        cacheLock->Acquire();
+        cache->Drop(slot);
+        unsigned size = cache->Compress(from, compressed);
+        if (size != 0) {
+            MakeRoom(size);
+            cache->Store(slot, compressed, size);
+            stats->numSwapCacheStores++;
+            stats->numSwapCacheBytesIn += PAGE_SIZE;
+            stats->numSwapCacheBytesOut += size;
+            cacheLock->Release();
+            return;
+        }
+        cacheLock->Release();
+    }
+#endif
+
+    ASSERT(file->WriteAt(from, PAGE_SIZE, slot * PAGE_SIZE) == (int) PAGE_SIZE);
+}
+
+void
+SwapArea::ReadPage(unsigned slot, char *into)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(into != nullptr);
+
+#ifdef SWAP_CACHE
+    // The page stays in the pool: it is still the contents of the slot.
+    if (cache != nullptr) {
+        cacheLock->Acquire();
+        if (cache->Contains(slot)) {
+            cache->Load(slot, into);
+            stats->numSwapCacheHits++;
+            cacheLock->Release();
+            return;
+        }
+        cacheLock->Release();
+    }
+#endif
+
+    ASSERT(file->ReadAt(into, PAGE_SIZE, slot * PAGE_SIZE) == (int) PAGE_SIZE);
+}
+
+unsigned
+SwapArea::CountFree() const
+{
+    return slots->CountClear();
+}
+
+#ifdef SWAP_CACHE
+void
+SwapArea::MakeRoom(unsigned size)
+{
+    while (!cache->HasRoom(size)) {
+        int victim = cache->Oldest();
+        ASSERT(victim != -1);
+
+        DEBUG('e', "Spilling swap slot %d from the cache\n", victim);
+        cache->Load(victim, spilled);
+        cache->Drop(victim);
+        ASSERT(file->WriteAt(spilled, PAGE_SIZE, victim * PAGE_SIZE)
+                 == (int) PAGE_SIZE);
+        stats->numSwapCacheSpills++;
+    }
+}
+#endif
@@ -0,0 +1,96 @@
+/// A single swap area shared by every address space.
+///
+/// The area is a file created once at boot, with room for a number of
+/// page-sized slots set with `-swap`.  Slots are handed out one page at a
+/// time, when a dirty page is evicted, and given back when the owning
+/// address space is destroyed.  This way starting a process has no swap
+/// setup cost at all, and swapped pages are kept together on disk.
+///
+/// Once every slot is taken, dirty pages without one cannot be evicted, and
+/// a process that needs a frame when none can be freed is killed.
+///
+/// With `SWAP_CACHE`, pages go through a pool of compressed pages in memory
+/// on their way to and from the file (see `SwapCache`).
+
+#ifndef NACHOS_VMEM_SWAPAREA__HH
+#define NACHOS_VMEM_SWAPAREA__HH
+
+
+#include "filesys/open_file.hh"
+#include "machine/disk.hh"
+#include "lib/bitmap.hh"
+#ifdef SWAP_CACHE
+#include "swap_cache.hh"
+
+class Lock;
+#endif
+
+
+/// By default, the swap area holds this many pages for every physical
+/// frame, whatever the memory geometry chosen at startup.
+const unsigned SWAP_PAGES_PER_FRAME = 16;
+
+/// Largest swap area, in bytes.  Slot offsets must fit in a file position.
+const unsigned MAX_SWAP_SIZE = 1024 * 1024 * 1024;
+
+
+class SwapArea {
+public:
+
+    /// Create the swap file `name`, with room for `nslots` pages.
+    ///
+    /// Any stale swap file left behind by a previous run is removed first.
+    /// With `SWAP_CACHE`, `cacheFrames` frames of physical memory are
+    /// reserved for compressed pages; none if 0.
+    SwapArea(const char *name, unsigned nslots, unsigned cacheFrames = 0);
+
+    /// Close and remove the swap file.
+    ~SwapArea();
+
+    /// Reserve a free slot.
+    ///
+    /// Return the slot number, or -1 if the swap area is full.
+    int AllocateSlot();
+
+    /// Give back a slot previously obtained through `AllocateSlot`.
+    void FreeSlot(unsigned slot);
+
+    /// Copy one page from `from` into `slot`.
+    void WritePage(unsigned slot, const char *from);
+
+    /// Copy the page stored in `slot` into `into`.
+    void ReadPage(unsigned slot, char *into);
+
+    /// Return the number of free slots.
+    unsigned CountFree() const;
+
+private:
+
+    const char *name;
+
+    OpenFile *file;
+
+    /// Which slots are in use.
+    Bitmap *slots;
+
+    unsigned numSlots;
+
+#ifdef SWAP_CACHE
+    /// Write the oldest pages of the cache to disk until there is room for
+    /// `size` compressed bytes.
+    void MakeRoom(unsigned size);
+
+    SwapCache *cache;
+
+    /// Serializes cache operations, including the disk writes of spilled
+    /// pages, so that a page is never read while it is half way to disk.
+    Lock *cacheLock;
+
+    /// Buffers for a compressed page and for a page being spilled.
+    char *compressed;
+    char *spilled;
+#endif
+};
+
+
+#endif
@@ -0,0 +1,237 @@
+#include "swap_cache.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+
+#ifdef SWAP_CACHE
+
+SwapCache::SwapCache(unsigned nframes, unsigned nslots)
+{
+    ASSERT(nframes > 0);
+    ASSERT(nslots > 0);
+    ASSERT(PAGE_SIZE % SWAP_CACHE_CHUNKS_PER_PAGE == 0);
+
+    numFrames = nframes;
+    frames = new unsigned [numFrames];
+    for (unsigned i = 0; i < numFrames; i++) {
+        frames[i] = usedPages->Reserve();
+    }
+
+    chunkSize = PAGE_SIZE / SWAP_CACHE_CHUNKS_PER_PAGE;
+    numChunks = numFrames * SWAP_CACHE_CHUNKS_PER_PAGE;
+    chunks = new Bitmap(numChunks);
+    nextChunk = new int [numChunks];
+    buffer = new char [MaxCompressedSize()];
+
+    numSlots = nslots;
+    firstChunk = new int [numSlots];
+    sizes = new unsigned [numSlots];
+    older = new int [numSlots];
+    newer = new int [numSlots];
+    for (unsigned i = 0; i < numSlots; i++) {
+        firstChunk[i] = -1;
+    }
+    oldest = newest = -1;
+
+    DEBUG('e', "Swap cache created, %u frames, %u chunks of %u bytes\n",
+          numFrames, numChunks, chunkSize);
+}
+
+SwapCache::~SwapCache()
+{
+    // The reserved frames are not given back: the coremap is never used
+    // again once the swap area goes away.
+    delete [] frames;
+    delete chunks;
+    delete [] nextChunk;
+    delete [] buffer;
+    delete [] firstChunk;
+    delete [] sizes;
+    delete [] older;
+    delete [] newer;
+}
+
+char *
+SwapCache::ChunkAddress(unsigned chunk) const
+{
+    ASSERT(chunk < numChunks);
+
+    unsigned frame = frames[chunk / SWAP_CACHE_CHUNKS_PER_PAGE];
+    unsigned offset = chunk % SWAP_CACHE_CHUNKS_PER_PAGE * chunkSize;
+    return &machine->GetMMU()->mainMemory[frame * PAGE_SIZE + offset];
+}
+
+unsigned
+SwapCache::MaxCompressedSize() const
+{
+    return SWAP_CACHE_MAX_CHUNKS * chunkSize;
+}
+
+/// A header byte below 128 is followed by that many plus one literal bytes;
+/// a header byte `h` of 128 or more is followed by a single byte, repeated
+/// `h - 126` times.
+unsigned
+SwapCache::Compress(const char *from, char *into) const
+{
+    ASSERT(from != nullptr);
+    ASSERT(into != nullptr);
+
+    unsigned limit = MaxCompressedSize();
+    unsigned out = 0;
+    unsigned i = 0;
+
+    while (i < PAGE_SIZE) {
+        unsigned run = 1;
+        while (i + run < PAGE_SIZE && run < 129 && from[i + run] == from[i]) {
+            run++;
+        }
+
+        if (run >= 3) {
+            if (out + 2 > limit) {
+                return 0;
+            }
+            into[out++] = (char) (126 + run);
+            into[out++] = from[i];
+            i += run;
+            continue;
+        }
+
+        // Gather literals up to the next run worth encoding.
+        unsigned start = i;
+        while (i < PAGE_SIZE && i - start < 128) {
+            if (i + 2 < PAGE_SIZE
+                  && from[i] == from[i + 1] && from[i] == from[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        unsigned count = i - start;
+        if (out + 1 + count > limit) {
+            return 0;
+        }
+        into[out++] = (char) (count - 1);
+        for (unsigned j = 0; j < count; j++) {
+            into[out++] = from[start + j];
+        }
+    }
+
+    return out;
+}
+
+bool
+SwapCache::HasRoom(unsigned size) const
+{
+    return chunks->CountClear() * chunkSize >= size;
+}
+
+void
+SwapCache::Store(unsigned slot, const char *data, unsigned size)
+{
+    ASSERT(slot < numSlots);
+    ASSERT(firstChunk[slot] == -1);
+    ASSERT(data != nullptr);
+    ASSERT(size > 0 && size <= MaxCompressedSize());
+    ASSERT(HasRoom(size));
+
+    // Chain the chunks in order, so that `Load` can follow them.
+    int *link = &firstChunk[slot];
+    for (unsigned done = 0; done < size; done += chunkSize) {
+        int chunk = chunks->Find();
+        ASSERT(chunk != -1);
+        *link = chunk;
+        link = &nextChunk[chunk];
+
+        unsigned count = size - done < chunkSize ? size - done : chunkSize;
+        char *into = ChunkAddress(chunk);
+        for (unsigned j = 0; j < count; j++) {
+            into[j] = data[done + j];
+        }
+    }
+    *link = -1;
+    sizes[slot] = size;
+
+    older[slot] = newest;
+    newer[slot] = -1;
+    if (newest == -1) {
+        oldest = slot;
+    } else {
+        newer[newest] = slot;
+    }
+    newest = slot;
+}
+
+bool
+SwapCache::Contains(unsigned slot) const
+{
+    ASSERT(slot < numSlots);
+    return firstChunk[slot] != -1;
+}
+
+void
+SwapCache::Load(unsigned slot, char *into)
+{
+    ASSERT(Contains(slot));
+    ASSERT(into != nullptr);
+
+    unsigned size = sizes[slot];
+    unsigned done = 0;
+    for (int chunk = firstChunk[slot]; chunk != -1; chunk = nextChunk[chunk]) {
+        unsigned count = size - done < chunkSize ? size - done : chunkSize;
+        const char *from = ChunkAddress(chunk);
+        for (unsigned j = 0; j < count; j++) {
+            buffer[done + j] = from[j];
+        }
+        done += count;
+    }
+    ASSERT(done == size);
+
+    unsigned out = 0;
+    for (unsigned i = 0; i < size; ) {
+        unsigned header = (unsigned char) buffer[i++];
+        if (header < 128) {
+            ASSERT(out + header + 1 <= PAGE_SIZE);
+            for (unsigned j = 0; j <= header; j++) {
+                into[out++] = buffer[i++];
+            }
+        } else {
+            ASSERT(out + header - 126 <= PAGE_SIZE);
+            for (unsigned j = 0; j < header - 126; j++) {
+                into[out++] = buffer[i];
+            }
+            i++;
+        }
+    }
+    ASSERT(out == PAGE_SIZE);
+}
+
+void
+SwapCache::Drop(unsigned slot)
+{
+    if (!Contains(slot)) {
+        return;
+    }
+
+    for (int chunk = firstChunk[slot]; chunk != -1; chunk = nextChunk[chunk]) {
+        chunks->Clear(chunk);
+    }
+    firstChunk[slot] = -1;
+
+    if (older[slot] == -1) {
+        oldest = newer[slot];
+    } else {
+        newer[older[slot]] = newer[slot];
+    }
+    if (newer[slot] == -1) {
+        newest = older[slot];
+    } else {
+        older[newer[slot]] = older[slot];
+    }
+}
+
+int
+SwapCache::Oldest() const
+{
+    return oldest;
+}
+
+#endif
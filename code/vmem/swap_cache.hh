@@ -0,0 +1,105 @@
+/// A pool of compressed pages kept in memory, in front of the swap file.
+///
+/// With `-swap-cache`, a few physical frames are taken out of the coremap at
+/// boot and cut into small chunks.  A page sent to swap is compressed first and, if it
+/// shrinks enough, stored in a chain of chunks instead of going to disk;
+/// reading it back only takes a decompression.  When the pool is full, the
+/// pages that have been in it the longest are written to their slots in
+/// the swap file to make room.
+///
+/// Pages are compressed with a run-length encoding (PackBits): cheap, and
+/// very effective on the mostly zero pages of data, heap and stack.
+///
+/// The pool only keeps the data; deciding what to spill and doing the disk
+/// I/O is up to `SwapArea`.
+
+#ifndef NACHOS_VMEM_SWAPCACHE__HH
+#define NACHOS_VMEM_SWAPCACHE__HH
+
+
+#include "lib/bitmap.hh"
+
+
+/// Number of frames given to the pool unless `-swap-cache` says otherwise;
+/// with none, there is no pool and every page goes to disk.
+const unsigned DEFAULT_SWAP_CACHE_FRAMES = 0;
+
+/// Number of chunks each pool frame is cut into.
+const unsigned SWAP_CACHE_CHUNKS_PER_PAGE = 8;
+
+/// Pages that need more chunks than this once compressed are not worth
+/// keeping in the pool and go straight to disk.
+const unsigned SWAP_CACHE_MAX_CHUNKS = 6;
+
+
+class SwapCache {
+public:
+
+    /// Reserve `nframes` frames of physical memory for a pool that can
+    /// hold pages of `nslots` swap slots.
+    SwapCache(unsigned nframes, unsigned nslots);
+
+    ~SwapCache();
+
+    /// Compress the page at `from` into `into`, which must have room for
+    /// `MaxCompressedSize` bytes.
+    ///
+    /// Return the compressed size, or 0 if the page does not compress well
+    /// enough to be kept in the pool.
+    unsigned Compress(const char *from, char *into) const;
+
+    /// Largest compressed size of a page accepted by the pool.
+    unsigned MaxCompressedSize() const;
+
+    /// Whether there are enough free chunks for `size` compressed bytes.
+    bool HasRoom(unsigned size) const;
+
+    /// Store `size` compressed bytes as the contents of `slot`, which must
+    /// not be in the pool already.  There must be room.
+    void Store(unsigned slot, const char *data, unsigned size);
+
+    /// Whether the pool holds the contents of `slot`.
+    bool Contains(unsigned slot) const;
+
+    /// Decompress the page of `slot` into `into`.
+    void Load(unsigned slot, char *into);
+
+    /// Forget the contents of `slot`, if the pool has them.
+    void Drop(unsigned slot);
+
+    /// Return the slot that has been in the pool the longest, or -1 if the
+    /// pool is empty.
+    int Oldest() const;
+
+private:
+
+    /// Address in main memory of chunk `chunk`.
+    char *ChunkAddress(unsigned chunk) const;
+
+    unsigned numFrames;
+    unsigned *frames;
+
+    /// Where a page's chunks are gathered before decompressing it.
+    char *buffer;
+
+    unsigned chunkSize;
+    unsigned numChunks;
+
+    /// Which chunks are in use, and the chunk that follows each one in its
+    /// page's chain.
+    Bitmap *chunks;
+    int *nextChunk;
+
+    /// For every slot: first chunk (-1 if not in the pool), compressed
+    /// size, and neighbours in the pool, from the oldest to the newest.
+    unsigned numSlots;
+    int *firstChunk;
+    unsigned *sizes;
+    int *older;
+    int *newer;
+    int oldest;
+    int newest;
+};
+
+
+#endif
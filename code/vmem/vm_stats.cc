@@ -0,0 +1,114 @@
+#include "vm_stats.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+
+
+static const char *FAULT_NAMES[NUM_FAULT_TYPES] = {
+    "TLB miss", "demand load", "swap in", "zero fill", "copy on write"
+};
+
+VmStats::VmStats()
+{
+    for (unsigned i = 0; i < NUM_FAULT_TYPES; i++) {
+        faults[i] = totalLatency[i] = 0;
+        for (unsigned j = 0; j < NUM_LATENCY_BUCKETS; j++) {
+            latencies[i][j] = 0;
+        }
+    }
+    evictionsSuffered = evictionsInflicted = 0;
+    resident = peakResident = 0;
+    residentTicks = 0;
+    start = lastChange = stats->totalTicks;
+}
+
+void
+VmStats::RecordFault(FaultType type, unsigned long ticks)
+{
+    ASSERT(type < NUM_FAULT_TYPES);
+
+    unsigned bucket = 0;
+    while (ticks >> bucket != 0 && bucket < NUM_LATENCY_BUCKETS - 1) {
+        bucket++;
+    }
+
+    faults[type]++;
+    latencies[type][bucket]++;
+    totalLatency[type] += ticks;
+}
+
+void
+VmStats::EvictionSuffered()
+{
+    evictionsSuffered++;
+}
+
+void
+VmStats::EvictionInflicted()
+{
+    evictionsInflicted++;
+}
+
+void
+VmStats::ResidentChanged(int delta)
+{
+    ASSERT(delta >= 0 || (unsigned) -delta <= resident);
+
+    unsigned long now = stats->totalTicks;
+    residentTicks += resident * (now - lastChange);
+    lastChange = now;
+
+    resident += delta;
+    if (resident > peakResident) {
+        peakResident = resident;
+    }
+}
+
+void
+VmStats::Resume(const VmStats &saved)
+{
+    unsigned now = resident;
+    *this = saved;
+    resident = now;
+    if (resident > peakResident) {
+        peakResident = resident;
+    }
+}
+
+void
+VmStats::Print(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    unsigned long now = stats->totalTicks;
+    unsigned long ticks = residentTicks + resident * (now - lastChange);
+    unsigned long average = now > start ? ticks / (now - start) : resident;
+
+    printf("Virtual memory of %s:\n", name);
+    printf("  Resident pages: now %u, peak %u, average %lu\n",
+           resident, peakResident, average);
+    printf("  Evictions: suffered %lu, inflicted %lu\n",
+           evictionsSuffered, evictionsInflicted);
+    for (unsigned i = 0; i < NUM_FAULT_TYPES; i++) {
+        printf("  Faults by %s: %lu", FAULT_NAMES[i], faults[i]);
+        if (faults[i] == 0) {
+            printf("\n");
+            continue;
+        }
+        printf(", average %lu ticks\n", totalLatency[i] / faults[i]);
+        for (unsigned j = 0; j < NUM_LATENCY_BUCKETS; j++) {
+            if (latencies[i][j] == 0) {
+                continue;
+            }
+            if (j == 0) {
+                printf("    0 ticks: %lu\n", latencies[i][j]);
+            } else if (j == NUM_LATENCY_BUCKETS - 1) {
+                printf("    %lu+ ticks: %lu\n", 1UL << (j - 1),
+                       latencies[i][j]);
+            } else {
+                printf("    %lu-%lu ticks: %lu\n", 1UL << (j - 1),
+                       (1UL << j) - 1, latencies[i][j]);
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/// Virtual memory statistics of a single address space.
+///
+/// The global counters in `Statistics` tell how much paging goes on, but
+/// not who causes it.  Each address space keeps its own faults by cause,
+/// with a histogram of how many simulated ticks they took to serve, the
+/// evictions it suffered and inflicted on others, and the size of its
+/// resident set over time.
+///
+/// They are printed by `Ps`, and when a process exits if `-vm-stats` is
+/// given.
+
+#ifndef NACHOS_VMEM_VMSTATS__HH
+#define NACHOS_VMEM_VMSTATS__HH
+
+
+enum FaultType {
+    TLB_MISS_FAULT,       ///< The page was resident; only the TLB was
+                          ///< refilled.
+    DEMAND_LOAD_FAULT,    ///< The page was loaded from its file.
+    SWAP_IN_FAULT,        ///< The page was brought back from swap.
+    ZERO_FILL_FAULT,      ///< The page was mapped to the shared zero frame.
+    COPY_ON_WRITE_FAULT,  ///< A page of the zero frame got its own frame.
+    NUM_FAULT_TYPES
+};
+
+/// Latencies are counted in buckets of powers of two: bucket 0 holds
+/// faults served in 0 ticks, bucket `i` those that took from `2^(i-1)` to
+/// `2^i - 1` ticks, and the last one everything longer.
+const unsigned NUM_LATENCY_BUCKETS = 16;
+
+
+class VmStats {
+public:
+
+    VmStats();
+
+    /// Account a fault of type `type` that took `ticks` to serve.
+    void RecordFault(FaultType type, unsigned long ticks);
+
+    /// One of our pages was evicted, maybe by one of our own faults.
+    void EvictionSuffered();
+
+    /// Some page was evicted to serve one of our faults.
+    void EvictionInflicted();
+
+    /// The number of resident pages changed by `delta`.
+    void ResidentChanged(int delta);
+
+    /// Print everything, labelled with `name`.
+    void Print(const char *name);
+
+    /// Go on from `saved`, taken from a checkpoint, as the clock goes back
+    /// to its time.  The resident set is the one there is now.
+    void Resume(const VmStats &saved);
+
+private:
+
+    unsigned long faults[NUM_FAULT_TYPES];
+    unsigned long latencies[NUM_FAULT_TYPES][NUM_LATENCY_BUCKETS];
+    unsigned long totalLatency[NUM_FAULT_TYPES];
+
+    unsigned long evictionsSuffered;
+    unsigned long evictionsInflicted;
+
+    /// Resident set: current and maximum size, and the sum of its size
+    /// over every tick, to get the average.
+    unsigned resident;
+    unsigned peakResident;
+    unsigned long residentTicks;
+
+    /// When the address space was created and when its resident set last
+    /// changed.
+    unsigned long start;
+    unsigned long lastChange;
+};
+
+
+#endif